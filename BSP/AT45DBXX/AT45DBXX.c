@@ -1,6 +1,16 @@
 
 
 #include "AT45DBXX.h"
+#include <string.h>
+
+// Page program command and data, sent in one DMA burst. Lets the caller reuse its page buffer as
+// soon as Eeprom_Write_Page_DMA() returns. Reads are also received here, a page at most at a time,
+// and copied to the caller's buffer, which may then live in cached RAM or on the stack.
+static DMA_BUFFER uint8_t dma_page[4+EEPROM_PAGE_SIZE];
+static volatile uint8_t dma_busy = 0;
+static uint8_t *dma_read_data;    // Caller's buffer position of the next bytes received
+static uint16_t dma_read_length;  // Bytes left to receive
+static uint16_t dma_read_chunk;   // Bytes received into dma_page by the transfer in progress
 
 // read the status register
 // --------------------------------------------------------------------------------
@@ -15,20 +25,110 @@
 // bit 0 = 1 -> page size = 256 else page size = 264
 // By default the status register = 0x9D
 
-static void AT45DBXX_BUSY(void)
+static uint8_t AT45DBXX_Status(void)
 {
 	uint8_t status=0;
 	uint8_t cmd[1];
 	cmd[0] = READ_STATE_REGISTER;
+	HAL_GPIO_WritePin(SPI1_NSS_GPIO_Port, SPI1_NSS_Pin, GPIO_PIN_RESET);
+	HAL_SPI_Transmit(&hspi1, cmd, 1, 1000);	
+	HAL_SPI_Receive(&hspi1, &status, 1, 1000);
+	HAL_GPIO_WritePin(SPI1_NSS_GPIO_Port, SPI1_NSS_Pin, GPIO_PIN_SET);
+	return status;
+}
+
+static void AT45DBXX_BUSY(void)
+{
+	while(dma_busy);
+	while(!(AT45DBXX_Status() & 0x80));
+}
+
+uint8_t Eeprom_Busy(void)
+{
+	if (dma_busy) return 1;
+	return !(AT45DBXX_Status() & 0x80);
+}
+
+void Eeprom_Wait(void)
+{
+	AT45DBXX_BUSY();
+}
+
+// Releases the chip select at the end of a DMA burst. For a page program, this starts the erase
+// and program cycle, which Eeprom_Busy() then reports through the status register.
+static void AT45DBXX_DMA_Complete(void)
+{
 	HAL_GPIO_WritePin(SPI1_NSS_GPIO_Port, SPI1_NSS_Pin, GPIO_PIN_SET);
-	do
-	{
-		HAL_GPIO_WritePin(SPI1_NSS_GPIO_Port, SPI1_NSS_Pin, GPIO_PIN_RESET);
-		HAL_SPI_Transmit(&hspi1, cmd, 1, 1000);	
-		HAL_SPI_Receive(&hspi1, &status, 1, 1000);
-		HAL_GPIO_WritePin(SPI1_NSS_GPIO_Port, SPI1_NSS_Pin, GPIO_PIN_SET);
-	}while(!(status & 0x80));
+	dma_busy = 0;
+}
+
+static void AT45DBXX_Read_Chunk(void)
+{
+	dma_read_chunk = (dma_read_length < sizeof(dma_page)) ? dma_read_length : sizeof(dma_page);
+	if (HAL_SPI_Receive_DMA(&hspi1, dma_page, dma_read_chunk) != HAL_OK) AT45DBXX_DMA_Complete();
+}
+
+// Copies the chunk received and goes on with the next one. The continuous array read keeps
+// streaming as long as the chip select stays low.
+static void AT45DBXX_Read_Complete(void)
+{
+	memcpy(dma_read_data, dma_page, dma_read_chunk);
+	dma_read_data += dma_read_chunk;
+	dma_read_length -= dma_read_chunk;
+	if (dma_read_length) AT45DBXX_Read_Chunk();
+	else AT45DBXX_DMA_Complete();
+}
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+	if (hspi->Instance == SPI1) AT45DBXX_DMA_Complete();
+}
+
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+	if (hspi->Instance == SPI1) AT45DBXX_Read_Complete();
+}
+
+// A master receive runs as a full duplex transfer, which ends here.
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+	if (hspi->Instance == SPI1) AT45DBXX_Read_Complete();
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+	if (hspi->Instance == SPI1) AT45DBXX_DMA_Complete();
+}
+
+void Eeprom_Write_Page_DMA(uint16_t Page, const uint8_t *Data)
+{
+	AT45DBXX_BUSY();
+	dma_page[0] = MM_PAGE_PROG_THROUGH_B1;
+	dma_page[1] = (uint8_t)(Page>>8);
+	dma_page[2] = (uint8_t)Page;
+	dma_page[3] = 0x00;
+	memcpy(&dma_page[4], Data, EEPROM_PAGE_SIZE);
+	dma_busy = 1;
+	HAL_GPIO_WritePin(SPI1_NSS_GPIO_Port, SPI1_NSS_Pin, GPIO_PIN_RESET);
+	if (HAL_SPI_Transmit_DMA(&hspi1, dma_page, sizeof(dma_page)) != HAL_OK) AT45DBXX_DMA_Complete();
+}
 
+void Eeprom_Read_DMA(uint32_t Address, uint8_t *Data, uint16_t Length)
+{
+	uint8_t cmd[5];
+	if (Length == 0) return;
+	cmd[0] = CONTINUOUS_ARRAY_READ;
+	cmd[1] = (uint8_t)(Address>>16);
+	cmd[2] = (uint8_t)(Address>>8);
+	cmd[3] = (uint8_t)Address;
+	cmd[4] = 0xFF; // Dummy byte
+	AT45DBXX_BUSY();
+	dma_busy = 1;
+	HAL_GPIO_WritePin(SPI1_NSS_GPIO_Port, SPI1_NSS_Pin, GPIO_PIN_RESET);
+	HAL_SPI_Transmit(&hspi1, cmd, 5, 1000);
+	dma_read_data = Data;
+	dma_read_length = Length;
+	AT45DBXX_Read_Chunk();
 }
 
 void Eeprom_Chip_Erase(void)
@@ -31,8 +31,11 @@
 #define SECTOR_ERASE 0x7C // 128k bytes per sector
 #define READ_STATE_REGISTER 0xD7
 #define Read_ID 0x9F
+#define MM_PAGE_PROG_THROUGH_B1 0x82 // Buffer 1 write, then erase and program on chip select release
+#define CONTINUOUS_ARRAY_READ 0x0B
 
 #define EEPROM_PAGE0 0
+#define EEPROM_PAGE_SIZE 256 // Binary page size. Byte address is (page << 8) | offset.
 
 
 void AT45DBXX_Read_ID(uint8_t *Data);
@@ -46,5 +49,16 @@ uint8_t Eeprom_Read_Buffer(uint16_t BufferOffset);
 void Eeprom_Chip_Erase(void);
 void Eeprom_Write_CR(void);
 
+// Page burst transfers over SPI1 DMA. Both return as soon as the transfer is started. A new
+// transfer, or any of the byte functions above, first waits for the previous one to complete.
+void Eeprom_Write_Page_DMA(uint16_t Page, const uint8_t *Data);
+void Eeprom_Read_DMA(uint32_t Address, uint8_t *Data, uint16_t Length);
+
+// Returns 1 while a DMA transfer is running or the flash is still programming a page, else 0.
+uint8_t Eeprom_Busy(void);
+
+// Waits for the DMA transfer and page programming in progress to complete.
+void Eeprom_Wait(void);
+
 #endif /*_AT45DBXX_H*/
 
@@ -166,6 +166,7 @@ standard names. */
 
 /* USER CODE BEGIN Defines */   	      
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+#define configUSE_RECURSIVE_MUTEXES              1  /* Segment prep lock (SEGMENT_PREP_TASK) */
 /* USER CODE END Defines */ 
 
 #endif /* FREERTOS_CONFIG_H */
@@ -151,6 +151,13 @@
 
 /* USER CODE BEGIN Private defines */
 
+/* Memory placement, see the linker script. ITCM_CODE runs from the ITCM and DTCM_DATA lives in
+   the DTCM, both without wait states and outside the caches. DTCM_DATA must not be initialized.
+   DMA_BUFFER goes to the non-cacheable SRAM2 and must hold all data moved by DMA. */
+#define ITCM_CODE   __attribute__((section(".itcm_text"), noinline))
+#define DTCM_DATA   __attribute__((section(".dtcm_bss")))
+#define DMA_BUFFER  __attribute__((section(".dma_buffer"), aligned(4)))
+
 /* USER CODE END Private defines */
 
 #ifdef __cplusplus
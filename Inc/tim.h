@@ -81,7 +81,8 @@ void HAL_TIM_MspPostInit(TIM_HandleTypeDef *htim);
                 
 
 /* USER CODE BEGIN Prototypes */
-
+void TIM8_StepPulseDMA_Init(GPIO_TypeDef *port, uint32_t *bsrr_word);
+void TIM8_StepDMA_Init(GPIO_TypeDef *port, uint32_t *table, uint16_t words);
 /* USER CODE END Prototypes */
 
 #ifdef __cplusplus
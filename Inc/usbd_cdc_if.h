@@ -142,6 +142,9 @@ uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
 void CDC_send_str (char *str, int len);
 void CDC_send_text (char *text);
 void CDC_send_char (char c);
+uint16_t CDC_get_tx_buffer_available (void);
+void CDC_resume_receive (void);
+void CDC_TransmitCplt_FS (void);
 void CDC_led_tx_on(uint8_t state);
 void CDC_led_rx_on(uint8_t state);
 /* USER CODE END EXPORTED_FUNCTIONS */
@@ -119,7 +119,7 @@ void StartDefaultTask(void const * argument)
   /* USER CODE BEGIN StartDefaultTask */
   // Start all ADC
   HAL_ADC_Start(&hadc1);
-  HAL_ADC_Start_DMA(&hadc1, (uint32_t*)_setup.parameters_ext, 5);
+  HAL_ADC_Start_DMA(&hadc1, parameters_ext, 5);
 
   /* USER CODE BEGIN StartDefaultTask */
   delay_ms(100);
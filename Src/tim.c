@@ -373,6 +373,60 @@ void HAL_TIM_Encoder_MspDeInit(TIM_HandleTypeDef* tim_encoderHandle)
 
 /* USER CODE BEGIN 1 */
 
+/* Step pulse reset of grbl/stepper.c (STEP_PULSE_DMA_RESET in grbl/config.h). TIM8 and DMA2 Stream1
+   are not configured in GRBL_STM32.ioc and must stay unassigned there, also for STEP_GENERATION_DMA.
+   TIM8 runs in one-pulse mode at the timer clock (2xPCLK2) and stops by itself at its update event,
+   which requests DMA2 Stream1 Channel7. The stream then copies the word at bsrr_word, in a DMA_BUFFER,
+   into the BSRR register of port. Only counter overflows request it, not the update generated by
+   software (URS). The caller sets the pulse length in ARR and starts each pulse. */
+void TIM8_StepPulseDMA_Init(GPIO_TypeDef *port, uint32_t *bsrr_word)
+{
+  __HAL_RCC_TIM8_CLK_ENABLE();
+  __HAL_RCC_DMA2_CLK_ENABLE();
+  TIM8->CR1 = TIM_CR1_OPM | TIM_CR1_URS;
+  TIM8->PSC = 0;
+  TIM8->RCR = 0;
+  TIM8->EGR = TIM_EGR_UG;
+  TIM8->SR = 0;
+  TIM8->DIER = TIM_DIER_UDE;
+
+  DMA2_Stream1->CR = 0;
+  while (DMA2_Stream1->CR & DMA_SxCR_EN) {}
+  DMA2_Stream1->PAR = (uint32_t)&port->BSRR;
+  DMA2_Stream1->M0AR = (uint32_t)bsrr_word;
+  DMA2_Stream1->NDTR = 1;
+  DMA2_Stream1->FCR = 0; /* Direct mode */
+  DMA2_Stream1->CR = DMA_CHANNEL_7 | DMA_MEMORY_TO_PERIPH | DMA_PDATAALIGN_WORD | DMA_MDATAALIGN_WORD |
+                     DMA_CIRCULAR | DMA_PRIORITY_VERY_HIGH;
+  DMA2->LIFCR = (DMA_LIFCR_CTCIF1|DMA_LIFCR_CHTIF1|DMA_LIFCR_CTEIF1|DMA_LIFCR_CDMEIF1|DMA_LIFCR_CFEIF1);
+  DMA2_Stream1->CR |= DMA_SxCR_EN;
+}
+
+/* Step generation of grbl/stepper.c (STEP_GENERATION_DMA in grbl/config.h). TIM8 runs at the timer
+   clock (2xPCLK2) with an update event every usec, which requests DMA2 Stream1 Channel7. The stream
+   copies the words of table, in a DMA_BUFFER, one per request into the BSRR register of port, wrapping
+   around after words. Its half and full transfer interrupts refill the table. The caller enables the
+   stream and starts the timer. */
+void TIM8_StepDMA_Init(GPIO_TypeDef *port, uint32_t *table, uint16_t words)
+{
+  __HAL_RCC_TIM8_CLK_ENABLE();
+  __HAL_RCC_DMA2_CLK_ENABLE();
+  TIM8->CR1 = 0;
+  TIM8->PSC = 0;
+  TIM8->ARR = (2*HAL_RCC_GetPCLK2Freq())/1000000 - 1;
+  TIM8->DIER = TIM_DIER_UDE;
+
+  DMA2_Stream1->CR = 0;
+  while (DMA2_Stream1->CR & DMA_SxCR_EN) {}
+  DMA2_Stream1->PAR = (uint32_t)&port->BSRR;
+  DMA2_Stream1->M0AR = (uint32_t)table;
+  DMA2_Stream1->NDTR = words;
+  DMA2_Stream1->FCR = 0; /* Direct mode */
+  DMA2_Stream1->CR = DMA_CHANNEL_7 | DMA_MEMORY_TO_PERIPH | DMA_MINC_ENABLE | DMA_PDATAALIGN_WORD |
+                     DMA_MDATAALIGN_WORD | DMA_CIRCULAR | DMA_PRIORITY_VERY_HIGH | DMA_IT_HT | DMA_IT_TC;
+  DMA2->LIFCR = (DMA_LIFCR_CTCIF1|DMA_LIFCR_CHTIF1|DMA_LIFCR_CTEIF1|DMA_LIFCR_CDMEIF1|DMA_LIFCR_CFEIF1);
+}
+
 /* USER CODE END 1 */
 
 /**
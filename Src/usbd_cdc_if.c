@@ -97,10 +97,8 @@ volatile StPulseMSRemaining PulseMSRemaining;
 /* Define size for the receive and transmit buffer over CDC */
 /* It's up to user to redefine and/or remove those define */
 #define APP_RX_DATA_SIZE  2048
-#define APP_TX_DATA_SIZE  2048
+#define APP_TX_DATA_SIZE  4096  // Also the size of the transmit ring buffer
 
- extern uint8_t serial_rx_buffer[RX_BUFFER_SIZE];
- extern uint8_t serial_rx_buffer_head;
 /* USER CODE END PRIVATE_DEFINES */
 
 /**
@@ -133,6 +131,14 @@ uint8_t UserRxBufferFS[APP_RX_DATA_SIZE];
 uint8_t UserTxBufferFS[APP_TX_DATA_SIZE];
 
 /* USER CODE BEGIN PRIVATE_VARIABLES */
+// Transmit ring buffer over UserTxBufferFS. CDC_send_str() appends and returns, the IN endpoint
+// transfer complete interrupt sends the rest. Data is sent straight out of the ring, one
+// contiguous run at a time.
+static volatile uint16_t cdc_tx_head;     // Next free byte. Written by the senders only.
+static volatile uint16_t cdc_tx_tail;     // First unsent byte. Written with the USB interrupt masked.
+static volatile uint16_t cdc_tx_inflight; // Bytes handed to the IN endpoint. Zero when idle.
+static volatile uint8_t cdc_tx_stalled;   // A send timed out. Cleared when the host takes data.
+static volatile uint8_t cdc_rx_paused;    // OUT endpoint left un-armed while the serial buffer is full.
 
 /* USER CODE END PRIVATE_VARIABLES */
 
@@ -166,6 +172,7 @@ static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length);
 static int8_t CDC_Receive_FS(uint8_t* pbuf, uint32_t *Len);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
+static void CDC_tx_start(void);
 
 /* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
 
@@ -192,6 +199,11 @@ static int8_t CDC_Init_FS(void)
   /* Set Application Buffers */
   USBD_CDC_SetTxBuffer(&hUsbDeviceFS, UserTxBufferFS, 0);
   USBD_CDC_SetRxBuffer(&hUsbDeviceFS, UserRxBufferFS);
+  // A new host session. Discard anything queued for the previous one.
+  cdc_tx_inflight = 0;
+  cdc_tx_tail = cdc_tx_head;
+  cdc_tx_stalled = 0;
+  cdc_rx_paused = 0; // The class arms the OUT endpoint itself.
   return (USBD_OK);
   /* USER CODE END 3 */
 }
@@ -304,72 +316,17 @@ static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length)
 static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
 {
   /* USER CODE BEGIN 6 */
-  volatile uint8_t data;
-  volatile uint8_t *ptdata;
-  volatile uint8_t RxBufferCount;
-
-  USBD_CDC_SetRxBuffer(&hUsbDeviceFS, &Buf[0]);
-  USBD_CDC_ReceivePacket(&hUsbDeviceFS);
-
-  RxBufferCount = *Len;
-
-  ptdata = Buf;
-  Buf[*Len] = 0;
-
-  data = *ptdata;
-
   CDC_led_rx_on(1);
 
-  // Pick off realtime command characters directly from the serial stream. These characters are
-  // not passed into the main buffer, but these set system state flag bits for realtime execution.
-  switch (data) {
-      case CMD_RESET:	mc_reset();
-      	  	  	  	    //report_init_message();
-      	  	  	  	  	break; // Call motion control reset routine.
-      case CMD_STATUS_REPORT: system_set_exec_state_flag(EXEC_STATUS_REPORT); break; // Set as true
-      case CMD_CYCLE_START:   system_set_exec_state_flag(EXEC_CYCLE_START); break; // Set as true
-      case CMD_FEED_HOLD:     system_set_exec_state_flag(EXEC_FEED_HOLD); break; // Set as true
-      default :
-        if (data > 0x7F) { // Real-time control characters are extended ACSII only.
-          switch(data) {
-            case CMD_SAFETY_DOOR:   system_set_exec_state_flag(EXEC_SAFETY_DOOR); break; // Set as true
-            case CMD_JOG_CANCEL:
-              if (sys.state & STATE_JOG) { // Block all other states from invoking motion cancel.
-                system_set_exec_state_flag(EXEC_MOTION_CANCEL);
-              }
-              break;
-            #ifdef DEBUG
-              case CMD_DEBUG_REPORT: {uint8_t sreg = SREG; cli(); bit_true(sys_rt_exec_debug,EXEC_DEBUG_REPORT); SREG = sreg;} break;
-            #endif
-            case CMD_FEED_OVR_RESET           : system_set_exec_motion_override_flag(EXEC_FEED_OVR_RESET); break;
-            case CMD_FEED_OVR_COARSE_PLUS     : system_set_exec_motion_override_flag(EXEC_FEED_OVR_COARSE_PLUS); break;
-            case CMD_FEED_OVR_COARSE_MINUS    : system_set_exec_motion_override_flag(EXEC_FEED_OVR_COARSE_MINUS); break;
-            case CMD_FEED_OVR_FINE_PLUS       : system_set_exec_motion_override_flag(EXEC_FEED_OVR_FINE_PLUS); break;
-            case CMD_FEED_OVR_FINE_MINUS      : system_set_exec_motion_override_flag(EXEC_FEED_OVR_FINE_MINUS); break;
-            case CMD_RAPID_OVR_RESET          : system_set_exec_motion_override_flag(EXEC_RAPID_OVR_RESET); break;
-            case CMD_RAPID_OVR_MEDIUM         : system_set_exec_motion_override_flag(EXEC_RAPID_OVR_MEDIUM); break;
-            case CMD_RAPID_OVR_LOW            : system_set_exec_motion_override_flag(EXEC_RAPID_OVR_LOW); break;
-            case CMD_SPINDLE_OVR_RESET        : system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_RESET); break;
-            case CMD_SPINDLE_OVR_COARSE_PLUS  : system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_COARSE_PLUS); break;
-            case CMD_SPINDLE_OVR_COARSE_MINUS : system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_COARSE_MINUS); break;
-            case CMD_SPINDLE_OVR_FINE_PLUS    : system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_FINE_PLUS); break;
-            case CMD_SPINDLE_OVR_FINE_MINUS   : system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_FINE_MINUS); break;
-            case CMD_SPINDLE_OVR_STOP         : system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_STOP); break;
-            case CMD_COOLANT_FLOOD_OVR_TOGGLE : system_set_exec_accessory_override_flag(EXEC_COOLANT_FLOOD_OVR_TOGGLE); break;
-
-            #ifdef ENABLE_M7
-              case CMD_COOLANT_MIST_OVR_TOGGLE: system_set_exec_accessory_override_flag(EXEC_COOLANT_MIST_OVR_TOGGLE); break;
-            #endif
-
-          }
-          // Throw away any unfound extended-ASCII character by not passing it to the serial buffer.
-        } else { // Write character to buffer
-          // Write data to buffer unless it is full.
-        	do {
-        		serial_rx_buffer[serial_rx_buffer_head++] = *ptdata++;
-        	}
-        	while(--RxBufferCount);
-        }
+  // Pick realtime commands out of every byte of the packet and queue the rest for the protocol loop.
+  serial_receive(Buf, *Len);
+
+  // Re-arm the OUT endpoint only while another full packet fits in the serial buffer. Otherwise
+  // the host is NAKed until serial_read() has made room again. See CDC_resume_receive().
+  if (serial_get_rx_buffer_available() >= CDC_DATA_FS_MAX_PACKET_SIZE) {
+    USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+  } else {
+    cdc_rx_paused = 1;
   }
   return (USBD_OK);
   /* USER CODE END 6 */
@@ -428,40 +385,135 @@ uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
 
 /*****************************************************************************
 Name:        CDC_send_str
-Description	 : The following sends a text string to the terminal program
+Description	 : The following sends a text string to the terminal program. Waits at most
+               CDC_TX_TIMEOUT for space in the ring, then drops the rest of the message.
 Parameters	 :  msg_string -> the text string to output
 Return value : none
 *****************************************************************************/
 void CDC_send_str (char *str, int len)
 {
-  uint8_t res;
-
-  do {
-	  res = CDC_Transmit_FS((uint8_t*)str,len);
+  uint16_t head, n;
+  uint32_t tick;
+
+  if (hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED) { return; } // No host. Nothing to send to.
+  tick = HAL_GetTick();
+  #ifdef CDC_TX_DROP_ON_OVERFLOW
+    if (len > CDC_get_tx_buffer_available()) { return; } // Drop whole messages only.
+  #else
+    // Wait until the whole message fits, so a timeout drops whole messages. Longer messages than
+    // the ring are sent in parts below. A host that stalled before gets no new wait.
+    while ((len < APP_TX_DATA_SIZE) && (len > CDC_get_tx_buffer_available())) {
+      if (cdc_tx_stalled || ((HAL_GetTick()-tick) > CDC_TX_TIMEOUT) ||
+          (hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED)) {
+        cdc_tx_stalled = 1;
+        return;
+      }
+    }
+  #endif
+
+  while (len > 0) {
+    n = CDC_get_tx_buffer_available();
+    if (n == 0) {
+      // Ring full. Wait for the host to drain it, unless it went away or stalled.
+      if ((hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED) || ((HAL_GetTick()-tick) > CDC_TX_TIMEOUT)) {
+        cdc_tx_stalled = 1;
+        return;
+      }
+      continue;
+    }
+    head = cdc_tx_head;
+    if (n > len) { n = len; }
+    if (n > (APP_TX_DATA_SIZE - head)) { n = APP_TX_DATA_SIZE - head; }
+    memcpy(&UserTxBufferFS[head], str, n);
+    str += n;
+    len -= n;
+    head += n;
+    if (head == APP_TX_DATA_SIZE) { head = 0; }
+    __DMB(); // Data must be in the ring before the USB interrupt can see the new head.
+    cdc_tx_head = head;
+
+    HAL_NVIC_DisableIRQ(OTG_FS_IRQn);
+    CDC_tx_start();
+    HAL_NVIC_EnableIRQ(OTG_FS_IRQn);
   }
-  while (res != USBD_OK);
 }
 
 void CDC_send_text (char *text)
 {
-	uint8_t res;
-	uint16_t len;
-
-	len = strlen(text);
-	do {
-		res = CDC_Transmit_FS((uint8_t*)text,len);
-	}
-	while (res != USBD_OK);
+	CDC_send_str(text, strlen(text));
 }
 
 void CDC_send_char (char c)
 {
-	uint8_t res;
+	CDC_send_str(&c, 1);
+}
+
+/*****************************************************************************
+Name:        CDC_get_tx_buffer_available
+Description	 : Returns the free space in the transmit ring buffer
+*****************************************************************************/
+uint16_t CDC_get_tx_buffer_available (void)
+{
+  uint16_t tail = cdc_tx_tail;
+  uint16_t head = cdc_tx_head;
+  if (head >= tail) { return (APP_TX_DATA_SIZE - 1 - (head - tail)); }
+  return (tail - head - 1);
+}
+
+/*****************************************************************************
+Name:        CDC_resume_receive
+Description	 : Re-arms the OUT endpoint once a full packet fits in the serial buffer again,
+               if CDC_Receive_FS() left it NAKing. Called by serial_read().
+*****************************************************************************/
+void CDC_resume_receive (void)
+{
+  if (!cdc_rx_paused) { return; }
+  if (serial_get_rx_buffer_available() < CDC_DATA_FS_MAX_PACKET_SIZE) { return; }
+  HAL_NVIC_DisableIRQ(OTG_FS_IRQn);
+  cdc_rx_paused = 0;
+  USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+  HAL_NVIC_EnableIRQ(OTG_FS_IRQn);
+}
 
-	do {
-		res = CDC_Transmit_FS((uint8_t*)&c, 1);
-	}
-	while (res != USBD_OK);
+/*****************************************************************************
+Name:        CDC_tx_start
+Description	 : Hands the next contiguous run of the ring to the IN endpoint, if it is idle.
+               Called from the USB interrupt or with it masked.
+*****************************************************************************/
+static void CDC_tx_start (void)
+{
+  uint16_t head = cdc_tx_head;
+  uint16_t tail = cdc_tx_tail;
+  uint16_t len;
+
+  if (cdc_tx_inflight || (head == tail)) { return; }
+  len = ((head > tail) ? head : APP_TX_DATA_SIZE) - tail;
+  // A transfer of whole 64 byte packets only ends on a zero length packet, which this stack does
+  // not send. Keep the last byte for the next transfer so this one ends on a short packet.
+  if ((len & 0x3F) == 0) { len--; }
+
+  CDC_led_tx_on(1);
+  cdc_tx_inflight = len;
+  USBD_CDC_SetTxBuffer(&hUsbDeviceFS, &UserTxBufferFS[tail], len);
+  if (USBD_CDC_TransmitPacket(&hUsbDeviceFS) != USBD_OK) { cdc_tx_inflight = 0; }
+}
+
+/*****************************************************************************
+Name:        CDC_TransmitCplt_FS
+Description	 : IN endpoint transfer complete. Releases the sent run and starts the next one.
+               Called by HAL_PCD_DataInStageCallback() in the USB interrupt.
+*****************************************************************************/
+void CDC_TransmitCplt_FS (void)
+{
+  uint16_t tail;
+
+  if (cdc_tx_inflight == 0) { return; }
+  tail = cdc_tx_tail + cdc_tx_inflight;
+  if (tail == APP_TX_DATA_SIZE) { tail = 0; }
+  cdc_tx_tail = tail;
+  cdc_tx_inflight = 0;
+  cdc_tx_stalled = 0;
+  CDC_tx_start();
 }
 
 void CDC_led_tx_on(uint8_t state)
@@ -40,6 +40,15 @@
 // #define BAUD_RATE 230400
 #define BAUD_RATE 115200
 
+// Number of axes, from 3 to 8, taken in the order X, Y, Z, A, B, C, U and V. The step interrupt,
+// the planner, the settings and the reports are built for exactly this count, and the words of
+// other axes are rejected. The M100 multihead Z maps are only accepted when the axes they map are
+// built in. Stored settings no longer match after a change, and are restored to defaults.
+// May also be set from the compiler command line, e.g. 'make N_AXIS=3' in sim/.
+#ifndef N_AXIS
+  #define N_AXIS 8
+#endif
+
 // Define realtime command special characters. These characters are 'picked-off' directly from the
 // serial read data stream and are not passed to the grbl line execution parser. Select characters
 // that do not and must not exist in the streamed g-code program. ASCII control characters may be
@@ -240,6 +249,12 @@
 // Enables code for debugging purposes. Not for general use and always in constant flux.
 // #define DEBUG // Uncomment to enable. Default disabled.
 
+// Measures the execution time of the stepper interrupts, st_prep_buffer() and planner_recalculate()
+// with the DWT cycle counter. '$T' prints the minimum, mean, maximum and a histogram of each in CPU
+// cycles, with the step segment buffer underrun count, and '$TR' clears them. Costs about 20 cycles
+// per measured call.
+// #define ENABLE_CYCLE_PROFILING // Uncomment to enable. Default disabled.
+
 // Configure rapid, feed, and spindle override settings. These values define the max and min
 // allowable override values and the coarse and fine increments per command received. Please
 // note the allowable values in the descriptions following each define.
@@ -278,6 +293,11 @@
 #define REPORT_FIELD_OVERRIDES // Default enabled. Comment to disable.
 #define REPORT_FIELD_LINE_NUMBERS // Default enabled. Comment to disable.
 
+// Adds the number of step segment buffer underruns since power-up to the status report, as '|Un:'.
+// An underrun is the steppers running out of segments mid-cycle, with motion still in the planner.
+// Not part of the standard Grbl v1.1 report. For validating worst case programs.
+// #define REPORT_FIELD_SEGMENT_UNDERRUNS // Default disabled. Uncomment to enable.
+
 // Some status report data isn't necessary for realtime, only intermittently, because the values don't
 // change often. The following macros configures how many times a status report needs to be called before
 // the associated data is refreshed and included in the status report. However, if one of these value
@@ -308,6 +328,36 @@
 // step smoothing. See stepper.c for more details on the AMASS system works.
 #define ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING  // Default enabled. Comment to disable.
 
+// Jerk-limited (S-curve) velocity profiles. The planner still plans each block as a trapezoid, but
+// the segment generator traces every acceleration and deceleration ramp as a 7-phase profile (jerk up,
+// constant acceleration, jerk down on each side) limited by the per-axis jerk settings $140-$147.
+// Each ramp keeps the exact duration and distance of its trapezoid ramp, so junction and exit speeds
+// are unchanged. The planner uses a lower acceleration to leave room for the jerk phases, so the peak
+// acceleration never exceeds $120-$127. Ramps faster than the programmed speed, after a feed override
+// increase, may exceed the jerk limit instead. Feed hold and override decelerations stay trapezoidal,
+// at the lower planned acceleration. A zero jerk setting on the move's axes disables shaping for that move.
+// #define JERK_LIMITED_PROFILES // Default disabled. Uncomment to enable.
+
+// Generates the step and direction pulses by DMA instead of one stepper interrupt per step event.
+// TIM8 ticks every microsecond and DMA2 Stream1 copies one word per tick from a double-buffered
+// table into the step port BSRR register. Each time a half of the table has been sent, its
+// interrupt renders the next STEP_DMA_CHUNK microseconds of Bresenham step and direction edges
+// from the segment buffer, so the CPU wakes up every 256usec regardless of step rate and all
+// axes can step at up to half the tick rate less the pulse width.
+// NOTE: Requires the step and direction pins on the same port. Step timing is quantized to 1usec
+// and the machine position runs up to two chunks ahead of the pins while moving. Homing and
+// probing cycles always use the stepper interrupts, since they must stop on the exact step.
+// #define STEP_GENERATION_DMA // Default disabled. Uncomment to enable.
+#define STEP_DMA_CHUNK 256 // Table half size in 1usec ticks. Must be even.
+
+// Ends the step pulses of The Stepper Driver Interrupt in hardware. TIM8 times each pulse in one-pulse
+// mode and its update event has DMA2 Stream1 write the idle step pin levels to the step port BSRR
+// register, so The Stepper Port Reset Interrupt (TIM3) is not used and each step costs one interrupt.
+// The pulse lasts settings.pulse_microseconds, counted at the timer clock, without interrupt latency.
+// NOTE: Uses the timer and DMA stream of STEP_GENERATION_DMA, so both cannot be enabled. TIM1 is the
+// HAL time base and DMA1 cannot reach the GPIO ports, so no other pair is available.
+#define STEP_PULSE_DMA_RESET // Default enabled. Comment to disable.
+
 // Sets the maximum step rate allowed to be written as a Grbl setting. This option enables an error
 // check in the settings module to prevent settings values that will exceed this limitation. The maximum
 // step rate is strictly limited by the CPU speed and will change if something other than an AVR running
@@ -401,6 +451,12 @@
 // bogged down by too many trig calculations.
 #define N_ARC_CORRECTION 12 // Integer (1-255)
 
+// Plans each G2/G3 arc as a single planner block, instead of hundreds of short line motions that fill
+// the look-ahead buffer and keep the arc below its programmed feed rate. The junctions at the arc ends
+// follow the arc tangents, the speed along the arc is limited by its centripetal acceleration, and the
+// step segment generator traces the arc with chords within the arc tolerance ($12). Not for COREXY.
+#define NATIVE_ARCS // Default enabled. Comment to disable.
+
 // The arc G2/3 g-code standard is problematic by definition. Radius-based arcs have horrible numerical
 // errors when arc at semi-circles(pi) or full-circles(2*pi). Offset-based arcs are much more accurate
 // but still have a problem when arcs are full-circles (2*pi). This define accounts for the floating
@@ -434,7 +490,44 @@
 // available RAM, like when re-compiling for a Mega2560. Or decrease if the Arduino begins to
 // crash due to the lack of available RAM or if the CPU is having trouble keeping up with planning
 // new incoming motions as they are executed.
-// #define BLOCK_BUFFER_SIZE 16 // Uncomment to override default in planner.h.
+// NOTE: The STM32F746 has room for several hundred blocks (each block is under 100 bytes). A deeper
+// buffer holds more path distance, so dense short-segment programs can reach their programmed feed.
+// Ring buffer indices are 16-bit. '$33' sets the depth in use at runtime, up to BLOCK_BUFFER_SIZE-1,
+// and '$I' reports it.
+#define BLOCK_BUFFER_SIZE 128 // Comment to use default in planner.h.
+
+// Upper bound on the number of blocks walked by the planner recalculation after each streamed block.
+// Older blocks keep their current, always safe, entry speeds. This also limits the look-ahead: only
+// the newest PLANNER_RECALC_MAX_BLOCKS blocks can still speed up, however deep the buffer ('$33'). A
+// '$33' at or below it plans as without it. Feed hold and override replans are not bounded by it.
+// In the simulator, 3000 segments of 0.1 mm at 6000 mm/min take as long with 64 as with the full 127
+// blocks, and 14% longer with 32. Must be less than BLOCK_BUFFER_SIZE.
+#define PLANNER_RECALC_MAX_BLOCKS 64 // Comment to always replan the whole buffer.
+
+// Depth of the parse-ahead queue between the g-code parser and the planner. When the planner buffer is
+// full, parsed and validated line motions and native arcs wait here and the protocol loop goes on to
+// parse and error check the next lines, rather than spinning in mc_line(). Queued motions enter the planner in order as
+// soon as blocks are freed, at every realtime check point. Commands that sync the buffer also empty the
+// queue first. NOTE: A line is acknowledged with 'ok' once queued, not once planned.
+#define MOTION_QUEUE_SIZE 32 // Default enabled. Comment to disable.
+
+// Joins nearly collinear line motions waiting in the parse-ahead queue into one, as long as no point
+// strays more than this distance (mm) from the joined line and the feed rate, spindle speed and
+// conditions are the same. Dense CAM surface paths then take fewer planner blocks and planner passes,
+// and the look-ahead covers more distance. Only motions that have not entered the planner yet are
+// joined. Keep well below the junction deviation and the arc tolerance. Requires MOTION_QUEUE_SIZE.
+#define MOTION_MERGE_TOLERANCE 0.002f // mm. Default enabled. Comment to disable.
+
+// Runs step segment preparation in its own FreeRTOS task, above the protocol task that parses, plans
+// and reports. The stepper interrupts wake it at the segment buffer low-water mark, so the buffer is
+// refilled even while the protocol task is busy with a '$$' dump, a flash write or a slow USB host.
+// The planner and stepper prep state is shared through a recursive mutex. It is held by the planner
+// and stepper entry points and by the realtime state machine, but never while reporting.
+#define SEGMENT_PREP_TASK // Default enabled. Comment to disable.
+
+// Number of step segments left in the buffer when the stepper interrupts wake the segment prep task.
+// A higher mark refills earlier and more often. Must be less than SEGMENT_BUFFER_SIZE.
+#define SEGMENT_PREP_LOW_WATER 3 // Default 3 of 5 usable segments.
 
 // Governs the size of the intermediary step segment buffer between the step execution algorithm
 // and the planner blocks. Each segment is set of steps executed at a constant velocity over a
@@ -458,15 +551,29 @@
 // buffer to store incoming blocks to be processed by Grbl when its ready. Most streaming
 // interfaces will character count and track each block send to each block response. So,
 // increase the receive buffer if a deeper receive buffer is needed for streaming and avaiable
-// memory allows. The send buffer primarily handles messages in Grbl. Only increase if large
+// memory allows.
+// NOTE: Over USB, a full receive buffer stops the OUT endpoint, which then NAKs all data, including
+// the realtime commands. A reset, feed hold or cycle start sent meanwhile waits behind the stream
+// until the protocol loop has made room. Hosts must use character counting against the Bf: field of
+// the status report (or the 'ok' responses) and never fill the buffer. Send-and-wait streaming never
+// fills it. The send buffer primarily handles messages in Grbl. Only increase if large
 // messages are sent and Grbl begins to stall, waiting to send the rest of the message.
 // NOTE: Grbl generates an average status report in about 0.5msec, but the serial TX stream at
 // 115200 baud will take 5 msec to transmit a typical 55 character report. Worst case reports are
 // around 90-100 characters. As long as the serial TX buffer doesn't get continually maxed, Grbl
 // will continue operating efficiently. Size the TX buffer around the size of a worst-case report.
-// #define RX_BUFFER_SIZE 128 // (1-254) Uncomment to override defaults in serial.h
+// #define RX_BUFFER_SIZE 4095 // (64-65534) Uncomment to override defaults in serial.h
 // #define TX_BUFFER_SIZE 100 // (1-254)
 
+// Messages to the host are queued in the USB transmit ring buffer (APP_TX_DATA_SIZE in usbd_cdc_if.c)
+// and sent from the USB transfer complete interrupt, so Grbl only waits on the host when the ring is
+// full. It then waits for the whole message to fit, since a lost 'ok' stalls a streaming host, but
+// for no longer than CDC_TX_TIMEOUT. A message that still does not fit is dropped, and so is any
+// message that does not fit right away, until the host takes data again. Uncomment
+// CDC_TX_DROP_ON_OVERFLOW to never wait and drop messages that do not fit instead.
+#define CDC_TX_TIMEOUT 50 // Milliseconds (1-1000)
+// #define CDC_TX_DROP_ON_OVERFLOW // Default disabled. Uncomment to enable.
+
 // A simple software debouncing feature for hard limit switches. When enabled, the interrupt 
 // monitoring the hard limit switch pins will enable the Arduino's watchdog timer to re-check 
 // the limit pin state after a delay of about 32msec. This can help with CNC machines with 
@@ -536,7 +643,34 @@
 // NOTE: Most EEPROM write commands are implicitly blocked during a job (all '$' commands). However,
 // coordinate set g-code commands (G10,G28/30.1) are not, since they are part of an active streaming
 // job. At this time, this option only forces a planner buffer sync with these g-code commands.
-#define FORCE_BUFFER_SYNC_DURING_EEPROM_WRITE // Default enabled. Comment to disable.
+// NOTE: On this target, EEPROM writes only update a RAM shadow of the settings and are written back
+// to the AT45 flash in the background while idle. No interrupt is paused, so the sync is not needed.
+// #define FORCE_BUFFER_SYNC_DURING_EEPROM_WRITE // Default disabled. Uncomment to enable.
+
+// AT45 flash pages holding the log-structured persistent store (kvstore.c). Each settings, coordinate
+// system or persistent # parameter change appends a record to the next page of this ring, so every
+// page is rewritten once per lap instead of the same page on each change. Pages 0 to 10 hold the old
+// fixed EEPROM layout, read once at power-up to migrate it. Pages above are left for other data.
+// NOTE: Moving the range on a machine in use loses the records outside the new range.
+#define FLASH_STORE_FIRST_PAGE 16
+#define FLASH_STORE_LAST_PAGE  1023
+
+// Enables uploading a g-code program into the AT45 flash and running it from there with '$FR' (see
+// job.c), so host latency or USB hiccups can't starve the planner. The host is then only needed for
+// status reports and realtime commands. The pages hold a header page followed by the program.
+#define JOB_STORAGE // Default enabled. Comment to disable.
+#define JOB_STORE_FIRST_PAGE 1024
+#define JOB_STORE_LAST_PAGE  2047
+
+// Enables binary motion packets on the USB link, alongside text g-code (see packet.c). Hosts that
+// already have their toolpath as floats, like OpenPnP, send lines, arcs, spindle, output and dwell
+// commands that skip the text parser and go straight to motion control. Packets are acknowledged
+// after every PACKET_ACK_BATCH packets, or as soon as no more data is waiting. A frame still
+// incomplete after PACKET_TIMEOUT milliseconds without data is abandoned by the USB receive
+// interrupt, so the host can send a reset to resync.
+#define BINARY_PROTOCOL // Default enabled. Comment to disable.
+#define PACKET_ACK_BATCH 8
+#define PACKET_TIMEOUT 100 // (ms)
 
 // In Grbl v0.9 and prior, there is an old outstanding bug where the `WPos:` work position reported
 // may not correlate to what is executing, because `WPos:` is based on the g-code parser state, which
@@ -680,6 +814,21 @@
 // #define DUAL_AXIS_CONFIG_CNC_SHIELD_CLONE  // Uncomment to select. Comment other configs.
 
 
+/* ---------------------------------------------------------------------------------------
+   Host simulator build. See sim/README.md. The options below need the target hardware and are
+   turned off. The simulator also defines CPU_MAP_CUSTOM_STEPPER, so its virtual clock provides the
+   stepper timers and ports.
+*/
+#ifdef GRBL_SIM
+  #undef SEGMENT_PREP_TASK
+  #undef ENABLE_CYCLE_PROFILING
+  #ifdef SIM_STEP_GENERATION_DMA // grbl_sim_dma of sim/Makefile
+    #undef STEP_PULSE_DMA_RESET
+    #define STEP_GENERATION_DMA
+  #endif
+#endif
+
+
 /* ---------------------------------------------------------------------------------------
    OEM Single File Configuration Option
 
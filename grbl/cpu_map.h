@@ -71,6 +71,42 @@
 
 
 #define DIRECTION_MASK    (X_DIRECTION_BIT_DEF|Y_DIRECTION_BIT_DEF|Z_DIRECTION_BIT_DEF|A_DIRECTION_BIT_DEF|B_DIRECTION_BIT_DEF|C_DIRECTION_BIT_DEF|U_DIRECTION_BIT_DEF|V_DIRECTION_BIT_DEF) // All direction bits
+
+// Define stepper timers and step/direction port access. The step timer runs The Stepper Driver
+// Interrupt and the pulse timer runs The Stepper Port Reset Interrupt. stepper.c touches the timers
+// and the step/direction ports only through these, so a different target (or a host build with a
+// virtual clock and a pulse trace) only has to provide this block.
+#ifndef CPU_MAP_CUSTOM_STEPPER
+#define STEP_TIMER                    TIM2
+#define STEP_TIMER_IRQn               TIM2_IRQn
+#define StepTimerSetPeriod(ticks)     (STEP_TIMER->ARR = (uint32_t)(ticks) - 1)
+#define StepTimerSetPrescaler(psc)    (STEP_TIMER->PSC = (psc))
+#define StepTimerEnable()             HAL_NVIC_EnableIRQ(STEP_TIMER_IRQn)
+#define StepTimerDisable()            HAL_NVIC_DisableIRQ(STEP_TIMER_IRQn)
+#ifdef STEP_PULSE_DMA_RESET
+  // The pulse timer runs once per step in one-pulse mode and its update event ends the pulse by DMA,
+  // without interrupt. See stepper_init(). Timer clock is 2xPCLK2, twice F_TIM.
+  #define STEP_PULSE_TIMER            TIM8
+  #define StepPulseTimerSetPeriod(us) (STEP_PULSE_TIMER->ARR = 2*(uint32_t)(us)*TICKS_PER_MICROSECOND - 1)
+  #define StepPulseTimerStart()       { STEP_PULSE_TIMER->CNT = 0; STEP_PULSE_TIMER->CR1 |= TIM_CR1_CEN; }
+  #define StepPulseTimerStop()        (STEP_PULSE_TIMER->CR1 &= ~TIM_CR1_CEN)
+  #define StepPulseTimerEnable()
+  #define StepPulseTimerDisable()
+#else
+  #define STEP_PULSE_TIMER            TIM3
+  #define STEP_PULSE_TIMER_IRQn       TIM3_IRQn
+  #define StepPulseTimerSetPeriod(us) (STEP_PULSE_TIMER->ARR = (((uint32_t)(us)*TICKS_PER_MICROSECOND) >> 1))
+  #define StepPulseTimerStart()       { STEP_PULSE_TIMER->CNT = 0; HAL_TIM_Base_Start(&htim3); }
+  #define StepPulseTimerStop()        HAL_TIM_Base_Stop(&htim3)
+  #define StepPulseTimerEnable()      HAL_NVIC_EnableIRQ(STEP_PULSE_TIMER_IRQn)
+  #define StepPulseTimerDisable()     HAL_NVIC_DisableIRQ(STEP_PULSE_TIMER_IRQn)
+#endif
+#define StepTimersReload()            { STEP_TIMER->EGR = TIM_EGR_UG; STEP_PULSE_TIMER->EGR = TIM_EGR_UG; }
+// Step and direction pins share a port, also written by the pulse reset DMA. Writes go through BSRR, so
+// a DMA write never lands inside a read-modify-write of the other pins.
+#define StepPortWrite(bits)           (STEP_PORT->BSRR = ((uint32_t)(~(bits) & STEP_MASK) << 16) | ((bits) & STEP_MASK))
+#define DirectionPortWrite(bits)      (DIRECTION_PORT->BSRR = ((uint32_t)(~(bits) & DIRECTION_MASK) << 16) | ((bits) & DIRECTION_MASK))
+#endif
 // Define homing/hard limit switch input pins and limit interrupt vectors.
 // NOTE: All limit bit pins must be on the same port
 #define LIMIT_PIN_PORT   GPIOE
@@ -605,6 +605,15 @@
 #define DEFAULT_U_MAX_TRAVEL 200.0f // mm NOTE: Must be a positive value.
 #define DEFAULT_V_MAX_TRAVEL 200.0f // mm NOTE: Must be a positive value.
 
+#define DEFAULT_X_JERK (10000.0f*60*60*60) // 10000*60*60*60 mm/min^3 = 10000 mm/sec^3
+#define DEFAULT_Y_JERK (10000.0f*60*60*60) // 10000*60*60*60 mm/min^3 = 10000 mm/sec^3
+#define DEFAULT_Z_JERK (10000.0f*60*60*60) // 10000*60*60*60 mm/min^3 = 10000 mm/sec^3
+#define DEFAULT_A_JERK (10000.0f*60*60*60) // 10000*60*60*60 mm/min^3 = 10000 mm/sec^3
+#define DEFAULT_B_JERK (10000.0f*60*60*60) // 10000*60*60*60 mm/min^3 = 10000 mm/sec^3
+#define DEFAULT_C_JERK (10000.0f*60*60*60) // 10000*60*60*60 mm/min^3 = 10000 mm/sec^3
+#define DEFAULT_U_JERK (10000.0f*60*60*60) // 10000*60*60*60 mm/min^3 = 10000 mm/sec^3
+#define DEFAULT_V_JERK (10000.0f*60*60*60) // 10000*60*60*60 mm/min^3 = 10000 mm/sec^3
+
 #define DEFAULT_SPINDLE_RPM_MAX 24000.0f // rpm
 #define DEFAULT_SPINDLE_RPM_MIN 0.0f // rpm
 #define DEFAULT_STEP_PULSE_MICROSECONDS 10
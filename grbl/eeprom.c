@@ -22,6 +22,89 @@
 *                         $Date: 06/12/2019 $
 ****************************************************************************/
 #include "eeprom.h"
+#include "kvstore.h"
+
+#include <string.h>
+
+// RAM shadow of the EEPROM area. All reads and writes go to the shadow. Chunks changed since the
+// last write-back are flagged in shadow_dirty and appended to the flash store by eeprom_flush().
+static uint8_t shadow[EEPROM_SHADOW_SIZE];
+static uint64_t shadow_dirty = 0;
+
+// Fixed page layout used before the flash store. Pages 0 to 8 held the shadow, page 9 a journal
+// copy of the page being written back and page 10 its header. Only read to migrate it.
+#define LEGACY_SIZE          2304U
+#define LEGACY_JOURNAL_PAGE  9
+#define JOURNAL_MAGIC        0x4A524E4CUL
+typedef struct {
+	uint32_t magic;
+	uint32_t page;
+	uint32_t crc;
+} journal_header_t;
+
+// Reads the fixed page layout into the shadow. A page write-back interrupted by a power loss is
+// completed from its journal copy. The shadow area past the old layout is zeroed.
+static void eeprom_load_legacy(void)
+{
+	journal_header_t header;
+	uint8_t page[EEPROM_PAGE_SIZE];
+
+	memset(shadow, 0, EEPROM_SHADOW_SIZE);
+	Eeprom_Read_DMA(0, shadow, LEGACY_SIZE);
+	Eeprom_Read_DMA((uint32_t)(LEGACY_JOURNAL_PAGE+1) << 8, (uint8_t *)&header, sizeof(header));
+	Eeprom_Wait();
+	if ((header.magic == JOURNAL_MAGIC) && (header.page < LEGACY_SIZE/EEPROM_PAGE_SIZE)) {
+		Eeprom_Read_DMA((uint32_t)LEGACY_JOURNAL_PAGE << 8, page, EEPROM_PAGE_SIZE);
+		Eeprom_Wait();
+		if (kv_crc32(page, EEPROM_PAGE_SIZE) == header.crc) {
+			memcpy(&shadow[header.page << 8], page, EEPROM_PAGE_SIZE);
+		}
+	}
+}
+
+/*! \brief  Load the RAM shadow from EEPROM.
+ *
+ *  Mounts the flash store and loads each shadow chunk from its newest record. Chunks
+ *  without a record yet keep their value from the old fixed page layout and are
+ *  written to the store by the next eeprom_flush(). Called once at power-up.
+ */
+void eeprom_init(void)
+{
+	uint16_t chunk;
+
+	kv_mount(EEPROM_SHADOW_CHUNKS);
+	eeprom_load_legacy();
+	shadow_dirty = 0;
+	for (chunk = 0; chunk < EEPROM_SHADOW_CHUNKS; chunk++) {
+		if (!kv_read(chunk, &shadow[chunk*EEPROM_CHUNK_SIZE], EEPROM_CHUNK_SIZE)) {
+			shadow_dirty |= (uint64_t)1 << chunk;
+		}
+	}
+}
+
+/*! \brief  Write back one dirty shadow chunk.
+ *
+ *  Never waits on the flash. Each call appends at most one record to the flash store,
+ *  when the previous page program has completed, so it can be called repeatedly from
+ *  the main loop while idle. A record the store asks to relocate goes first.
+ *
+ *  \return  1 while a write-back is still pending, 0 once the EEPROM is up to date.
+ */
+uint8_t eeprom_flush(void)
+{
+	uint16_t chunk;
+
+	if (shadow_dirty == 0) return 0;
+	if (Eeprom_Busy()) return 1;
+	chunk = kv_relocation_key();
+	if (chunk == KV_NO_KEY) {
+		chunk = 0;
+		while (!(shadow_dirty & ((uint64_t)1 << chunk))) chunk++;
+	}
+	shadow_dirty &= ~((uint64_t)1 << chunk); // Set again if written during the page program.
+	kv_append(chunk, &shadow[chunk*EEPROM_CHUNK_SIZE], EEPROM_CHUNK_SIZE);
+	return 1;
+}
 
 /*! \brief  Read byte from EEPROM.
  *
@@ -32,87 +115,110 @@
  */
 unsigned char eeprom_get_char( unsigned int addr )
 {
-	return Eeprom_Read_Buffer((uint16_t)addr);
+	if (addr >= EEPROM_SHADOW_SIZE) return 0xFF;
+	return shadow[addr];
 }
 
 /*! \brief  Write byte to EEPROM.
  *
  *  This function writes one byte to a given EEPROM address.
- *  The differences between the existing byte and the new value is used
- *  to select the most efficient EEPROM programming mode.
  *
- *  \note  When this function returns, the new EEPROM value is not available
- *         until the EEPROM programming time has passed. The RDY/BUSY bit in Status Register
- *         should be polled to check whether the programming is finished.
+ *  \note  Only the RAM shadow is updated. The chunk is written later by eeprom_flush().
  *
  *  \param  addr  EEPROM address to write to.
  *  \param  new_value  New EEPROM value.
  */
-void eeprom_put_char( uint8_t addr, uint8_t new_value )
+void eeprom_put_char( unsigned int addr, uint8_t new_value )
 {
-	Eeprom_Fill_Buffer((uint8_t)addr, new_value);
+	if (addr >= EEPROM_SHADOW_SIZE) return;
+	if (shadow[addr] != new_value) {
+		shadow[addr] = new_value;
+		shadow_dirty |= (uint64_t)1 << (addr/EEPROM_CHUNK_SIZE);
+	}
 }
 
-// Extensions added as part of Grbl 
+/*! \brief  Read a block of bytes from EEPROM.
+ *
+ *  Copies from the RAM shadow in one go. Bytes past the shadow read as 0xFF.
+ *
+ *  \param  addr  EEPROM address to read from.
+ *  \param  data  Destination buffer.
+ *  \param  size  Number of bytes to read.
+ */
+void eeprom_get_block(unsigned int addr, void *data, unsigned int size)
+{
+	unsigned int count = 0;
+	if (addr < EEPROM_SHADOW_SIZE) {
+		count = EEPROM_SHADOW_SIZE-addr;
+		if (count > size) count = size;
+		memcpy(data, &shadow[addr], count);
+	}
+	memset((uint8_t *)data+count, 0xFF, size-count);
+}
 
-void memcpy_to_eeprom_with_checksum(unsigned int destination, char *source, unsigned int size) {
-	uint8_t addr = (destination & 0xff);
-	uint32_t bytes_left = size;
-	unsigned char checksum = 0;
-	uint32_t page_start = 0;
-	uint32_t page_stop;
-	uint32_t page;
+/*! \brief  Write a block of bytes to EEPROM.
+ *
+ *  Copies into the RAM shadow one chunk at a time. Only the chunks holding a changed
+ *  byte are written back by eeprom_flush(). Bytes past the shadow are dropped.
+ *
+ *  \param  addr  EEPROM address to write to.
+ *  \param  data  Source buffer.
+ *  \param  size  Number of bytes to write.
+ */
+void eeprom_put_block(unsigned int addr, const void *data, unsigned int size)
+{
+	const uint8_t *source = data;
+	unsigned int count;
 
+	if (addr >= EEPROM_SHADOW_SIZE) return;
+	if (size > EEPROM_SHADOW_SIZE-addr) size = EEPROM_SHADOW_SIZE-addr;
+	while (size) {
+		count = EEPROM_CHUNK_SIZE - addr%EEPROM_CHUNK_SIZE; // Up to the end of the chunk.
+		if (count > size) count = size;
+		if (memcmp(&shadow[addr], source, count) != 0) {
+			memcpy(&shadow[addr], source, count);
+			shadow_dirty |= (uint64_t)1 << (addr/EEPROM_CHUNK_SIZE);
+		}
+		addr += count;
+		source += count;
+		size -= count;
+	}
+}
 
-	page_start = destination >> 8;
-	page_stop = (destination + size) >> 8;
+// Extensions added as part of Grbl 
 
-	for (page = page_start ; page <= page_stop ; page++) {
-		Eeprom_Read_Page(page << 8);
-		while(1) {
-			checksum = (checksum << 1) || (checksum >> 7);
-			checksum += *source;
-			eeprom_put_char(addr++, *(source++));
-			bytes_left--;
-			if (addr == 0) break;
-			if (bytes_left == 0) break;
-		}
-		if (bytes_left) Eeprom_Write_Page(page << 8);
+void memcpy_to_eeprom_with_checksum(unsigned int destination, char *source, unsigned int size) {
+	unsigned char checksum = 0;
+	unsigned int idx;
+	for (idx = 0; idx < size; idx++) {
+		checksum = (checksum << 1) | (checksum >> 7);
+		checksum += source[idx];
 	}
-	eeprom_put_char(addr, checksum);
-	if (addr == 0) Eeprom_Write_Page(page << 8);
-	else Eeprom_Write_Page(--page << 8);
+	eeprom_put_block(destination, source, size);
+	eeprom_put_char(destination+size, checksum);
 }
 
 int memcpy_from_eeprom_with_checksum(char *destination, unsigned int source, unsigned int size) {
-	uint8_t addr = (source & 0xff);
-	uint32_t bytes_left = size;
-	unsigned char data;
 	unsigned char checksum = 0;
-	uint32_t page_start = 0;
-	uint32_t page_stop;
-	uint32_t page;
-
-	page_start = source >> 8;
-	page_stop = (source + size) >> 8;
-
-	for (page = page_start ; page <= page_stop ; page++) {
-		Eeprom_Read_Page(page << 8);
-		while(1) {
-			data = eeprom_get_char(addr++);
-			*(destination++) = data;
-			checksum = (checksum << 1) || (checksum >> 7);
-			checksum += data;
-			bytes_left--;
-			if (addr == 0) break;
-			if (bytes_left == 0) break;
-		}
+	unsigned int idx;
+	eeprom_get_block(source, destination, size);
+	for (idx = 0; idx < size; idx++) {
+		checksum = (checksum << 1) | (checksum >> 7);
+		checksum += destination[idx];
 	}
-	if (addr == 0) {
-		Eeprom_Read_Page(page << 8);
+	return(checksum == eeprom_get_char(source+size));
+}
+
+// Checksum of Grbl 1.1h, where a logical OR in the rotate reduced it to little more than the last
+// byte. Only used to migrate version 10 data, see settings.c.
+int memcpy_from_eeprom_with_legacy_checksum(char *destination, unsigned int source, unsigned int size) {
+	unsigned char checksum = 0;
+	unsigned int idx;
+	eeprom_get_block(source, destination, size);
+	for (idx = 0; idx < size; idx++) {
+		checksum = (checksum != 0) + destination[idx];
 	}
-	data = eeprom_get_char(addr);
-	return(checksum == data);
+	return(checksum == eeprom_get_char(source+size));
 }
 
 // end of file
@@ -25,9 +25,21 @@
 #include "stm32f7xx.h"
 #include "../BSP/AT45DBXX/AT45DBXX.h"
 
+// RAM shadow of the EEPROM area holding the settings.h layout. Loaded once by eeprom_init(). Reads
+// and writes only touch the shadow. eeprom_flush() appends changed chunks to the flash store
+// (kvstore.c) in the background, one record per chunk keyed by its index.
+#define EEPROM_SHADOW_SIZE    4352U // Must cover the settings.h layout.
+#define EEPROM_CHUNK_SIZE     128U
+#define EEPROM_SHADOW_CHUNKS  (EEPROM_SHADOW_SIZE/EEPROM_CHUNK_SIZE)
+
+void eeprom_init(void);
+uint8_t eeprom_flush(void);
 unsigned char eeprom_get_char(unsigned int addr);
-void eeprom_put_char(uint8_t addr, uint8_t new_value);
+void eeprom_put_char(unsigned int addr, uint8_t new_value);
+void eeprom_get_block(unsigned int addr, void *data, unsigned int size);
+void eeprom_put_block(unsigned int addr, const void *data, unsigned int size);
 void memcpy_to_eeprom_with_checksum(unsigned int destination, char *source, unsigned int size);
 int memcpy_from_eeprom_with_checksum(char *destination, unsigned int source, unsigned int size);
+int memcpy_from_eeprom_with_legacy_checksum(char *destination, unsigned int source, unsigned int size);
 
 #endif
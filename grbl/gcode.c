@@ -37,6 +37,8 @@ parser_state_t gc_state;
 parser_block_t gc_block;
 
 #define FAIL(status) return(status);
+// Rejects the words of axes not built in. See N_AXIS in config.h.
+#define AXIS_WORD_CHECK(axis) if ((axis) >= N_AXIS) { FAIL(STATUS_GCODE_UNSUPPORTED_COMMAND); }
 
 
 void gc_init()
@@ -109,7 +111,7 @@ uint8_t gc_execute_line(char *line)
   uint32_t char_counter;
   char letter;
   float value;
-  int int_value = 0;
+  int32_t int_value = 0;
   uint16_t mantissa = 0;
 
   if (gc_parser_flags & GC_PARSER_JOG_MOTION) { char_counter = 3; } // Start parsing after `$J=`
@@ -122,19 +124,13 @@ uint8_t gc_execute_line(char *line)
     if((letter < 'A') || (letter > 'Z')) { FAIL(STATUS_EXPECTED_COMMAND_LETTER); } // [Expected word letter]
     char_counter++;
 
-    //@ TODO changer le code de retour et interpreter les erreurs
-    if (!read_float(line, &char_counter, &value)) { FAIL(STATUS_BAD_NUMBER_FORMAT); } // [Expected word value]
-
-    // Convert values to smaller uint8 significand and mantissa values for parsing this word.
+    // The integer value and mantissa are split from the decimal digits while reading the word.
     // NOTE: Mantissa is multiplied by 100 to catch non-integer command values. This is more
     // accurate than the NIST gcode requirement of x10 when used for commands, but not quite
     // accurate enough for value words that require integers to within 0.0001. This should be
-    // a good enough comprimise and catch most all non-integer errors. To make it compliant,
-    // we would simply need to change the mantissa to int16, but this add compiled flash space.
-    // Maybe update this later.
-    int_value = (int)truncf(value);
-    mantissa = (uint16_t)lroundf(100 * (value - (float)int_value)); // Compute mantissa for Gxx.x commands.
-    // NOTE: Rounding must be used to catch small floating point errors.
+    // a good enough comprimise and catch most all non-integer errors.
+    //@ TODO changer le code de retour et interpreter les erreurs
+    if (!read_number(line, &char_counter, &value, &int_value, &mantissa)) { FAIL(STATUS_BAD_NUMBER_FORMAT); } // [Expected word value]
 
     // Check if the g-code word is supported or errors due to modal group violations or has
     // been repeated in the g-code block. If ok, update the command or record its value.
@@ -357,49 +353,49 @@ uint8_t gc_execute_line(char *line)
 
           	  	     case MAP_P3 :
           	  	     case MAP_P4 : word_bit = WORD_U;
-          	  	            	   gc_block.values.xyz[U_AXIS] = value;
+          	  	            	   AXIS_WORD_CHECK(U_AXIS); gc_block.values.xyz[U_AXIS] = value;
           	  	            	   axis_words |= (1<<U_AXIS);
           	  	            	   break;
           	  	  	}
           	  	  	break;
           case 'U': if (gc_state.z_select == MAP_P0) {
-        	  	  	  word_bit = WORD_U; gc_block.values.xyz[U_AXIS] = value; axis_words |= (1<<U_AXIS);
+        	  	  	  word_bit = WORD_U; AXIS_WORD_CHECK(U_AXIS); gc_block.values.xyz[U_AXIS] = value; axis_words |= (1<<U_AXIS);
           	  	    }
           	  	  	break;
           case 'V': if (gc_state.z_select == MAP_P0) {
-        	  	  	  word_bit = WORD_V; gc_block.values.xyz[V_AXIS] = value; axis_words |= (1<<V_AXIS);
+        	  	  	  word_bit = WORD_V; AXIS_WORD_CHECK(V_AXIS); gc_block.values.xyz[V_AXIS] = value; axis_words |= (1<<V_AXIS);
           	  	    }
           	  	  	break;
           case 'W': if (gc_state.z_select == MAP_P0) {
-        	  	  	  word_bit = WORD_W; gc_block.values.xyz[W_AXIS] = value; axis_words |= (1<<W_AXIS);
+        	  	  	  word_bit = WORD_W; AXIS_WORD_CHECK(W_AXIS); gc_block.values.xyz[W_AXIS] = value; axis_words |= (1<<W_AXIS);
                     }
           	  	    break;
           case 'A': switch (gc_state.z_select) {
 	  	  	        	case MAP_P0 :
 	  	  	        	case MAP_P1 : word_bit = WORD_A;
-	  	  	        				  gc_block.values.xyz[A_AXIS] = value;
+	  	  	        				  AXIS_WORD_CHECK(A_AXIS); gc_block.values.xyz[A_AXIS] = value;
 	  	  	        				  axis_words |= (1<<A_AXIS);
 	  	  	        				  break;
 	  	  	        	case MAP_P2 : word_bit = WORD_B;
-	  	  	        	  	  	      gc_block.values.xyz[B_AXIS] = value;
+	  	  	        	  	  	      AXIS_WORD_CHECK(B_AXIS); gc_block.values.xyz[B_AXIS] = value;
 	  	  	        	  	  	      axis_words |= (1<<B_AXIS);
 	  	  	        	  	  	      break;
 	  	  	        	case MAP_P3 : word_bit = WORD_C;
-	  	  	    	  	  	          gc_block.values.xyz[C_AXIS] = value;
+	  	  	    	  	  	          AXIS_WORD_CHECK(C_AXIS); gc_block.values.xyz[C_AXIS] = value;
 	  	  	    	  	  	          axis_words |= (1<<C_AXIS);
 	  	  	    	  	  	          break;
 	  	  	        	case MAP_P4 : word_bit = WORD_V;
-	  	  		  	  	        	  gc_block.values.xyz[V_AXIS] = value;
+	  	  		  	  	        	  AXIS_WORD_CHECK(V_AXIS); gc_block.values.xyz[V_AXIS] = value;
 	  	  		  	  	        	  axis_words |= (1<<V_AXIS);
 	  	  		  	  	        	  break;
           	  	  	}
                     break;
           case 'B': if (gc_state.z_select == MAP_P0) {
-        	  	  	  word_bit = WORD_B; gc_block.values.xyz[B_AXIS] = value; axis_words |= (1<<B_AXIS);
+        	  	  	  word_bit = WORD_B; AXIS_WORD_CHECK(B_AXIS); gc_block.values.xyz[B_AXIS] = value; axis_words |= (1<<B_AXIS);
           	  	    }
           	  	    break;
           case 'C': if (gc_state.z_select == MAP_P0) {
-        	  	  	  word_bit = WORD_C; gc_block.values.xyz[C_AXIS] = value; axis_words |= (1<<C_AXIS);
+        	  	  	  word_bit = WORD_C; AXIS_WORD_CHECK(C_AXIS); gc_block.values.xyz[C_AXIS] = value; axis_words |= (1<<C_AXIS);
           	  	    }
           	  	  	break;
           default: FAIL(STATUS_GCODE_UNSUPPORTED_COMMAND);
@@ -465,6 +461,17 @@ uint8_t gc_execute_line(char *line)
 	  if (gc_block.modal.plcio == PLC_WAIT_INPUT_EVENT) {
 		  if (bit_isfalse(value_words,bit(bit(WORD_L)|bit(WORD_Q)))) { FAIL(STATUS_GCODE_VALUE_WORD_MISSING);} // [P,L,Q words missing for M62 and M66]
 	  }
+	  #if N_AXIS < 8
+	    // The multihead Z maps need the axes they map. See N_AXIS in config.h.
+	    if (gc_block.modal.map_z == MAP_Z) {
+	      switch ((uint8_t)gc_block.values.p) {
+	        case MAP_P1 : if (N_AXIS < 4) { FAIL(STATUS_GCODE_UNSUPPORTED_COMMAND); } break;
+	        case MAP_P2 : if (N_AXIS < 5) { FAIL(STATUS_GCODE_UNSUPPORTED_COMMAND); } break;
+	        case MAP_P3 : if (N_AXIS < 7) { FAIL(STATUS_GCODE_UNSUPPORTED_COMMAND); } break;
+	        case MAP_P4 : FAIL(STATUS_GCODE_UNSUPPORTED_COMMAND);
+	      }
+	    }
+	  #endif
 	  bit_false(value_words,bit(WORD_P)|bit(WORD_L)|bit(WORD_Q));
   	}
 
@@ -32,6 +32,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "stm32f7xx_hal.h"
 
@@ -45,6 +46,9 @@
 #include "planner.h"
 #include "coolant_control.h"
 #include "eeprom.h"
+#include "kvstore.h"
+#include "job.h"
+#include "packet.h"
 #include "gcode.h"
 #include "grbl_limits.h"
 #include "motion_control.h"
@@ -58,10 +62,15 @@
 #include "jog.h"
 #include "plc_io.h"
 #include "param.h"
+#include "profile.h"
 
 // ---------------------------------------------------------------------------------------
 // COMPILE-TIME ERROR CHECKING OF DEFINE VALUES:
 
+#if (N_AXIS < 3) || (N_AXIS > 8)
+  #error "N_AXIS must be from 3 to 8."
+#endif
+
 #ifndef HOMING_CYCLE_0
   #error "Required HOMING_CYCLE_0 not defined."
 #endif
@@ -96,6 +105,91 @@
   #endif
 #endif
 
+#if (BLOCK_BUFFER_SIZE < 2) || (BLOCK_BUFFER_SIZE > 1024)
+  #error "BLOCK_BUFFER_SIZE must be between 2 and 1024."
+#endif
+
+#if defined(PLANNER_RECALC_MAX_BLOCKS)
+  #if (PLANNER_RECALC_MAX_BLOCKS < 2) || (PLANNER_RECALC_MAX_BLOCKS >= BLOCK_BUFFER_SIZE)
+    #error "PLANNER_RECALC_MAX_BLOCKS must be at least 2 and less than BLOCK_BUFFER_SIZE."
+  #endif
+#endif
+
+#if defined(MOTION_QUEUE_SIZE)
+  #if (MOTION_QUEUE_SIZE < 1) || (MOTION_QUEUE_SIZE > 255)
+    #error "MOTION_QUEUE_SIZE must be between 1 and 255."
+  #endif
+#endif
+
+#if defined(NATIVE_ARCS) && defined(COREXY)
+  #error "NATIVE_ARCS does not support COREXY."
+#endif
+
+#if defined(MOTION_MERGE_TOLERANCE) && !defined(MOTION_QUEUE_SIZE)
+  #error "MOTION_MERGE_TOLERANCE requires MOTION_QUEUE_SIZE."
+#endif
+
+#if defined(SEGMENT_PREP_TASK)
+  #if (SEGMENT_PREP_LOW_WATER < 1) || (SEGMENT_PREP_LOW_WATER >= SEGMENT_BUFFER_SIZE)
+    #error "SEGMENT_PREP_LOW_WATER must be at least 1 and less than SEGMENT_BUFFER_SIZE."
+  #endif
+#endif
+
+#if (EEPROM_ADDR_BUILD_INFO+LINE_BUFFER_SIZE+EEPROM_CHECKSUM_SIZE > EEPROM_ADDR_USER_PARAMETERS) || \
+    (EEPROM_ADDR_USER_PARAMETERS+N_PERSISTENT_PARAMETER*4 > EEPROM_SHADOW_SIZE)
+  #error "EEPROM layout in settings.h overlaps or exceeds EEPROM_SHADOW_SIZE."
+#endif
+
+#if (EEPROM_SHADOW_SIZE % EEPROM_CHUNK_SIZE) || (EEPROM_CHUNK_SIZE > KV_MAX_DATA_SIZE) || \
+    (EEPROM_SHADOW_CHUNKS > 64) || (EEPROM_SHADOW_CHUNKS > KV_MAX_KEYS)
+  #error "EEPROM shadow must be a multiple of at most 64 chunks, each fitting a flash store record."
+#endif
+
+#if (FLASH_STORE_FIRST_PAGE < 11) || (FLASH_STORE_LAST_PAGE > 2047) || \
+    (FLASH_STORE_LAST_PAGE-FLASH_STORE_FIRST_PAGE < 2*EEPROM_SHADOW_CHUNKS)
+  #error "FLASH_STORE pages must be within pages 11-2047 and at least twice the shadow chunk count."
+#endif
+
+#if defined(JOB_STORAGE)
+  #if (JOB_STORE_FIRST_PAGE <= FLASH_STORE_LAST_PAGE) || (JOB_STORE_LAST_PAGE > 2047) || (JOB_STORE_LAST_PAGE <= JOB_STORE_FIRST_PAGE)
+    #error "JOB_STORE pages must follow the FLASH_STORE pages, up to page 2047."
+  #endif
+#endif
+
+#if (RX_BUFFER_SIZE < 64) || (RX_BUFFER_SIZE > 65534)
+  #error "RX_BUFFER_SIZE must hold a full USB packet and fit 16-bit indices (64-65534)."
+#endif
+
+#if defined(STEP_GENERATION_DMA)
+  #if (STEP_DMA_CHUNK < 16) || (STEP_DMA_CHUNK & 1)
+    #error "STEP_DMA_CHUNK must be even and at least 16."
+  #endif
+  #if !defined(ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING)
+    #error "STEP_GENERATION_DMA requires ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING."
+  #endif
+  #if defined(STEP_PULSE_DELAY) || defined(ENABLE_DUAL_AXIS)
+    #error "STEP_GENERATION_DMA not supported with STEP_PULSE_DELAY or dual axis feature."
+  #endif
+#endif
+
+#if defined(STEP_PULSE_DMA_RESET)
+  #if defined(STEP_GENERATION_DMA)
+    #error "STEP_PULSE_DMA_RESET and STEP_GENERATION_DMA both use TIM8 and DMA2 Stream1."
+  #endif
+  #if defined(STEP_PULSE_DELAY) || defined(ENABLE_DUAL_AXIS)
+    #error "STEP_PULSE_DMA_RESET not supported with STEP_PULSE_DELAY or dual axis feature."
+  #endif
+#endif
+
+#if defined(BINARY_PROTOCOL)
+  #if (PACKET_ACK_BATCH < 1) || (PACKET_ACK_BATCH > 255)
+    #error "PACKET_ACK_BATCH must be between 1 and 255."
+  #endif
+  #if (CMD_RESET == PACKET_START) || (CMD_STATUS_REPORT == PACKET_START) || (CMD_CYCLE_START == PACKET_START) || (CMD_FEED_HOLD == PACKET_START)
+    #error "PACKET_START must not be a realtime command character."
+  #endif
+#endif
+
 #if (REPORT_WCO_REFRESH_BUSY_COUNT < REPORT_WCO_REFRESH_IDLE_COUNT)
   #error "WCO busy refresh is less than idle refresh."
 #endif
@@ -12,7 +12,7 @@ volatile uint32_t sys_rt_exec_alarm;   // Global realtime executor bitflag varia
 volatile uint32_t sys_rt_exec_motion_override; // Global realtime executor bitflag variable for motion-based overrides.
 volatile uint32_t sys_rt_exec_accessory_override; // Global realtime executor bitflag variable for spindle/coolant overrides.
 uint32_t inputs_state;
-uint16_t outputs_state;
+DMA_BUFFER uint16_t outputs_state; // Sent to the output shift registers by SPI2 DMA
 
 #ifdef DEBUG
 volatile uint8_t sys_rt_exec_debug;
@@ -22,7 +22,13 @@ volatile uint8_t sys_rt_exec_debug;
 void grbl_init(void)
 {
 	settings_init(); // Load Grbl settings from EEPROM
+	#ifdef JOB_STORAGE
+		job_init();     // Load the stored job header
+	#endif
 	stepper_init();  // Configure stepper pins and interrupt timers
+	#ifdef ENABLE_CYCLE_PROFILING
+		profile_init(); // Start the DWT cycle counter
+	#endif
 	system_init();   // Configure pinout pins and pin-change interrupt
 
 	memset(sys_position,0,sizeof(sys_position)); // Clear machine position.
@@ -75,7 +81,16 @@ void grbl_init(void)
 	    limits_init();
 	    probe_init();
 	    plan_reset(); // Clear block buffer and planner variables
+#ifdef MOTION_QUEUE_SIZE
+	    mc_queue_clear(); // Clear parse-ahead queued motions
+#endif
 	    st_reset(); // Clear stepper subsystem variables.
+#ifdef JOB_STORAGE
+	    job_reset(); // Stop a running job or upload
+#endif
+#ifdef BINARY_PROTOCOL
+	    packet_reset(); // Restart the binary packet sequence
+#endif
 
 	    // Sync cleared gcode and planner positions to current system position.
 	    plan_sync_position();
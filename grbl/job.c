@@ -0,0 +1,263 @@
+/*
+  job.c - g-code program storage in the AT45 flash and standalone execution
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef JOB_STORAGE
+
+// A program is uploaded with the usual streaming protocol, but between '$FU' and '$FE' every line
+// is stored instead of executed and answered with 'ok' right away. Lines are stored as the protocol
+// passes them on: without spaces and comments, in upper case, each ended with '\n'. The CRC32 of the
+// program checks the upload and is verified again before each run.
+//
+//   $F             Reports [JOB:<state>,<size>,<crc32>]. State is EMPTY, UPLOAD, READY or RUN.
+//   $FU            Starts a new upload. The stored program is invalidated.
+//   $FU=<size>     Resumes an upload interrupted by a lost connection or a reset, after the <size>
+//                  stored bytes reported by '$F'. Accepted while still uploading, too. Not possible
+//                  after a power loss.
+//   $FE[=<crc32>]  Ends the upload. With a CRC32 in hexadecimal, the program is only kept if it matches.
+//   $FR            Runs the stored program [IDLE/CHECK]. Only errors are reported, and stop the job.
+//
+// The first page holds the header, written last, and the program follows on the next pages.
+#define JOB_MAGIC      0x31424F4AUL // "JOB1"
+#define JOB_DATA_PAGE  (JOB_STORE_FIRST_PAGE+1)
+#define JOB_MAX_SIZE   ((uint32_t)(JOB_STORE_LAST_PAGE-JOB_STORE_FIRST_PAGE)*EEPROM_PAGE_SIZE)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t size;
+  uint32_t crc;
+} job_header_t;
+
+static uint8_t job_state;
+static uint32_t job_size;   // Program size, or bytes stored so far by an upload
+static uint32_t job_crc;    // Program CRC32, or CRC32 of the bytes stored so far by an upload
+static uint32_t job_offset; // Next program byte read by a run
+
+// Upload page being filled in buffer 0. While running, the current page and the page read ahead.
+static uint8_t job_buffer[2][EEPROM_PAGE_SIZE];
+static uint8_t job_buffer_select;
+static uint16_t job_buffer_pos;
+static uint16_t job_buffer_len;
+
+
+static uint32_t job_data_address(uint32_t offset)
+{
+  return(((uint32_t)JOB_DATA_PAGE << 8)+offset);
+}
+
+
+static uint16_t job_page_length(uint32_t offset)
+{
+  if (job_size-offset < EEPROM_PAGE_SIZE) { return(job_size-offset); }
+  return(EEPROM_PAGE_SIZE);
+}
+
+
+// Programs the header page. A zero magic invalidates the stored program.
+static void job_write_header(uint32_t magic)
+{
+  job_header_t *header = (job_header_t *)job_buffer[1];
+  memset(job_buffer[1], 0xFF, EEPROM_PAGE_SIZE);
+  header->magic = magic;
+  header->size = job_size;
+  header->crc = job_crc;
+  Eeprom_Write_Page_DMA(JOB_STORE_FIRST_PAGE, job_buffer[1]);
+}
+
+
+// Reads the whole stored program back and checks it against the CRC32 of the header.
+static uint8_t job_verify()
+{
+  uint32_t offset, crc = 0;
+  uint16_t length;
+  for (offset=0; offset<job_size; offset+=length) {
+    length = job_page_length(offset);
+    Eeprom_Read_DMA(job_data_address(offset), job_buffer[0], length);
+    Eeprom_Wait();
+    crc = kv_crc32_update(crc, job_buffer[0], length);
+  }
+  return(crc == job_crc);
+}
+
+
+// Reads an unsigned number in the given base. Returns false if there is none or it is followed by
+// anything else.
+static uint8_t job_read_number(char *line, uint8_t base, uint32_t *value)
+{
+  uint8_t digit;
+  if (*line == 0) { return(false); }
+  *value = 0;
+  while (*line != 0) {
+    if ((*line >= '0') && (*line <= '9')) { digit = *line-'0'; }
+    else if ((*line >= 'A') && (*line <= 'F')) { digit = *line-'A'+10; }
+    else { return(false); }
+    if (digit >= base) { return(false); }
+    *value = *value*base+digit;
+    line++;
+  }
+  return(true);
+}
+
+
+void job_init()
+{
+  job_header_t header;
+  Eeprom_Read_DMA((uint32_t)JOB_STORE_FIRST_PAGE << 8, (uint8_t *)&header, sizeof(header));
+  Eeprom_Wait();
+  job_state = JOB_STATE_EMPTY;
+  job_size = 0;
+  job_crc = 0;
+  if ((header.magic == JOB_MAGIC) && (header.size <= JOB_MAX_SIZE)) {
+    job_state = JOB_STATE_READY;
+    job_size = header.size;
+    job_crc = header.crc;
+  }
+}
+
+
+void job_reset()
+{
+  if (job_state == JOB_STATE_RUN) { job_state = JOB_STATE_READY; }
+  // Keeps the stored size, CRC and partial page for '$FU=<size>'.
+  if (job_state == JOB_STATE_UPLOAD) { job_state = JOB_STATE_EMPTY; }
+}
+
+
+uint8_t job_execute_line(char *line)
+{
+  uint32_t value;
+  if (job_state == JOB_STATE_RUN) { return(STATUS_IDLE_ERROR); } // Not from the program itself.
+  switch (line[2]) {
+    case 0 :
+      report_job_info(job_state, job_size, job_crc);
+      break;
+    case 'U' : // Start or resume an upload [IDLE]
+      if (sys.state != STATE_IDLE) { return(STATUS_IDLE_ERROR); }
+      if (line[3] == 0) {
+        job_size = 0;
+        job_crc = 0;
+      } else {
+        if (line[3] != '=') { return(STATUS_INVALID_STATEMENT); }
+        if (!job_read_number(&line[4], 10, &value)) { return(STATUS_BAD_NUMBER_FORMAT); }
+        // Also from an upload still in progress, when the host lost track of the lines stored.
+        if ((job_state != JOB_STATE_EMPTY) && (job_state != JOB_STATE_UPLOAD)) { return(STATUS_JOB_INVALID); }
+        if (value != job_size) { return(STATUS_JOB_INVALID); }
+      }
+      if (job_state != JOB_STATE_UPLOAD) { job_write_header(0); } // Already invalidated while uploading.
+      job_state = JOB_STATE_UPLOAD;
+      break;
+    case 'E' : // End the upload
+      if (job_state != JOB_STATE_UPLOAD) { return(STATUS_JOB_INVALID); }
+      if (line[3] != 0) {
+        if (line[3] != '=') { return(STATUS_INVALID_STATEMENT); }
+        if (!job_read_number(&line[4], 16, &value)) { return(STATUS_BAD_NUMBER_FORMAT); }
+      } else {
+        value = job_crc;
+      }
+      if (job_size % EEPROM_PAGE_SIZE) {
+        memset(&job_buffer[0][job_size % EEPROM_PAGE_SIZE], 0xFF, EEPROM_PAGE_SIZE-(job_size % EEPROM_PAGE_SIZE));
+        Eeprom_Write_Page_DMA(JOB_DATA_PAGE+job_size/EEPROM_PAGE_SIZE, job_buffer[0]);
+      }
+      job_state = JOB_STATE_EMPTY;
+      if (value != job_crc) { return(STATUS_JOB_INVALID); }
+      job_write_header(JOB_MAGIC);
+      job_state = JOB_STATE_READY;
+      report_job_info(job_state, job_size, job_crc);
+      break;
+    case 'R' : // Run the stored program [IDLE/CHECK]
+      if (line[3] != 0) { return(STATUS_INVALID_STATEMENT); }
+      if ((sys.state != STATE_IDLE) && (sys.state != STATE_CHECK_MODE)) { return(STATUS_IDLE_ERROR); }
+      if (job_state != JOB_STATE_READY) { return(STATUS_JOB_INVALID); }
+      if (!job_verify()) {
+        job_state = JOB_STATE_EMPTY;
+        return(STATUS_JOB_INVALID);
+      }
+      job_offset = 0;
+      job_buffer_select = 1;
+      job_buffer_pos = 0;
+      job_buffer_len = 0;
+      if (job_size > 0) { Eeprom_Read_DMA(job_data_address(0), job_buffer[0], job_page_length(0)); }
+      job_state = JOB_STATE_RUN;
+      break;
+    default :
+      return(STATUS_INVALID_STATEMENT);
+  }
+  return(STATUS_OK);
+}
+
+
+uint8_t job_store_line(char *line)
+{
+  uint16_t length = strlen(line);
+  uint16_t idx;
+  if (job_size+length+1 > JOB_MAX_SIZE) { return(STATUS_JOB_FULL); }
+  line[length++] = '\n';
+  job_crc = kv_crc32_update(job_crc, (uint8_t *)line, length);
+  for (idx=0; idx<length; idx++) {
+    job_buffer[0][job_size % EEPROM_PAGE_SIZE] = line[idx];
+    if ((++job_size % EEPROM_PAGE_SIZE) == 0) {
+      // Only waits while the previous page is still programming.
+      Eeprom_Write_Page_DMA(JOB_DATA_PAGE+job_size/EEPROM_PAGE_SIZE-1, job_buffer[0]);
+    }
+  }
+  return(STATUS_OK);
+}
+
+
+uint8_t job_read()
+{
+  if (job_buffer_pos == job_buffer_len) {
+    if (job_offset >= job_size) {
+      job_state = JOB_STATE_READY;
+      report_feedback_message(MESSAGE_JOB_END);
+      return(SERIAL_NO_DATA);
+    }
+    if (Eeprom_Busy()) { return(SERIAL_NO_DATA); } // Page read ahead not complete yet.
+    // Switch to the page read ahead and start reading the next one into the buffer just consumed.
+    job_buffer_select ^= 1;
+    job_buffer_pos = 0;
+    job_buffer_len = job_page_length(job_offset);
+    if (job_offset+job_buffer_len < job_size) {
+      Eeprom_Read_DMA(job_data_address(job_offset+job_buffer_len), job_buffer[job_buffer_select^1],
+                      job_page_length(job_offset+job_buffer_len));
+    }
+  }
+  job_offset++;
+  return(job_buffer[job_buffer_select][job_buffer_pos++]);
+}
+
+
+void job_stop()
+{
+  if (job_state == JOB_STATE_RUN) { job_state = JOB_STATE_READY; }
+}
+
+
+uint8_t job_is_uploading()
+{
+  return(job_state == JOB_STATE_UPLOAD);
+}
+
+
+uint8_t job_is_running()
+{
+  return(job_state == JOB_STATE_RUN);
+}
+
+#endif
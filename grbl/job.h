@@ -0,0 +1,53 @@
+/*
+  job.h - g-code program storage in the AT45 flash and standalone execution
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef job_h
+#define job_h
+
+// Stored job states, as reported by '$F'.
+#define JOB_STATE_EMPTY   0 // No valid program stored
+#define JOB_STATE_UPLOAD  1 // Lines received are stored instead of executed
+#define JOB_STATE_READY   2 // Valid program stored
+#define JOB_STATE_RUN     3 // Lines are read from the stored program instead of the serial stream
+
+// Reads the stored job header. Called once at power-up.
+void job_init();
+
+// Stops a running job upon a reset. An upload is interrupted and may be resumed with '$FU='.
+void job_reset();
+
+// Executes a '$F' job command line.
+uint8_t job_execute_line(char *line);
+
+// Appends a line to the program being uploaded. The line is no longer zero-terminated on return.
+uint8_t job_store_line(char *line);
+
+// Returns the next character of the running program, or SERIAL_NO_DATA while the next page is read
+// ahead. The job goes back to the ready state once all its characters have been read.
+uint8_t job_read();
+
+// Stops the running job after an error. The program stays stored.
+void job_stop();
+
+// Returns true while lines are stored by an upload.
+uint8_t job_is_uploading();
+
+// Returns true while lines are read from the stored program.
+uint8_t job_is_running();
+
+#endif
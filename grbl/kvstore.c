@@ -0,0 +1,174 @@
+/*
+  kvstore.c - log-structured persistent key/value store on the AT45 flash
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+// The store is a ring of flash pages, FLASH_STORE_FIRST_PAGE to FLASH_STORE_LAST_PAGE. Every update
+// appends a record with the next sequence number to the head page, so each page is programmed once
+// per lap of the ring no matter which key changes. This also rewrites every page of an AT45 sector
+// well within the 10000 cumulative programs the datasheet allows between rewrites of a page.
+//
+// Garbage collection is done on the fly. Before the head moves onto a page, the live record it holds
+// is appended again (see kv_relocation_key()), so the head page only ever holds a stale record. A
+// power loss during a page program leaves a record failing its CRC, and the previous version of its
+// key stays valid.
+#define KV_MAGIC  0x3153564BUL // "KVS1"
+#define KV_PAGES  (FLASH_STORE_LAST_PAGE-FLASH_STORE_FIRST_PAGE+1)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t crc;   // CRC32 of the rest of the header and the data
+  uint32_t seq;   // Sequence number. The newest record of a key is its current value.
+  uint16_t key;
+  uint16_t size;  // Number of data bytes following the header
+} kv_header_t;
+
+static uint16_t kv_page_key[KV_PAGES];  // Key of the valid record on each page, KV_NO_KEY if none.
+static uint32_t kv_page_seq[KV_PAGES];  // Sequence number of each record. Only used by kv_mount().
+static uint16_t kv_live[KV_MAX_KEYS];   // Page of the newest valid record of each key, KV_NO_KEY if none.
+static uint16_t kv_head;                // Next page to program. Never holds a live record.
+static uint32_t kv_seq;                 // Sequence number of the next record
+static uint8_t kv_page[EEPROM_PAGE_SIZE];
+
+
+static uint16_t kv_next_page(uint16_t page)
+{
+  if (++page == KV_PAGES) { return(0); }
+  return(page);
+}
+
+
+// Reads a whole record page into kv_page and checks it. Returns false if it is not a valid record.
+static uint8_t kv_load_page(uint16_t page)
+{
+  kv_header_t *header = (kv_header_t *)kv_page;
+  Eeprom_Read_DMA((uint32_t)(FLASH_STORE_FIRST_PAGE+page) << 8, kv_page, EEPROM_PAGE_SIZE);
+  Eeprom_Wait();
+  if ((header->magic != KV_MAGIC) || (header->size > KV_MAX_DATA_SIZE)) { return(false); }
+  return(header->crc == kv_crc32(&kv_page[8], KV_HEADER_SIZE-8+header->size));
+}
+
+
+void kv_mount(uint16_t n_keys)
+{
+  kv_header_t header;
+  uint16_t page, key, best;
+  uint16_t newest = KV_NO_KEY;
+
+  // Only the headers are read to build the index. The record data is checked for the newest
+  // version of each key only, which is usually the only one read.
+  for (page=0; page<KV_PAGES; page++) {
+    kv_page_key[page] = KV_NO_KEY;
+    Eeprom_Read_DMA((uint32_t)(FLASH_STORE_FIRST_PAGE+page) << 8, (uint8_t *)&header, sizeof(header));
+    Eeprom_Wait();
+    if (header.magic != KV_MAGIC) { continue; }
+    // Includes invalid records, so the head never moves back over a page written before a power loss.
+    if ((newest == KV_NO_KEY) || ((int32_t)(header.seq-kv_page_seq[newest]) > 0)) { newest = page; }
+    kv_page_seq[page] = header.seq;
+    if ((header.key < n_keys) && (header.key < KV_MAX_KEYS)) { kv_page_key[page] = header.key; }
+  }
+
+  for (key=0; key<KV_MAX_KEYS; key++) {
+    kv_live[key] = KV_NO_KEY;
+    for (;;) {
+      best = KV_NO_KEY;
+      for (page=0; page<KV_PAGES; page++) {
+        if (kv_page_key[page] != key) { continue; }
+        if ((best == KV_NO_KEY) || ((int32_t)(kv_page_seq[page]-kv_page_seq[best]) > 0)) { best = page; }
+      }
+      if (best == KV_NO_KEY) { break; }
+      if (kv_load_page(best)) { kv_live[key] = best; break; }
+      kv_page_key[best] = KV_NO_KEY; // Torn or corrupted. Fall back to the previous version.
+    }
+  }
+
+  if (newest == KV_NO_KEY) {
+    kv_head = 0;
+    kv_seq = 1;
+  } else {
+    kv_head = kv_next_page(newest);
+    kv_seq = kv_page_seq[newest]+1;
+  }
+  // Only after FLASH_STORE_FIRST_PAGE or FLASH_STORE_LAST_PAGE changed. Never erase a live record.
+  for (page=0; page<KV_PAGES; page++) {
+    key = kv_page_key[kv_head];
+    if ((key == KV_NO_KEY) || (kv_live[key] != kv_head)) { break; }
+    kv_head = kv_next_page(kv_head);
+  }
+}
+
+
+uint8_t kv_read(uint16_t key, uint8_t *data, uint16_t size)
+{
+  kv_header_t *header = (kv_header_t *)kv_page;
+  if ((key >= KV_MAX_KEYS) || (kv_live[key] == KV_NO_KEY)) { return(false); }
+  if (!kv_load_page(kv_live[key])) { return(false); }
+  memset(data, 0, size);
+  if (size > header->size) { size = header->size; }
+  memcpy(data, &kv_page[KV_HEADER_SIZE], size);
+  return(true);
+}
+
+
+uint16_t kv_relocation_key()
+{
+  uint16_t page = kv_next_page(kv_head);
+  uint16_t key = kv_page_key[page];
+  if ((key != KV_NO_KEY) && (kv_live[key] == page)) { return(key); }
+  return(KV_NO_KEY);
+}
+
+
+void kv_append(uint16_t key, const uint8_t *data, uint16_t size)
+{
+  kv_header_t *header = (kv_header_t *)kv_page;
+  if ((key >= KV_MAX_KEYS) || (size > KV_MAX_DATA_SIZE)) { return; }
+
+  memset(kv_page, 0xFF, EEPROM_PAGE_SIZE);
+  header->magic = KV_MAGIC;
+  header->seq = kv_seq++;
+  header->key = key;
+  header->size = size;
+  memcpy(&kv_page[KV_HEADER_SIZE], data, size);
+  header->crc = kv_crc32(&kv_page[8], KV_HEADER_SIZE-8+size);
+  Eeprom_Write_Page_DMA(FLASH_STORE_FIRST_PAGE+kv_head, kv_page); // Copies kv_page before returning.
+
+  kv_page_key[kv_head] = key;
+  kv_live[key] = kv_head;
+  kv_head = kv_next_page(kv_head);
+}
+
+
+uint32_t kv_crc32(const uint8_t *data, uint32_t size)
+{
+  return(kv_crc32_update(0, data, size));
+}
+
+
+uint32_t kv_crc32_update(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+  uint8_t bit;
+  crc = ~crc;
+  while (size--) {
+    crc ^= *data++;
+    for (bit=0; bit<8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+  }
+  return(~crc);
+}
@@ -0,0 +1,53 @@
+/*
+  kvstore.h - log-structured persistent key/value store on the AT45 flash
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef kvstore_h
+#define kvstore_h
+
+#include <stdint.h>
+#include "../BSP/AT45DBXX/AT45DBXX.h"
+
+// Each record takes one flash page: a 16 byte header followed by up to KV_MAX_DATA_SIZE data bytes.
+#define KV_HEADER_SIZE     16
+#define KV_MAX_DATA_SIZE   (EEPROM_PAGE_SIZE-KV_HEADER_SIZE)
+#define KV_MAX_KEYS        64
+#define KV_NO_KEY          0xFFFF
+
+// Scans the store pages and indexes the newest valid record of each key below n_keys. Records of
+// other keys are dropped. Called once at power-up, before any other store function.
+void kv_mount(uint16_t n_keys);
+
+// Reads the newest record of a key. Missing data bytes are zeroed. Returns false if the key has no
+// valid record.
+uint8_t kv_read(uint16_t key, uint8_t *data, uint16_t size);
+
+// Returns the key whose live record sits on the page that the append after the next one reuses, or
+// KV_NO_KEY. The caller must append that key next, so no live record is ever erased.
+uint16_t kv_relocation_key();
+
+// Appends a new version of a key to the head of the log. Only starts the page program, so check
+// Eeprom_Busy() first to avoid waiting on the previous one.
+void kv_append(uint16_t key, const uint8_t *data, uint16_t size);
+
+// Returns the CRC32 (IEEE 802.3) of a block of data.
+uint32_t kv_crc32(const uint8_t *data, uint32_t size);
+
+// Continues a CRC32 over the next block of data. Starting from 0 gives the same result as kv_crc32().
+uint32_t kv_crc32_update(uint32_t crc, const uint8_t *data, uint32_t size);
+
+#endif
@@ -21,6 +21,180 @@
 
 #include "grbl.h"
 
+#ifdef MOTION_QUEUE_SIZE
+  // Parse-ahead queue of motions waiting for room in the planner buffer. Main program only.
+  #define MC_QUEUE_LINE 0
+  #define MC_QUEUE_ARC  1 // NATIVE_ARCS only
+  typedef struct {
+    uint8_t type;           // MC_QUEUE_LINE or MC_QUEUE_ARC
+    float target[N_AXIS];
+    plan_line_data_t pl_data;
+    #ifdef NATIVE_ARCS
+      float center[2];      // Arc center in the plane of axis_0 and axis_1, as for plan_buffer_arc()
+      float radius;
+      float angular_travel;
+      uint8_t axis_0;
+      uint8_t axis_1;
+    #endif
+    #ifdef MOTION_MERGE_TOLERANCE
+      float start[N_AXIS];  // Start of the motion, which stays fixed while later motions are merged
+      float deviation;      // Bound on the distance of the merged points from the line
+    #endif
+  } mc_queue_t;
+  static mc_queue_t mc_queue[MOTION_QUEUE_SIZE];
+  static uint8_t mc_queue_tail;     // Oldest queued motion. Next to enter the planner.
+  static uint8_t mc_queue_count;
+  static uint8_t mc_queue_busy;     // Guards against re-entry through a laser mode spindle sync.
+  #ifdef MOTION_MERGE_TOLERANCE
+    static float mc_position[N_AXIS]; // Target of the last motion queued or planned
+  #endif
+#endif
+
+
+// Called when the planner drops a motion that does not move. Correctly set spindle state, if there
+// is a coincident position passed. Forces a buffer sync while in M3 laser mode only.
+static void mc_plan_empty(plan_line_data_t *pl_data)
+{
+  if (bit_istrue(settings.flags,BITFLAG_LASER_MODE)) {
+    if (pl_data->condition & PL_COND_FLAG_SPINDLE_CW) {
+      spindle_sync(PL_COND_FLAG_SPINDLE_CW, pl_data->spindle_speed);
+    }
+  }
+}
+
+
+// Hands a line motion to the planner. The planner buffer must not be full.
+static void mc_plan_line(float *target, plan_line_data_t *pl_data)
+{
+  if (plan_buffer_line(target, pl_data) == PLAN_EMPTY_BLOCK) { mc_plan_empty(pl_data); }
+}
+
+
+#ifdef NATIVE_ARCS
+// Hands an arc to the planner as one block. The planner buffer must not be full.
+static void mc_plan_arc_block(float *target, plan_line_data_t *pl_data, float *center, float radius,
+  float angular_travel, uint8_t axis_0, uint8_t axis_1)
+{
+  if (plan_buffer_arc(target, pl_data, center, radius, angular_travel, axis_0, axis_1) == PLAN_EMPTY_BLOCK) {
+    mc_plan_empty(pl_data);
+  }
+}
+#endif
+
+
+#ifdef MOTION_QUEUE_SIZE
+// Moves queued motions into the planner buffer, oldest first, while it has room.
+void mc_queue_service()
+{
+  if (mc_queue_busy) { return; }
+  mc_queue_busy = true;
+  while (mc_queue_count && !plan_check_full_buffer()) {
+    if (sys.abort) { break; }
+    mc_queue_t *entry = &mc_queue[mc_queue_tail];
+    if (++mc_queue_tail == MOTION_QUEUE_SIZE) { mc_queue_tail = 0; }
+    mc_queue_count--;
+    #ifdef NATIVE_ARCS
+      if (entry->type == MC_QUEUE_ARC) {
+        mc_plan_arc_block(entry->target, &entry->pl_data, entry->center, entry->radius, entry->angular_travel,
+                          entry->axis_0, entry->axis_1);
+        continue;
+      }
+    #endif
+    mc_plan_line(entry->target, &entry->pl_data);
+  }
+  mc_queue_busy = false;
+}
+
+
+// Returns a new entry at the head of the queue, once there is room for it, with the motion copied in.
+// The caller adds the rest and counts it. Returns NULL on a system abort.
+static mc_queue_t *mc_queue_push(uint8_t type, float *target, plan_line_data_t *pl_data)
+{
+  while (mc_queue_count == MOTION_QUEUE_SIZE) {
+    protocol_execute_realtime(); // Check for any run-time commands and drain the queue
+    if (sys.abort) { return(NULL); } // Bail, if system abort.
+    protocol_auto_cycle_start(); // Auto-cycle start when buffer is full.
+  }
+  uint8_t index = mc_queue_tail+mc_queue_count;
+  if (index >= MOTION_QUEUE_SIZE) { index -= MOTION_QUEUE_SIZE; }
+  mc_queue_t *entry = &mc_queue[index];
+  entry->type = type;
+  memcpy(entry->target, target, sizeof(float)*N_AXIS);
+  memcpy(&entry->pl_data, pl_data, sizeof(plan_line_data_t));
+  #ifdef MOTION_MERGE_TOLERANCE
+    memcpy(entry->start, mc_position, sizeof(float)*N_AXIS);
+    entry->deviation = 0.0f;
+    memcpy(mc_position, target, sizeof(float)*N_AXIS);
+  #endif
+  return(entry);
+}
+
+
+#ifdef MOTION_MERGE_TOLERANCE
+// Merges a line motion into the newest queued one, which then goes straight from its start to the new
+// target. Only done for the same feed rate, spindle speed and conditions, when the point dropped lies
+// between both ends and every point merged so far stays within MOTION_MERGE_TOLERANCE of the new line.
+// The deviations are summed up, which bounds the distance of all earlier points without keeping them.
+// The merged motion takes the line number of the newest line, so the reported line number still
+// reaches the last line sent. Returns true if merged.
+static uint8_t mc_queue_merge(float *target, plan_line_data_t *pl_data)
+{
+  uint8_t index = mc_queue_tail+mc_queue_count-1;
+  if (index >= MOTION_QUEUE_SIZE) { index -= MOTION_QUEUE_SIZE; }
+  mc_queue_t *entry = &mc_queue[index];
+  if (entry->type != MC_QUEUE_LINE) { return(false); }
+
+  // Inverse time feed rates apply to each line, so those are never merged.
+  if (pl_data->condition & (PL_COND_FLAG_INVERSE_TIME | PL_COND_FLAG_SYSTEM_MOTION)) { return(false); }
+  if ((pl_data->condition != entry->pl_data.condition) || (pl_data->feed_rate != entry->pl_data.feed_rate) ||
+      (pl_data->spindle_speed != entry->pl_data.spindle_speed)) { return(false); }
+
+  float line_sqr = 0.0f, dot = 0.0f, point_sqr = 0.0f;
+  float line_delta, point_delta;
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS; idx++) {
+    line_delta = target[idx]-entry->start[idx];
+    point_delta = entry->target[idx]-entry->start[idx];
+    line_sqr += line_delta*line_delta;
+    dot += line_delta*point_delta;
+    point_sqr += point_delta*point_delta;
+  }
+  if ((dot <= 0.0f) || (dot >= line_sqr)) { return(false); } // Reversal or overshoot
+
+  // Distance of the dropped point from the new line.
+  float deviation = point_sqr-dot*dot/line_sqr;
+  if (deviation > 0.0f) { deviation = entry->deviation+sqrtf(deviation); }
+  else { deviation = entry->deviation; }
+  if (deviation > MOTION_MERGE_TOLERANCE) { return(false); }
+
+  entry->deviation = deviation;
+  memcpy(entry->target, target, sizeof(float)*N_AXIS);
+  #ifdef USE_LINE_NUMBERS
+    entry->pl_data.line_number = pl_data->line_number;
+  #endif
+  return(true);
+}
+#endif
+
+
+// Discards all queued motions. Called with the planner reset.
+void mc_queue_clear()
+{
+  mc_queue_tail = 0;
+  mc_queue_count = 0;
+}
+
+
+// Returns the number of motions waiting for the planner.
+// NOTE: A laser mode spindle sync while planning a queued motion must only wait on the motions ahead
+// of it, so the rest of the queue is not counted while the queue is being serviced.
+uint8_t mc_get_queue_count()
+{
+  if (mc_queue_busy) { return(0); }
+  return(mc_queue_count);
+}
+#endif
+
 
 // Execute linear motion in absolute millimeter coordinates. Feed rate given in millimeters/second
 // unless invert_feed_rate is true. Then the feed_rate means that the motion should be completed in
@@ -55,6 +229,27 @@ void mc_line(float *target, plan_line_data_t *pl_data)
   // doesn't update the machine position values. Since the position values used by the g-code
   // parser and planner are separate from the system machine positions, this is doable.
 
+  #ifdef MOTION_QUEUE_SIZE
+    // Queue behind the planner when it is full, or when earlier motions are still waiting, so the
+    // motions stay in program order. The parser is free to go on with the next line right away.
+    // Waiting motions first take up any room the planner made since, so the queue only holds motions
+    // that do not fit.
+    mc_queue_service();
+    if (mc_queue_count || plan_check_full_buffer()) {
+      #ifdef MOTION_MERGE_TOLERANCE
+        // Micro-segments waiting here are joined before they take up planner blocks.
+        if (mc_queue_count && mc_queue_merge(target, pl_data)) {
+          memcpy(mc_position, target, sizeof(float)*N_AXIS);
+          return;
+        }
+      #endif
+      if (mc_queue_push(MC_QUEUE_LINE, target, pl_data) == NULL) { return; }
+      mc_queue_count++;
+      protocol_auto_cycle_start(); // Planner buffer is full. Ensure it is executing.
+      return;
+    }
+  #endif
+
   // If the buffer is full: good! That means we are well ahead of the robot.
   // Remain in this loop until there is room in the buffer.
   do {
@@ -65,16 +260,68 @@ void mc_line(float *target, plan_line_data_t *pl_data)
   } while (1);
 
   // Plan and queue motion into planner buffer
-  if (plan_buffer_line(target, pl_data) == PLAN_EMPTY_BLOCK) {
-    if (bit_istrue(settings.flags,BITFLAG_LASER_MODE)) {
-      // Correctly set spindle state, if there is a coincident position passed. Forces a buffer
-      // sync while in M3 laser mode only.
-      if (pl_data->condition & PL_COND_FLAG_SPINDLE_CW) {
-        spindle_sync(PL_COND_FLAG_SPINDLE_CW, pl_data->spindle_speed);
-      }
+  mc_plan_line(target, pl_data);
+  #ifdef MOTION_MERGE_TOLERANCE
+    memcpy(mc_position, target, sizeof(float)*N_AXIS);
+  #endif
+}
+
+
+#ifdef NATIVE_ARCS
+// Plans an arc as a single planner block, as mc_line() does for a line motion. The soft limits are
+// checked at the end point and at each extreme of the circle that the arc passes through.
+static void mc_plan_arc(float *target, plan_line_data_t *pl_data, float *center, float radius,
+  float start_angle, float angular_travel, uint8_t axis_0, uint8_t axis_1)
+{
+  if (bit_istrue(settings.flags,BITFLAG_SOFT_LIMIT_ENABLE) && (sys.state != STATE_JOG)) {
+    float point[N_AXIS];
+    memcpy(point, target, sizeof(point));
+    limits_soft_check(point);
+    float angle_min = start_angle, angle_max = start_angle+angular_travel;
+    if (angular_travel < 0.0f) { angle_min = angle_max; angle_max = start_angle; }
+    float angle = ceilf(angle_min/(0.5f*M_PI))*(0.5f*M_PI);
+    for (; angle <= angle_max; angle += 0.5f*M_PI) {
+      if (sys.abort) { return; }
+      point[axis_0] = center[0]+radius*cosf(angle);
+      point[axis_1] = center[1]+radius*sinf(angle);
+      limits_soft_check(point);
     }
   }
+
+  // If in check gcode mode, prevent motion by blocking planner. Soft limits still work.
+  if (sys.state == STATE_CHECK_MODE) { return; }
+
+  #ifdef MOTION_QUEUE_SIZE
+    // Queued behind the planner like a line motion, see mc_line().
+    mc_queue_service();
+    if (mc_queue_count || plan_check_full_buffer()) {
+      mc_queue_t *entry = mc_queue_push(MC_QUEUE_ARC, target, pl_data);
+      if (entry == NULL) { return; }
+      memcpy(entry->center, center, sizeof(entry->center));
+      entry->radius = radius;
+      entry->angular_travel = angular_travel;
+      entry->axis_0 = axis_0;
+      entry->axis_1 = axis_1;
+      mc_queue_count++;
+      protocol_auto_cycle_start(); // Planner buffer is full. Ensure it is executing.
+      return;
+    }
+  #endif
+
+  // Wait for room in the planner buffer.
+  do {
+    protocol_execute_realtime(); // Check for any run-time commands
+    if (sys.abort) { return; } // Bail, if system abort.
+    if (plan_check_full_buffer()) { protocol_auto_cycle_start(); }
+    else { break; }
+  } while (1);
+
+  mc_plan_arc_block(target, pl_data, center, radius, angular_travel, axis_0, axis_1);
+  #ifdef MOTION_MERGE_TOLERANCE
+    memcpy(mc_position, target, sizeof(float)*N_AXIS);
+  #endif
 }
+#endif
 
 
 // Execute an arc in offset mode format. position == current xyz, target == target xyz,
@@ -84,6 +331,7 @@ void mc_line(float *target, plan_line_data_t *pl_data)
 // The arc is approximated by generating a huge number of tiny, linear segments. The chordal tolerance
 // of each segment is configured in settings.arc_tolerance, which is defined to be the maximum normal
 // distance from segment to the circle when the end points both lie on the circle.
+// NOTE: With NATIVE_ARCS, the arc is planned as one block instead and traced by the stepper module.
 void mc_arc(float *target, plan_line_data_t *pl_data, float *position, float *offset, float radius,
   uint8_t axis_0, uint8_t axis_1, uint8_t axis_linear, uint8_t is_clockwise_arc)
 {
@@ -110,6 +358,11 @@ void mc_arc(float *target, plan_line_data_t *pl_data, float *position, float *of
                           sqrtf(settings.arc_tolerance*(2*radius - settings.arc_tolerance)) );
 
   if (segments) {
+    #ifdef NATIVE_ARCS
+      float center[2] = { center_axis0, center_axis1 };
+      mc_plan_arc(target, pl_data, center, radius, atan2f(r_axis1, r_axis0), angular_travel, axis_0, axis_1);
+      return;
+    #else
     // Multiply inverse feed_rate to compensate for the fact that this movement is approximated
     // by a number of discrete segments. The inverse feed_rate should be correct for the sum of
     // all segments.
@@ -185,6 +438,7 @@ void mc_arc(float *target, plan_line_data_t *pl_data, float *position, float *of
       // Bail mid-circle on system abort. Runtime command check already performed by mc_line.
       if (sys.abort) { return; }
     }
+    #endif
   }
   // Ensure last segment arrives at target location.
   mc_line(target, pl_data);
@@ -38,6 +38,17 @@
 // (1 minute)/feed_rate time.
 void mc_line(float *target, plan_line_data_t *pl_data);
 
+#ifdef MOTION_QUEUE_SIZE
+  // Moves parse-ahead queued motions into the planner buffer while it has room.
+  void mc_queue_service();
+
+  // Discards all parse-ahead queued motions. Must be called with every planner reset.
+  void mc_queue_clear();
+
+  // Returns the number of motions waiting for room in the planner buffer.
+  uint8_t mc_get_queue_count();
+#endif
+
 // Execute an arc in offset mode format. position == current xyz, target == target xyz,
 // offset == offset from current xyz, axis_XXX defines circle plane in tool space, axis_linear is
 // the direction of helical travel, radius == circle radius, is_clockwise_arc boolean. Used
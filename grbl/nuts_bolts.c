@@ -24,6 +24,17 @@
 
 #define MAX_INT_DIGITS 8 // Maximum number of digits in int32 (and float)
 
+// Powers of ten for the decimal scaling. All are exactly representable as floats, so a single
+// division rounds only once while the digits fit in the 24-bit float mantissa, i.e. up to 7
+// significant digits. With 8 digits above 2^24, converting the digits rounds first and the
+// result may be one float step off.
+static const float pow10_table[MAX_INT_DIGITS+1] = {
+  1.0f, 10.0f, 100.0f, 1000.0f, 10000.0f, 100000.0f, 1000000.0f, 10000000.0f, 100000000.0f
+};
+static const uint32_t pow10_int_table[MAX_INT_DIGITS+1] = {
+  1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL, 100000000UL
+};
+
 // Extracts a floating point value from a string. The following code is based loosely on
 // the avr-libc strtod() function by Michael Stumpf and Dmitry Xmelkov and many freely
 // available conversion method examples, but has been highly optimized for Grbl. For known
@@ -31,7 +42,7 @@
 // Scientific notation is officially not supported by g-code, and the 'E' character may
 // be a g-code word on some CNC systems. So, 'E' notation will not be recognized.
 // NOTE: Thanks to Radu-Eosif Mihailescu for identifying the issues with using strtod().
-uint8_t read_float(char *line, uint32_t *char_counter, float *float_ptr)
+uint8_t read_number(char *line, uint32_t *char_counter, float *float_ptr, int32_t *int_ptr, uint16_t *mantissa_ptr)
 {
   char *ptr = line + *char_counter;
   unsigned char c;
@@ -74,32 +85,36 @@ uint8_t read_float(char *line, uint32_t *char_counter, float *float_ptr)
   // Return if no digits have been read.
   if (!ndigit) { return(false); };
 
-  // Convert integer into floating point.
+  // Split the integer part and the hundredths straight from the digits, and scale with one power
+  // of ten. The exponent is within -MAX_INT_DIGITS..0, unless integer digits overflowed.
   float fval;
-  fval = (float)intval;
-
-  // Apply decimal. Should perform no more than two floating point multiplications for the
-  // expected range of E0 to E-4.
-  if (fval != 0) {
-    while (exp <= -2) {
-      fval *= 0.01;
-      exp += 2;
-    }
-    if (exp < 0) {
-      fval *= 0.1;
-    } else if (exp > 0) {
-      do {
-        fval *= 10.0;
-      } while (--exp > 0);
+  uint32_t intpart;
+  uint32_t fraction = 0;
+  if (exp < 0) {
+    intpart = intval/pow10_int_table[-exp];
+    fraction = intval - intpart*pow10_int_table[-exp];
+    fval = (float)intval/pow10_table[-exp];
+    // Hundredths, rounded half up. A fraction of .995 and more rounds up to 100.
+    if (exp >= -2) { fraction *= pow10_int_table[2+exp]; }
+    else { fraction = (fraction + (pow10_int_table[-exp-2] >> 1))/pow10_int_table[-exp-2]; }
+  } else {
+    fval = (float)intval;
+    while (exp > 0) { // Only with more than MAX_INT_DIGITS integer digits.
+      fval *= 10.0f;
+      exp--;
     }
+    intpart = (fval < 2147483647.0f) ? (uint32_t)fval : 2147483647UL;
   }
 
-  // Assign floating point value with correct sign.
+  // Assign values with correct sign. The mantissa is the magnitude of the hundredths.
   if (isnegative) {
     *float_ptr = -fval;
+    *int_ptr = -(int32_t)intpart;
   } else {
     *float_ptr = fval;
+    *int_ptr = intpart;
   }
+  *mantissa_ptr = fraction;
 
   *char_counter = ptr - line - 1; // Set char_counter to next statement
 
@@ -107,6 +122,14 @@ uint8_t read_float(char *line, uint32_t *char_counter, float *float_ptr)
 }
 
 
+uint8_t read_float(char *line, uint32_t *char_counter, float *float_ptr)
+{
+  int32_t int_value;
+  uint16_t mantissa;
+  return(read_number(line, char_counter, float_ptr, &int_value, &mantissa));
+}
+
+
 // Non-blocking delay function used for general operation and suspend features.
 void delay_sec(float seconds, uint8_t mode)
 {
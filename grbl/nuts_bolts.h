@@ -30,8 +30,8 @@
 
 #define SOME_LARGE_VALUE 1.0E+38
 
-// Axis array index values. Must start with 0 and be continuous.
-#define N_AXIS 8 // Number of axes
+// Axis array index values. Must start with 0 and be continuous. Only the first N_AXIS are built
+// in. See config.h.
 
 #define X_AXIS 0 // Axis indexing value.
 #define Y_AXIS 1
@@ -85,6 +85,10 @@
 // a pointer to the result variable. Returns true when it succeeds
 uint8_t read_float(char *line, uint32_t *char_counter, float *float_ptr);
 
+// Same as read_float(), but also returns the truncated integer part and the hundredths of the
+// fraction (rounded, without sign) straight from the decimal digits, as used for Gxx.x commands.
+uint8_t read_number(char *line, uint32_t *char_counter, float *float_ptr, int32_t *int_ptr, uint16_t *mantissa_ptr);
+
 // Non-blocking delay function used for general operation and suspend features.
 void delay_sec(float seconds, uint8_t mode);
 
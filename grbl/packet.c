@@ -0,0 +1,239 @@
+/*
+  packet.c - binary motion packet protocol alongside text g-code
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef BINARY_PROTOCOL
+
+// Packets carry motions already in machine coordinates and native floats, so they go straight to
+// mc_line() and mc_arc() without the text parser. The parser position, spindle and coolant states
+// are kept up to date, so text g-code can follow at any time.
+//
+// Responses, sent as text lines:
+//   [PKT:ACK,<seq>]           All packets up to <seq> were executed or queued.
+//   [PKT:ERR,<seq>,<status>]  Packet <seq> failed with a status code. Packets up to <seq> are consumed
+//                             and not resent.
+//   [PKT:NAK,<seq>]           A frame was corrupted or out of sequence. Frames are dropped until the
+//                             host resends from packet <seq>.
+// The sequence starts at 0 after a reset, and wraps around after 255. A frame cut short by the host
+// is abandoned after PACKET_TIMEOUT ms without data. The host then resyncs with a reset.
+#define PACKET_BUFFER_SIZE  (255+3) // Length byte, up to 255 sequence, type and payload bytes, CRC16
+
+static uint8_t packet_buffer[PACKET_BUFFER_SIZE];
+static uint16_t packet_count;      // Bytes received after the start byte
+static uint8_t packet_receiving;
+static uint8_t packet_nak;         // Frames dropped until the expected sequence is resent
+static uint8_t packet_seq;         // Next expected sequence
+static uint8_t packet_ack_count;   // Packets executed since the last acknowledgement
+
+
+// CRC-16/CCITT-FALSE, four bits at a time. The bitwise loop took longer than parsing the payload.
+static const uint16_t packet_crc16_table[16] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+static uint16_t packet_crc16(const uint8_t *data, uint16_t size)
+{
+  uint16_t crc = 0xFFFF;
+  while (size--) {
+    crc = (crc << 4) ^ packet_crc16_table[(crc >> 12) ^ (*data >> 4)];
+    crc = (crc << 4) ^ packet_crc16_table[(crc >> 12) ^ (*data++ & 0x0F)];
+  }
+  return(crc);
+}
+
+
+static float packet_get_float(const uint8_t *data)
+{
+  float value;
+  memcpy(&value, data, sizeof(float));
+  return(value);
+}
+
+
+// Same planner data as the parser sets up for a block, using the current spindle and coolant states.
+static void packet_plan_data(plan_line_data_t *pl_data, uint8_t seq, float feed_rate, uint8_t rapid)
+{
+  memset(pl_data, 0, sizeof(plan_line_data_t));
+  pl_data->feed_rate = feed_rate;
+  pl_data->spindle_speed = gc_state.spindle_speed;
+  pl_data->condition = (gc_state.modal.spindle | gc_state.modal.coolant);
+  if (rapid) {
+    pl_data->condition |= PL_COND_FLAG_RAPID_MOTION;
+    // Laser mode disables the laser during rapids, like G0.
+    if (bit_istrue(settings.flags, BITFLAG_LASER_MODE)) { pl_data->spindle_speed = 0.0f; }
+  }
+  #ifdef USE_LINE_NUMBERS
+    pl_data->line_number = seq;
+  #endif
+}
+
+
+static uint8_t packet_execute_payload(uint8_t seq, uint8_t type, const uint8_t *data, uint8_t size)
+{
+  plan_line_data_t plan_data;
+  float target[N_AXIS];
+  float offset[N_AXIS];
+  float feed_rate, radius, delta_r, value;
+  uint8_t idx, state, axis_0, axis_1, axis_linear;
+
+  switch (type) {
+    case PACKET_LINE:
+      if (size != 5+4*N_AXIS) { return(STATUS_INVALID_STATEMENT); }
+      if (sys.state & (STATE_ALARM | STATE_JOG)) { return(STATUS_SYSTEM_GC_LOCK); }
+      feed_rate = packet_get_float(&data[1]);
+      if (!isfinite(feed_rate)) { return(STATUS_BAD_NUMBER_FORMAT); }
+      if (!(data[0] & PACKET_FLAG_RAPID) && !(feed_rate > 0.0f)) { return(STATUS_GCODE_UNDEFINED_FEED_RATE); }
+      for (idx=0; idx<N_AXIS; idx++) {
+        target[idx] = packet_get_float(&data[5+4*idx]);
+        if (!isfinite(target[idx])) { return(STATUS_BAD_NUMBER_FORMAT); }
+      }
+      packet_plan_data(&plan_data, seq, feed_rate, data[0] & PACKET_FLAG_RAPID);
+      mc_line(target, &plan_data);
+      memcpy(gc_state.position, target, sizeof(target));
+      break;
+    case PACKET_ARC:
+      if (size != 14+4*N_AXIS) { return(STATUS_INVALID_STATEMENT); }
+      if (sys.state & (STATE_ALARM | STATE_JOG)) { return(STATUS_SYSTEM_GC_LOCK); }
+      switch (data[1]) {
+        case PACKET_PLANE_XY: axis_0 = X_AXIS; axis_1 = Y_AXIS; axis_linear = Z_AXIS; break;
+        case PACKET_PLANE_ZX: axis_0 = Z_AXIS; axis_1 = X_AXIS; axis_linear = Y_AXIS; break;
+        case PACKET_PLANE_YZ: axis_0 = Y_AXIS; axis_1 = Z_AXIS; axis_linear = X_AXIS; break;
+        default: return(STATUS_INVALID_STATEMENT);
+      }
+      feed_rate = packet_get_float(&data[2]);
+      if (!isfinite(feed_rate)) { return(STATUS_BAD_NUMBER_FORMAT); }
+      if (!(feed_rate > 0.0f)) { return(STATUS_GCODE_UNDEFINED_FEED_RATE); }
+      for (idx=0; idx<N_AXIS; idx++) {
+        target[idx] = packet_get_float(&data[6+4*idx]);
+        if (!isfinite(target[idx])) { return(STATUS_BAD_NUMBER_FORMAT); }
+      }
+      memset(offset, 0, sizeof(offset));
+      offset[axis_0] = packet_get_float(&data[6+4*N_AXIS]);
+      offset[axis_1] = packet_get_float(&data[10+4*N_AXIS]);
+      if (!isfinite(offset[axis_0]) || !isfinite(offset[axis_1])) { return(STATUS_BAD_NUMBER_FORMAT); }
+      // Same arc definition checks as the parser, on the radii from the center to both ends.
+      radius = hypot_f(offset[axis_0], offset[axis_1]);
+      if (!(radius > 0.0f)) { return(STATUS_GCODE_NO_OFFSETS_IN_PLANE); }
+      delta_r = fabsf(hypot_f(target[axis_0]-gc_state.position[axis_0]-offset[axis_0],
+                              target[axis_1]-gc_state.position[axis_1]-offset[axis_1])-radius);
+      if (!(delta_r <= 0.005f)) {
+        if (!(delta_r <= 0.5f)) { return(STATUS_GCODE_INVALID_TARGET); } // > 0.5mm, or not a number
+        if (delta_r > (0.001f*radius)) { return(STATUS_GCODE_INVALID_TARGET); } // > 0.005mm AND 0.1% radius
+      }
+      packet_plan_data(&plan_data, seq, feed_rate, false);
+      mc_arc(target, &plan_data, gc_state.position, offset, radius,
+             axis_0, axis_1, axis_linear, data[0] & PACKET_FLAG_CLOCKWISE);
+      memcpy(gc_state.position, target, sizeof(target));
+      break;
+    case PACKET_SPINDLE:
+      if (size != 5) { return(STATUS_INVALID_STATEMENT); }
+      switch (data[0]) {
+        case 0: state = SPINDLE_DISABLE; break;
+        case 1: state = SPINDLE_ENABLE_CW; break;
+        case 2: state = SPINDLE_ENABLE_CCW; break;
+        default: return(STATUS_INVALID_STATEMENT);
+      }
+      value = packet_get_float(&data[1]);
+      if (!isfinite(value)) { return(STATUS_BAD_NUMBER_FORMAT); }
+      if (value < 0.0f) { return(STATUS_NEGATIVE_VALUE); }
+      gc_state.spindle_speed = value;
+      spindle_sync(state, gc_state.spindle_speed);
+      gc_state.modal.spindle = state;
+      break;
+    case PACKET_OUTPUT:
+      if (size != 3) { return(STATUS_INVALID_STATEMENT); }
+      if (data[1] >= OUTPUT_MAX) { return(STATUS_INVALID_STATEMENT); }
+      if (sys.state == STATE_CHECK_MODE) { break; }
+      if (!(data[0] & PACKET_FLAG_IMMEDIATE)) { protocol_buffer_synchronize(); }
+      plc_output_set_state(data[1], data[2]);
+      break;
+    case PACKET_DWELL:
+      if (size != 4) { return(STATUS_INVALID_STATEMENT); }
+      value = packet_get_float(data);
+      if (!isfinite(value)) { return(STATUS_BAD_NUMBER_FORMAT); }
+      if (value < 0.0f) { return(STATUS_NEGATIVE_VALUE); }
+      mc_dwell(value);
+      break;
+    default:
+      return(STATUS_INVALID_STATEMENT);
+  }
+  return(STATUS_OK);
+}
+
+
+void packet_reset()
+{
+  packet_receiving = false;
+  packet_nak = false;
+  packet_seq = 0;
+  packet_ack_count = 0;
+  serial_reset_packet();
+}
+
+
+uint8_t packet_read(uint8_t c)
+{
+  if (!packet_receiving) {
+    packet_receiving = true;
+    packet_count = 0;
+    return(false);
+  }
+  packet_buffer[packet_count++] = c;
+  if (packet_count < packet_buffer[0]+3) { return(false); }
+  packet_receiving = false;
+  return(true);
+}
+
+
+uint8_t packet_is_receiving()
+{
+  return(packet_receiving);
+}
+
+
+void packet_execute()
+{
+  uint8_t length = packet_buffer[0];
+  uint8_t seq = packet_buffer[1];
+  uint8_t status_code;
+  uint16_t crc = packet_buffer[length+1] | ((uint16_t)packet_buffer[length+2] << 8);
+
+  if ((length < 2) || (crc != packet_crc16(packet_buffer, length+1)) || (seq != packet_seq)) {
+    // Report once, then drop the frames the host has already sent after it.
+    if (!packet_nak) { report_packet_nak(packet_seq); }
+    packet_nak = true;
+    packet_ack_count = 0;
+    return;
+  }
+  packet_nak = false;
+  packet_seq = seq+1;
+
+  status_code = packet_execute_payload(seq, packet_buffer[2], &packet_buffer[3], length-2);
+  if (sys.abort) { return; }
+  if (status_code != STATUS_OK) {
+    report_packet_status(seq, status_code);
+    packet_ack_count = 0;
+  } else if ((++packet_ack_count >= PACKET_ACK_BATCH) || (serial_get_rx_buffer_count() == 0)) {
+    report_packet_status(seq, STATUS_OK);
+    packet_ack_count = 0;
+  }
+}
+
+#endif
@@ -0,0 +1,58 @@
+/*
+  packet.h - binary motion packet protocol alongside text g-code
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef packet_h
+#define packet_h
+
+// Frame: PACKET_START, length, sequence, type, payload, CRC16 (low byte first). The length counts
+// the sequence, type and payload bytes. The CRC16 (CCITT, initial value 0xFFFF) covers the length
+// through the payload. Floats and integers are little-endian, as used by the controller.
+#define PACKET_START  0x02 // STX. Never part of text g-code.
+
+// Packet types and their payloads.
+#define PACKET_LINE     0x01 // flags, float feed rate (mm/min), float target[N_AXIS] (machine mm)
+#define PACKET_ARC      0x02 // flags, plane, float feed rate, float target[N_AXIS], float center offset[2]
+#define PACKET_SPINDLE  0x03 // state (0 off, 1 cw, 2 ccw), float speed (rpm)
+#define PACKET_OUTPUT   0x04 // flags, output number, state
+#define PACKET_DWELL    0x05 // float seconds
+
+// Packet flags.
+#define PACKET_FLAG_RAPID      bit(0) // Line: rapid motion, feed rate ignored
+#define PACKET_FLAG_CLOCKWISE  bit(0) // Arc: clockwise
+#define PACKET_FLAG_IMMEDIATE  bit(0) // Output: set when received, not after the planned motions
+
+// Arc planes, with the same axes as G17, G18 and G19.
+#define PACKET_PLANE_XY  0
+#define PACKET_PLANE_ZX  1
+#define PACKET_PLANE_YZ  2
+
+// Clears the frame in progress and restarts the sequence at 0. Called upon a reset.
+void packet_reset();
+
+// Adds a received byte to the frame in progress, which starts with PACKET_START. Returns true once the
+// frame is complete and should be executed with packet_execute().
+uint8_t packet_read(uint8_t c);
+
+// Returns true while a frame is being received.
+uint8_t packet_is_receiving();
+
+// Checks and executes the complete frame. Acknowledges packets in batches of PACKET_ACK_BATCH, or
+// as soon as no more data is waiting.
+void packet_execute();
+
+#endif
@@ -15,6 +15,7 @@
 #include "plc_io.h"
 
 setup _setup;
+DMA_BUFFER uint32_t parameters_ext[5];
 
 /****************************************************************************/
 
@@ -128,7 +129,7 @@ int read_parameter( /* ARGUMENTS                                      */
   CHK(((index < 1) || (index >= RS274NGC_MAX_PARAMETERS)),
       NCE_PARAMETER_NUMBER_OUT_OF_RANGE);
   if ((index >= 1000) && (index <= 1004)) {
-	  *float_ptr = (float)_setup.parameters_ext[index-1000];
+	  *float_ptr = (float)parameters_ext[index-1000];
   }
   else *float_ptr = _setup.parameters[index];
   return RS274NGC_OK;
@@ -222,7 +223,7 @@ int read_parameter_setting(  /* ARGUMENTS                        */
   if ((index < 1) || (index >= RS274NGC_MAX_PARAMETERS)) return NCE_PARAMETER_NUMBER_OUT_OF_RANGE;
   if (line[*counter] != '=') {
 	  if ((index >= 1000) && (index <= 1002)) { // X, Y and Z position
-		  report_parameter((unsigned int)index, (float)_setup.parameters_ext[index-1000], TYPE_FLOAT);
+		  report_parameter((unsigned int)index, (float)parameters_ext[index-1000], TYPE_FLOAT);
 	   }
 	  else if (index == PARAM_PLC_BASE_INPUT) { // Inpput PROBE state read
 		  report_parameter((unsigned int)index, probe_get_state(), TYPE_UINT32);
@@ -239,6 +240,7 @@ int read_parameter_setting(  /* ARGUMENTS                        */
   	  }
   	// write to internal memory
   	_setup.parameters[index] = value;
+  	settings_write_parameter(index, value);
   }
   return RS274NGC_OK;
 }
@@ -135,12 +135,13 @@ enum {
 
 typedef struct setup_struct {
   float parameters[RS274NGC_MAX_PARAMETERS];     // system parameters
-  uint32_t parameters_ext[5];
   int parameter_occurrence;                      // parameter buffer index
   int parameter_numbers[50];                     // parameter number buffer
   float parameter_values[50];                    // parameter value buffer
 } setup;
 
+extern uint32_t parameters_ext[5];               // ADC readings, parameters 1000 to 1004. Written by DMA.
+
 #define ERM(error_code) if (1) {                    \
   return error_code;                                \
   } else
@@ -23,11 +23,12 @@
 #include "grbl.h"
 
 
-static plan_block_t block_buffer[BLOCK_BUFFER_SIZE];  // A ring buffer for motion instructions
-static uint8_t block_buffer_tail;     // Index of the block to process now
-static uint8_t block_buffer_head;     // Index of the next block to be pushed
-static uint8_t next_buffer_head;      // Index of the next buffer head
-static uint8_t block_buffer_planned;  // Index of the optimally planned block
+static DTCM_DATA plan_block_t block_buffer[BLOCK_BUFFER_SIZE];  // A ring buffer for motion instructions
+static DTCM_DATA plan_profile_t block_profile[BLOCK_BUFFER_SIZE]; // Planner profiles, indexed as the ring buffer
+static uint16_t block_buffer_tail;     // Index of the block to process now
+static uint16_t block_buffer_head;     // Index of the next block to be pushed
+static uint16_t next_buffer_head;      // Index of the next buffer head
+static uint16_t block_buffer_planned;  // Index of the optimally planned block
 
 // Define planner variables
 typedef struct {
@@ -37,11 +38,11 @@ typedef struct {
   float previous_unit_vec[N_AXIS];   // Unit vector of previous path line segment
   float previous_nominal_speed;  // Nominal speed of previous path line segment
 } planner_t;
-static planner_t pl;
+static DTCM_DATA planner_t pl;
 
 
 // Returns the index of the next block in the ring buffer. Also called by stepper segment buffer.
-uint8_t plan_next_block_index(uint8_t block_index)
+uint16_t plan_next_block_index(uint16_t block_index)
 {
   block_index++;
   if (block_index == BLOCK_BUFFER_SIZE) { block_index = 0; }
@@ -50,7 +51,7 @@ uint8_t plan_next_block_index(uint8_t block_index)
 
 
 // Returns the index of the previous block in the ring buffer
-static uint8_t plan_prev_block_index(uint8_t block_index)
+static uint16_t plan_prev_block_index(uint16_t block_index)
 {
   if (block_index == 0) { block_index = BLOCK_BUFFER_SIZE; }
   block_index--;
@@ -122,24 +123,50 @@ static uint8_t plan_prev_block_index(uint8_t block_index)
   to compute an optimal plan, so select carefully. The Arduino 328p memory is already maxed out, but future
   ARM versions should have enough memory and speed for look-ahead blocks numbering up to a hundred or more.
 
+  With a large buffer and short segments, the stretch between the planned pointer and the head can grow
+  to most of the buffer. PLANNER_RECALC_MAX_BLOCKS bounds the work done per streamed block by pushing the
+  planned pointer up to that many blocks behind the newest one before replanning. This is only done when
+  appending a block, which can only raise entry speeds, so the blocks left behind keep speeds that are
+  still safe. Since older blocks are never raised again, it also bounds the look-ahead to that many
+  blocks. Feed hold and override replans always start from the buffer tail.
+
+  An override change only alters the entry speed limits of some blocks. When limits are only lowered,
+  the replan starts its reverse pass at the last block with a new limit, rather than at the newest
+  block, using the entry speed of the block after it as exit speed. Past that block, the forward pass
+  stops as soon as it no longer lowers an entry speed, since the rest of the plan cannot change. A
+  raised limit can free the blocks after it, whose entry speeds the forward pass capped while
+  accelerating out of the slower block. The forward pass cannot raise those again, so any raised limit
+  replans from the newest block, as an append does. The time saved is small: a feed override lowers the
+  limit of every block the feed rate limits, so the last block with a new limit is usually near the
+  newest one. On the host, with 127 short blocks, a 1% step down takes about as long as a step up, which
+  replans everything (sim/test/planner_test.c).
+
 */
-static void planner_recalculate()
+static ITCM_CODE void planner_recalculate(uint16_t last_index)
 {
-  // Initialize block index to the last block in the planner buffer.
-  uint8_t block_index = plan_prev_block_index(block_buffer_head);
+  PROFILE_START(profile_start);
+  // Initialize block index to the last block to replan.
+  uint16_t block_index = last_index;
 
   // Bail. Can't do anything with one only one plan-able block.
-  if (block_index == block_buffer_planned) { return; }
+  if (block_index == block_buffer_planned) { PROFILE_END(PROFILE_PLANNER_RECALC,profile_start); return; }
 
   // Reverse Pass: Coarsely maximize all possible deceleration curves back-planning from the last
   // block in buffer. Cease planning when the last optimal planned or tail pointer is reached.
   // NOTE: Forward pass will later refine and correct the reverse pass to create an optimal plan.
   float entry_speed_sqr;
-  plan_block_t *next;
-  plan_block_t *current = &block_buffer[block_index];
+  plan_profile_t *next;
+  plan_profile_t *current = &block_profile[block_index];
 
-  // Calculate maximum entry speed for last block in buffer, where the exit speed is always zero.
-  current->entry_speed_sqr = min( current->max_entry_speed_sqr, 2*current->acceleration*current->millimeters);
+  if (plan_next_block_index(block_index) == block_buffer_head) {
+    // Calculate maximum entry speed for last block in buffer, where the exit speed is always zero.
+    current->entry_speed_sqr = min( current->max_entry_speed_sqr, 2*current->acceleration*current->millimeters);
+  } else {
+    // Last block with a new limit. Its exit speed is the unchanged entry speed of the next block.
+    next = &block_profile[plan_next_block_index(block_index)];
+    current->entry_speed_sqr = min( current->max_entry_speed_sqr,
+                                    next->entry_speed_sqr + 2*current->acceleration*current->millimeters);
+  }
 
   block_index = plan_prev_block_index(block_index);
   if (block_index == block_buffer_planned) { // Only two plannable blocks in buffer. Reverse pass complete.
@@ -148,7 +175,7 @@ static void planner_recalculate()
   } else { // Three or more plan-able blocks
     while (block_index != block_buffer_planned) {
       next = current;
-      current = &block_buffer[block_index];
+      current = &block_profile[block_index];
       block_index = plan_prev_block_index(block_index);
 
       // Check if next block is the tail block(=planned block). If so, update current stepper parameters.
@@ -168,11 +195,14 @@ static void planner_recalculate()
 
   // Forward Pass: Forward plan the acceleration curve from the planned pointer onward.
   // Also scans for optimal plan breakpoints and appropriately updates the planned pointer.
-  next = &block_buffer[block_buffer_planned]; // Begin at buffer planned pointer
+  next = &block_profile[block_buffer_planned]; // Begin at buffer planned pointer
   block_index = plan_next_block_index(block_buffer_planned);
+  uint8_t past_last = false;
+  uint8_t lowered;
   while (block_index != block_buffer_head) {
     current = next;
-    next = &block_buffer[block_index];
+    next = &block_profile[block_index];
+    lowered = false;
 
     // Any acceleration detected in the forward pass automatically moves the optimal planned
     // pointer forward, since everything before this is all optimal. In other words, nothing
@@ -183,6 +213,7 @@ static void planner_recalculate()
       if (entry_speed_sqr < next->entry_speed_sqr) {
         next->entry_speed_sqr = entry_speed_sqr; // Always <= max_entry_speed_sqr. Backward pass sets this.
         block_buffer_planned = block_index; // Set optimal plan pointer.
+        lowered = true;
       }
     }
 
@@ -191,15 +222,22 @@ static void planner_recalculate()
     // buffer and a maximum entry speed or two maximum entry speeds, every block in between
     // cannot logically be further improved. Hence, we don't have to recompute them anymore.
     if (next->entry_speed_sqr == next->max_entry_speed_sqr) { block_buffer_planned = block_index; }
+
+    // Past the replanned blocks, entry speeds only change while they keep being lowered.
+    if (past_last && !lowered) { break; }
+    if (block_index == last_index) { past_last = true; }
     block_index = plan_next_block_index( block_index );
   }
+  PROFILE_END(PROFILE_PLANNER_RECALC,profile_start);
 }
 
 
 void plan_reset()
 {
+  ST_PREP_LOCK();
   memset(&pl, 0, sizeof(planner_t)); // Clear planner struct
   plan_reset_buffer();
+  ST_PREP_UNLOCK();
 }
 
 
@@ -215,7 +253,7 @@ void plan_reset_buffer()
 void plan_discard_current_block()
 {
   if (block_buffer_head != block_buffer_tail) { // Discard non-empty buffer.
-    uint8_t block_index = plan_next_block_index( block_buffer_tail );
+    uint16_t block_index = plan_next_block_index( block_buffer_tail );
     // Push block_buffer_planned pointer, if encountered.
     if (block_buffer_tail == block_buffer_planned) { block_buffer_planned = block_index; }
     block_buffer_tail = block_index;
@@ -230,6 +268,13 @@ plan_block_t *plan_get_system_motion_block()
 }
 
 
+// Returns address of the planner profile of a block returned by the functions above.
+plan_profile_t *plan_get_block_profile(plan_block_t *block)
+{
+  return(&block_profile[block-block_buffer]);
+}
+
+
 // Returns address of first planner block, if available. Called by various main program functions.
 plan_block_t *plan_get_current_block()
 {
@@ -240,9 +285,9 @@ plan_block_t *plan_get_current_block()
 
 float plan_get_exec_block_exit_speed_sqr()
 {
-  uint8_t block_index = plan_next_block_index(block_buffer_tail);
+  uint16_t block_index = plan_next_block_index(block_buffer_tail);
   if (block_index == block_buffer_head) { return( 0.0 ); }
-  return( block_buffer[block_index].entry_speed_sqr );
+  return( block_profile[block_index].entry_speed_sqr );
 }
 
 
@@ -250,6 +295,7 @@ float plan_get_exec_block_exit_speed_sqr()
 uint8_t plan_check_full_buffer()
 {
   if (block_buffer_tail == next_buffer_head) { return(true); }
+  if (plan_get_block_buffer_count() >= settings.planner_blocks) { return(true); } // Depth set by '$33'.
   return(false);
 }
 
@@ -271,30 +317,153 @@ float plan_compute_profile_nominal_speed(plan_block_t *block)
 
 // Computes and updates the max entry speed (sqr) of the block, based on the minimum of the junction's
 // previous and current nominal speeds and max junction speed.
-static void plan_compute_profile_parameters(plan_block_t *block, float nominal_speed, float prev_nominal_speed)
+static void plan_compute_profile_parameters(uint16_t block_index, float nominal_speed, float prev_nominal_speed)
 {
+  plan_profile_t *profile = &block_profile[block_index];
   // Compute the junction maximum entry based on the minimum of the junction speed and neighboring nominal speeds.
-  if (nominal_speed > prev_nominal_speed) { block->max_entry_speed_sqr = prev_nominal_speed*prev_nominal_speed; }
-  else { block->max_entry_speed_sqr = nominal_speed*nominal_speed; }
-  if (block->max_entry_speed_sqr > block->max_junction_speed_sqr) { block->max_entry_speed_sqr = block->max_junction_speed_sqr; }
+  if (nominal_speed > prev_nominal_speed) { profile->max_entry_speed_sqr = prev_nominal_speed*prev_nominal_speed; }
+  else { profile->max_entry_speed_sqr = nominal_speed*nominal_speed; }
+  if (profile->max_entry_speed_sqr > block_buffer[block_index].max_junction_speed_sqr) {
+    profile->max_entry_speed_sqr = block_buffer[block_index].max_junction_speed_sqr;
+  }
 }
 
 
-// Re-calculates buffered motions profile parameters upon a motion-based override change.
+// Re-calculates buffered motions profile parameters upon a motion-based override change, and replans.
+// The segment generator picks up the new nominal speed of the executing block when it reloads it. Only
+// the blocks up to the last one whose entry speed limit was lowered are replanned, from the buffer
+// tail. A raised limit replans the whole buffer. See planner_recalculate() notes.
 void plan_update_velocity_profile_parameters()
 {
-  uint8_t block_index = block_buffer_tail;
-  plan_block_t *block;
-  float nominal_speed;
+  ST_PREP_LOCK();
+  uint16_t block_index = block_buffer_tail;
+  uint16_t last_index = block_buffer_head; // Last block with a new limit. None yet.
+  uint8_t raised = false;
+  float nominal_speed, max_entry_speed_sqr;
   float prev_nominal_speed = SOME_LARGE_VALUE; // Set high for first block nominal speed calculation.
   while (block_index != block_buffer_head) {
-    block = &block_buffer[block_index];
-    nominal_speed = plan_compute_profile_nominal_speed(block);
-    plan_compute_profile_parameters(block, nominal_speed, prev_nominal_speed);
+    nominal_speed = plan_compute_profile_nominal_speed(&block_buffer[block_index]);
+    max_entry_speed_sqr = block_profile[block_index].max_entry_speed_sqr;
+    plan_compute_profile_parameters(block_index, nominal_speed, prev_nominal_speed);
+    if (block_profile[block_index].max_entry_speed_sqr != max_entry_speed_sqr) {
+      if (block_profile[block_index].max_entry_speed_sqr > max_entry_speed_sqr) { raised = true; }
+      last_index = block_index;
+    }
     prev_nominal_speed = nominal_speed;
     block_index = plan_next_block_index(block_index);
   }
   pl.previous_nominal_speed = prev_nominal_speed; // Update prev nominal speed for next incoming block.
+
+  st_update_plan_block_parameters();
+  if (last_index != block_buffer_head) {
+    if (raised) { last_index = plan_prev_block_index(block_buffer_head); }
+    block_buffer_planned = block_buffer_tail;
+    planner_recalculate(last_index);
+  }
+  ST_PREP_UNLOCK();
+}
+
+
+// Completes a new block whose motion data is set. Computes the junction speed limit from the direction
+// the block starts in, keeps the direction it ends in for the next block, then adds it to the buffer
+// and replans. The directions only differ for arcs.
+static void plan_buffer_block(plan_block_t *block, float *entry_unit_vec, float *exit_unit_vec, int32_t *target_steps)
+{
+  uint8_t idx;
+
+  #ifdef JERK_LIMITED_PROFILES
+    // Plan with a lower acceleration, so the segment generator has the time for a jerk-limited ramp
+    // within the axis acceleration limits. From rest to the nominal speed V, that ramp takes
+    // V/A + A/J. The planned ramp takes V/a, so a = A*V/(V + A^2/J). See st_ramp_setup().
+    plan_profile_t *profile = &block_profile[block_buffer_head];
+    float speed = min(block->programmed_rate, block->rapid_rate);
+    block->peak_acceleration = profile->acceleration;
+    if ((block->jerk > 0.0f) && (speed > 0.0f)) {
+      profile->acceleration *= speed/(speed + profile->acceleration*profile->acceleration/block->jerk);
+    }
+  #endif
+
+  // TODO: Need to check this method handling zero junction speeds when starting from rest.
+  if ((block_buffer_head == block_buffer_tail) || (block->condition & PL_COND_FLAG_SYSTEM_MOTION)) {
+
+    // Initialize block entry speed as zero. Assume it will be starting from rest. Planner will correct this later.
+    // If system motion, the system motion block always is assumed to start from rest and end at a complete stop.
+    block_profile[block_buffer_head].entry_speed_sqr = 0.0f;
+    block->max_junction_speed_sqr = 0.0f; // Starting from rest. Enforce start from zero velocity.
+
+  } else {
+    // Compute maximum allowable entry speed at junction by centripetal acceleration approximation.
+    // Let a circle be tangent to both previous and current path line segments, where the junction
+    // deviation is defined as the distance from the junction to the closest edge of the circle,
+    // colinear with the circle center. The circular segment joining the two paths represents the
+    // path of centripetal acceleration. Solve for max velocity based on max acceleration about the
+    // radius of the circle, defined indirectly by junction deviation. This may be also viewed as
+    // path width or max_jerk in the previous Grbl version. This approach does not actually deviate
+    // from path, but used as a robust way to compute cornering speeds, as it takes into account the
+    // nonlinearities of both the junction angle and junction velocity.
+    //
+    // NOTE: If the junction deviation value is finite, Grbl executes the motions in an exact path
+    // mode (G61). If the junction deviation value is zero, Grbl will execute the motion in an exact
+    // stop mode (G61.1) manner. In the future, if continuous mode (G64) is desired, the math here
+    // is exactly the same. Instead of motioning all the way to junction point, the machine will
+    // just follow the arc circle defined here. The Arduino doesn't have the CPU cycles to perform
+    // a continuous mode path, but ARM-based microcontrollers most certainly do.
+    //
+    // NOTE: The max junction speed is a fixed value, since machine acceleration limits cannot be
+    // changed dynamically during operation nor can the line move geometry. This must be kept in
+    // memory in the event of a feedrate override changing the nominal speeds of blocks, which can
+    // change the overall maximum entry speed conditions of all blocks.
+
+    float junction_unit_vec[N_AXIS];
+    float junction_cos_theta = 0.0f;
+    for (idx=0; idx<N_AXIS; idx++) {
+      junction_cos_theta -= pl.previous_unit_vec[idx]*entry_unit_vec[idx];
+      junction_unit_vec[idx] = entry_unit_vec[idx]-pl.previous_unit_vec[idx];
+    }
+
+    // NOTE: Computed without any expensive trig, sin() or acos(), by trig half angle identity of cos(theta).
+    if (junction_cos_theta > 0.999999f) {
+      //  For a 0 degree acute junction, just set minimum junction speed.
+      block->max_junction_speed_sqr = MINIMUM_JUNCTION_SPEED*MINIMUM_JUNCTION_SPEED;
+    } else {
+      if (junction_cos_theta < -0.999999f) {
+        // Junction is a straight line or 180 degrees. Junction speed is infinite.
+        block->max_junction_speed_sqr = SOME_LARGE_VALUE;
+      } else {
+        convert_delta_vector_to_unit_vector(junction_unit_vec);
+        float junction_acceleration = limit_value_by_axis_maximum(settings.acceleration, junction_unit_vec);
+        float sin_theta_d2 = sqrtf(0.5f*(1.0f-junction_cos_theta)); // Trig half angle identity. Always positive.
+        block->max_junction_speed_sqr = max( MINIMUM_JUNCTION_SPEED*MINIMUM_JUNCTION_SPEED,
+                       (junction_acceleration * settings.junction_deviation * sin_theta_d2)/(1.0f-sin_theta_d2) );
+      }
+    }
+  }
+
+  // Block system motion from updating this data to ensure next g-code motion is computed correctly.
+  if (!(block->condition & PL_COND_FLAG_SYSTEM_MOTION)) {
+    float nominal_speed = plan_compute_profile_nominal_speed(block);
+    plan_compute_profile_parameters(block_buffer_head, nominal_speed, pl.previous_nominal_speed);
+    pl.previous_nominal_speed = nominal_speed;
+    
+    // Update previous path unit_vector and planner position.
+    memcpy(pl.previous_unit_vec, exit_unit_vec, sizeof(pl.previous_unit_vec)); // pl.previous_unit_vec[] = exit_unit_vec[]
+    memcpy(pl.position, target_steps, sizeof(pl.position)); // pl.position[] = target_steps[]
+
+    // New block is all set. Update buffer head and next buffer head indices.
+    block_buffer_head = next_buffer_head;
+    next_buffer_head = plan_next_block_index(block_buffer_head);
+
+    #ifdef PLANNER_RECALC_MAX_BLOCKS
+      // Bound the replan to the newest blocks. See planner_recalculate() notes.
+      uint16_t block_index = plan_prev_block_index(block_buffer_head);
+      if (((block_index+BLOCK_BUFFER_SIZE-block_buffer_planned) % BLOCK_BUFFER_SIZE) > PLANNER_RECALC_MAX_BLOCKS) {
+        block_buffer_planned = (block_index+BLOCK_BUFFER_SIZE-PLANNER_RECALC_MAX_BLOCKS) % BLOCK_BUFFER_SIZE;
+      }
+    #endif
+
+    // Finish up by recalculating the plan with the new block.
+    planner_recalculate(plan_prev_block_index(block_buffer_head));
+  }
 }
 
 
@@ -314,9 +483,13 @@ void plan_update_velocity_profile_parameters()
    to execute the special system motion. */
 uint8_t plan_buffer_line(float *target, plan_line_data_t *pl_data)
 {
+  ST_PREP_LOCK(); // Planner state is shared with the segment prep task.
+
   // Prepare and initialize new block. Copy relevant pl_data for block execution.
   plan_block_t *block = &block_buffer[block_buffer_head];
+  plan_profile_t *profile = &block_profile[block_buffer_head];
   memset(block,0,sizeof(plan_block_t)); // Zero all block values.
+  memset(profile,0,sizeof(plan_profile_t));
   block->condition = pl_data->condition;
   #ifdef VARIABLE_SPINDLE
     block->spindle_speed = pl_data->spindle_speed;
@@ -378,98 +551,129 @@ uint8_t plan_buffer_line(float *target, plan_line_data_t *pl_data)
   }
 
   // Bail if this is a zero-length block. Highly unlikely to occur.
-  if (block->step_event_count == 0) { return(PLAN_EMPTY_BLOCK); }
+  if (block->step_event_count == 0) { ST_PREP_UNLOCK(); return(PLAN_EMPTY_BLOCK); }
 
   // Calculate the unit vector of the line move and the block maximum feed rate and acceleration scaled
   // down such that no individual axes maximum values are exceeded with respect to the line direction.
   // NOTE: This calculation assumes all axes are orthogonal (Cartesian) and works with ABC-axes,
   // if they are also orthogonal/independent. Operates on the absolute value of the unit vector.
-  block->millimeters = convert_delta_vector_to_unit_vector(unit_vec);
-  block->acceleration = limit_value_by_axis_maximum(settings.acceleration, unit_vec);
+  profile->millimeters = convert_delta_vector_to_unit_vector(unit_vec);
+  profile->acceleration = limit_value_by_axis_maximum(settings.acceleration, unit_vec);
+  #ifdef JERK_LIMITED_PROFILES
+    block->jerk = limit_value_by_axis_maximum(settings.jerk, unit_vec);
+  #endif
   block->rapid_rate = limit_value_by_axis_maximum(settings.max_rate, unit_vec);
 
   // Store programmed rate.
   if (block->condition & PL_COND_FLAG_RAPID_MOTION) { block->programmed_rate = block->rapid_rate; }
   else { 
     block->programmed_rate = pl_data->feed_rate;
-    if (block->condition & PL_COND_FLAG_INVERSE_TIME) { block->programmed_rate *= block->millimeters; }
+    if (block->condition & PL_COND_FLAG_INVERSE_TIME) { block->programmed_rate *= profile->millimeters; }
   }
 
-  // TODO: Need to check this method handling zero junction speeds when starting from rest.
-  if ((block_buffer_head == block_buffer_tail) || (block->condition & PL_COND_FLAG_SYSTEM_MOTION)) {
+  plan_buffer_block(block, unit_vec, unit_vec, target_steps);
+  ST_PREP_UNLOCK();
+  return(PLAN_OK);
+}
 
-    // Initialize block entry speed as zero. Assume it will be starting from rest. Planner will correct this later.
-    // If system motion, the system motion block always is assumed to start from rest and end at a complete stop.
-    block->entry_speed_sqr = 0.0f;
-    block->max_junction_speed_sqr = 0.0f; // Starting from rest. Enforce start from zero velocity.
 
-  } else {
-    // Compute maximum allowable entry speed at junction by centripetal acceleration approximation.
-    // Let a circle be tangent to both previous and current path line segments, where the junction
-    // deviation is defined as the distance from the junction to the closest edge of the circle,
-    // colinear with the circle center. The circular segment joining the two paths represents the
-    // path of centripetal acceleration. Solve for max velocity based on max acceleration about the
-    // radius of the circle, defined indirectly by junction deviation. This may be also viewed as
-    // path width or max_jerk in the previous Grbl version. This approach does not actually deviate
-    // from path, but used as a robust way to compute cornering speeds, as it takes into account the
-    // nonlinearities of both the junction angle and junction velocity.
-    //
-    // NOTE: If the junction deviation value is finite, Grbl executes the motions in an exact path
-    // mode (G61). If the junction deviation value is zero, Grbl will execute the motion in an exact
-    // stop mode (G61.1) manner. In the future, if continuous mode (G64) is desired, the math here
-    // is exactly the same. Instead of motioning all the way to junction point, the machine will
-    // just follow the arc circle defined here. The Arduino doesn't have the CPU cycles to perform
-    // a continuous mode path, but ARM-based microcontrollers most certainly do.
-    //
-    // NOTE: The max junction speed is a fixed value, since machine acceleration limits cannot be
-    // changed dynamically during operation nor can the line move geometry. This must be kept in
-    // memory in the event of a feedrate override changing the nominal speeds of blocks, which can
-    // change the overall maximum entry speed conditions of all blocks.
+#ifdef NATIVE_ARCS
+/* Add a circular or helical arc to the buffer as a single block. The arc turns by angular_travel
+   (radians, positive counter-clockwise) about center in the plane of axis_0 and axis_1, while all
+   other axes move linearly to target. The block keeps the arc geometry for the stepper module, which
+   traces the arc while it generates the step segments, and the usual axis step counts and direction
+   bits of the chord from start to end, which give its exact end point.
+   The junctions at both ends are computed from the tangents of the arc there. The direction changes
+   continuously along the arc, so its acceleration and maximum rate are limited as if each plane axis
+   could carry the full in-plane motion. The nominal speed is further held to where the centripetal
+   acceleration takes half of the plane acceleration limit, and the acceleration along the path is
+   reduced to the sqrt(3)/2 share left, so the sum of both never exceeds the axis limits.
+   NOTE: Assumes buffer is available, like plan_buffer_line(). */
+uint8_t plan_buffer_arc(float *target, plan_line_data_t *pl_data, float *center, float radius,
+                        float angular_travel, uint8_t axis_0, uint8_t axis_1)
+{
+  ST_PREP_LOCK(); // Planner state is shared with the segment prep task.
 
-    float junction_unit_vec[N_AXIS];
-    float junction_cos_theta = 0.0f;
-    for (idx=0; idx<N_AXIS; idx++) {
-      junction_cos_theta -= pl.previous_unit_vec[idx]*unit_vec[idx];
-      junction_unit_vec[idx] = unit_vec[idx]-pl.previous_unit_vec[idx];
-    }
+  plan_block_t *block = &block_buffer[block_buffer_head];
+  plan_profile_t *profile = &block_profile[block_buffer_head];
+  memset(block,0,sizeof(plan_block_t)); // Zero all block values.
+  memset(profile,0,sizeof(plan_profile_t));
+  block->condition = pl_data->condition;
+  #ifdef VARIABLE_SPINDLE
+    block->spindle_speed = pl_data->spindle_speed;
+  #endif
+  #ifdef USE_LINE_NUMBERS
+    block->line_number = pl_data->line_number;
+  #endif
 
-    // NOTE: Computed without any expensive trig, sin() or acos(), by trig half angle identity of cos(theta).
-    if (junction_cos_theta > 0.999999f) {
-      //  For a 0 degree acute junction, just set minimum junction speed.
-      block->max_junction_speed_sqr = MINIMUM_JUNCTION_SPEED*MINIMUM_JUNCTION_SPEED;
-    } else {
-      if (junction_cos_theta < -0.999999f) {
-        // Junction is a straight line or 180 degrees. Junction speed is infinite.
-        block->max_junction_speed_sqr = SOME_LARGE_VALUE;
-      } else {
-        convert_delta_vector_to_unit_vector(junction_unit_vec);
-        float junction_acceleration = limit_value_by_axis_maximum(settings.acceleration, junction_unit_vec);
-        float sin_theta_d2 = sqrtf(0.5f*(1.0f-junction_cos_theta)); // Trig half angle identity. Always positive.
-        block->max_junction_speed_sqr = max( MINIMUM_JUNCTION_SPEED*MINIMUM_JUNCTION_SPEED,
-                       (junction_acceleration * settings.junction_deviation * sin_theta_d2)/(1.0f-sin_theta_d2) );
-      }
-    }
+  int32_t target_steps[N_AXIS];
+  float entry_unit_vec[N_AXIS], exit_unit_vec[N_AXIS], limit_vec[N_AXIS];
+  float delta_mm, linear_sqr = 0.0f;
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS; idx++) {
+    target_steps[idx] = lroundf(target[idx]*settings.steps_per_mm[idx]);
+    block->steps[idx] = labs(target_steps[idx]-pl.position[idx]);
+    block->step_event_count = max(block->step_event_count, block->steps[idx]);
+    delta_mm = (target_steps[idx]-pl.position[idx])/settings.steps_per_mm[idx];
+    if (delta_mm < 0.0f ) { block->direction_bits |= get_direction_pin_mask(idx); }
+    // The plane axes follow the circle. All others move linearly along with it.
+    if ((idx == axis_0) || (idx == axis_1)) { delta_mm = 0.0f; }
+    entry_unit_vec[idx] = delta_mm;
+    linear_sqr += delta_mm*delta_mm;
   }
 
-  // Block system motion from updating this data to ensure next g-code motion is computed correctly.
-  if (!(block->condition & PL_COND_FLAG_SYSTEM_MOTION)) {
-    float nominal_speed = plan_compute_profile_nominal_speed(block);
-    plan_compute_profile_parameters(block, nominal_speed, pl.previous_nominal_speed);
-    pl.previous_nominal_speed = nominal_speed;
-    
-    // Update previous path unit_vector and planner position.
-    memcpy(pl.previous_unit_vec, unit_vec, sizeof(unit_vec)); // pl.previous_unit_vec[] = unit_vec[]
-    memcpy(pl.position, target_steps, sizeof(target_steps)); // pl.position[] = target_steps[]
+  float start_angle = atan2f(pl.position[axis_1]/settings.steps_per_mm[axis_1]-center[1],
+                             pl.position[axis_0]/settings.steps_per_mm[axis_0]-center[0]);
+  float planar_mm = fabsf(angular_travel)*radius;
+  profile->millimeters = sqrtf(planar_mm*planar_mm+linear_sqr);
+  if (profile->millimeters <= 0.0f) { ST_PREP_UNLOCK(); return(PLAN_EMPTY_BLOCK); }
+
+  block->arc.center[0] = center[0];
+  block->arc.center[1] = center[1];
+  block->arc.radius = radius;
+  block->arc.start_angle = start_angle;
+  block->arc.angular_travel = angular_travel;
+  block->arc.length = profile->millimeters;
+  block->arc.axis_0 = axis_0;
+  block->arc.axis_1 = axis_1;
+  memcpy(block->arc.start_steps, pl.position, sizeof(pl.position));
+
+  // Unit tangents at both ends and the worst case direction for the axis limits.
+  float inv_length = 1.0f/profile->millimeters;
+  float planar = planar_mm*inv_length;
+  float sense = (angular_travel < 0.0f) ? -planar : planar;
+  for (idx=0; idx<N_AXIS; idx++) {
+    entry_unit_vec[idx] *= inv_length;
+    exit_unit_vec[idx] = entry_unit_vec[idx];
+    limit_vec[idx] = fabsf(entry_unit_vec[idx]);
+  }
+  float end_angle = start_angle+angular_travel;
+  entry_unit_vec[axis_0] = -sense*sinf(start_angle);
+  entry_unit_vec[axis_1] = sense*cosf(start_angle);
+  exit_unit_vec[axis_0] = -sense*sinf(end_angle);
+  exit_unit_vec[axis_1] = sense*cosf(end_angle);
+  limit_vec[axis_0] = planar;
+  limit_vec[axis_1] = planar;
+
+  float plane_acceleration = min(settings.acceleration[axis_0], settings.acceleration[axis_1]);
+  profile->acceleration = 0.8660254f*limit_value_by_axis_maximum(settings.acceleration, limit_vec);
+  #ifdef JERK_LIMITED_PROFILES
+    block->jerk = limit_value_by_axis_maximum(settings.jerk, limit_vec);
+  #endif
+  block->rapid_rate = limit_value_by_axis_maximum(settings.max_rate, limit_vec);
+  block->rapid_rate = min(block->rapid_rate, sqrtf(0.5f*plane_acceleration*radius));
 
-    // New block is all set. Update buffer head and next buffer head indices.
-    block_buffer_head = next_buffer_head;
-    next_buffer_head = plan_next_block_index(block_buffer_head);
+  // Chord length along which the arc stays within the arc tolerance. Bounds the segment length.
+  block->arc.chord = sqrtf(8.0f*radius*settings.arc_tolerance);
 
-    // Finish up by recalculating the plan with the new block.
-    planner_recalculate();
-  }
+  block->programmed_rate = pl_data->feed_rate;
+  if (block->condition & PL_COND_FLAG_INVERSE_TIME) { block->programmed_rate *= profile->millimeters; }
+
+  plan_buffer_block(block, entry_unit_vec, exit_unit_vec, target_steps);
+  ST_PREP_UNLOCK();
   return(PLAN_OK);
 }
+#endif
 
 
 // Reset the planner position vectors. Called by the system abort/initialization routine.
@@ -495,16 +699,16 @@ void plan_sync_position()
 
 
 // Returns the number of available blocks are in the planner buffer.
-uint8_t plan_get_block_buffer_available()
+uint16_t plan_get_block_buffer_available()
 {
-  if (block_buffer_head >= block_buffer_tail) { return((BLOCK_BUFFER_SIZE-1)-(block_buffer_head-block_buffer_tail)); }
-  return((block_buffer_tail-block_buffer_head-1));
+  uint16_t block_count = plan_get_block_buffer_count();
+  if (block_count >= settings.planner_blocks) { return(0); }
+  return(settings.planner_blocks-block_count);
 }
 
 
 // Returns the number of active blocks are in the planner buffer.
-// NOTE: Deprecated. Not used unless classic status reports are enabled in config.h
-uint8_t plan_get_block_buffer_count()
+uint16_t plan_get_block_buffer_count()
 {
   if (block_buffer_head >= block_buffer_tail) { return(block_buffer_head-block_buffer_tail); }
   return(BLOCK_BUFFER_SIZE - (block_buffer_tail-block_buffer_head));
@@ -516,7 +720,9 @@ uint8_t plan_get_block_buffer_count()
 void plan_cycle_reinitialize()
 {
   // Re-plan from a complete stop. Reset planner entry speeds and buffer planned pointer.
+  ST_PREP_LOCK();
   st_update_plan_block_parameters();
   block_buffer_planned = block_buffer_tail;
-  planner_recalculate();
+  if (block_buffer_head != block_buffer_tail) { planner_recalculate(plan_prev_block_index(block_buffer_head)); }
+  ST_PREP_UNLOCK();
 }
@@ -23,7 +23,8 @@
 #define planner_h
 
 
-// The number of linear motions that can be in the plan at any give time
+// The number of linear motions that can be in the plan at any give time. Ring buffer indices are
+// 16-bit, so config.h may raise this well past the AVR default (see BLOCK_BUFFER_SIZE there).
 #ifndef BLOCK_BUFFER_SIZE
   #ifdef USE_LINE_NUMBERS
     #define BLOCK_BUFFER_SIZE 15
@@ -67,6 +68,35 @@ typedef enum {						    // value typing for config and JSON
 #define PL_COND_ACCESSORY_MASK (PL_COND_FLAG_SPINDLE_CW|PL_COND_FLAG_SPINDLE_CCW|PL_COND_FLAG_COOLANT_FLOOD|PL_COND_FLAG_COOLANT_MIST)
 
 
+#ifdef NATIVE_ARCS
+// Geometry of an arc block, traced by the stepper module while it generates the step segments.
+typedef struct {
+  float center[2];          // Arc center in the plane of axis_0 and axis_1 (mm)
+  float radius;             // Arc radius (mm). Zero for a line block.
+  float start_angle;        // Angle of the start point about the center (radians)
+  float angular_travel;     // Angle turned from start to end, positive counter-clockwise (radians)
+  float length;             // Path length of the whole arc, including helical travel (mm)
+  float chord;              // Longest segment that stays within the arc tolerance (mm)
+  int32_t start_steps[N_AXIS]; // Start point (steps)
+  uint8_t axis_0;
+  uint8_t axis_1;
+} plan_arc_t;
+#endif
+
+// Fields used by the motion planner to manage acceleration. Some of these values may be updated
+// by the stepper module during execution of special motion cases for replanning purposes.
+// NOTE: Kept apart from the block data, in an array indexed like the block buffer, so the planner
+// passes only stride over these 16 bytes per block. With both arrays in DTCM this saves no cycles,
+// and on the host it measured the same as the fields inside plan_block_t. See sim/test/planner_test.c.
+typedef struct {
+  float entry_speed_sqr;     // The current planned entry speed at block junction in (mm/min)^2
+  float max_entry_speed_sqr; // Maximum allowable entry speed based on the minimum of junction limit and
+                             //   neighboring nominal speeds with overrides in (mm/min)^2
+  float acceleration;        // Axis-limit adjusted line acceleration in (mm/min^2). Does not change.
+  float millimeters;         // The remaining distance for this block to be executed in (mm).
+                             // NOTE: This value may be altered by stepper algorithm during execution.
+} plan_profile_t;
+
 // This struct stores a linear movement of a g-code block motion with its critical "nominal" values
 // are as specified in the source g-code.
 typedef struct {
@@ -82,14 +112,10 @@ typedef struct {
     int32_t line_number;  // Block line number for real-time reporting. Copied from pl_line_data.
   #endif
 
-  // Fields used by the motion planner to manage acceleration. Some of these values may be updated
-  // by the stepper module during execution of special motion cases for replanning purposes.
-  float entry_speed_sqr;     // The current planned entry speed at block junction in (mm/min)^2
-  float max_entry_speed_sqr; // Maximum allowable entry speed based on the minimum of junction limit and
-                             //   neighboring nominal speeds with overrides in (mm/min)^2
-  float acceleration;        // Axis-limit adjusted line acceleration in (mm/min^2). Does not change.
-  float millimeters;         // The remaining distance for this block to be executed in (mm).
-                             // NOTE: This value may be altered by stepper algorithm during execution.
+  #ifdef JERK_LIMITED_PROFILES
+    float jerk;              // Axis-limit adjusted line jerk in (mm/min^3). Does not change.
+    float peak_acceleration; // Axis-limit adjusted acceleration in (mm/min^2), never exceeded by the ramps.
+  #endif
 
   // Stored rate limiting data used by planner when changes occur.
   float max_junction_speed_sqr; // Junction entry speed limit based on direction vectors in (mm/min)^2
@@ -100,6 +126,10 @@ typedef struct {
     // Stored spindle speed data used by spindle overrides and resuming methods.
     float spindle_speed;    // Block spindle speed. Copied from pl_line_data.
   #endif
+
+  #ifdef NATIVE_ARCS
+    plan_arc_t arc;         // Arc geometry, when arc.radius is not zero.
+  #endif
 } plan_block_t;
 
 
@@ -123,6 +153,13 @@ void plan_reset_buffer(); // Reset buffer only.
 // rate is taken to mean "frequency" and would complete the operation in 1/feed_rate minutes.
 uint8_t plan_buffer_line(float *target, plan_line_data_t *pl_data);
 
+#ifdef NATIVE_ARCS
+  // Add a circular or helical arc to the buffer as a single block. Turns by angular_travel about
+  // center in the plane of axis_0 and axis_1, while the other axes move linearly to target.
+  uint8_t plan_buffer_arc(float *target, plan_line_data_t *pl_data, float *center, float radius,
+                          float angular_travel, uint8_t axis_0, uint8_t axis_1);
+#endif
+
 // Called when the current block is no longer needed. Discards the block and makes the memory
 // availible for new blocks.
 void plan_discard_current_block();
@@ -133,8 +170,11 @@ plan_block_t *plan_get_system_motion_block();
 // Gets the current block. Returns NULL if buffer empty
 plan_block_t *plan_get_current_block();
 
+// Returns address of the planner profile of a block, from the ones above.
+plan_profile_t *plan_get_block_profile(plan_block_t *block);
+
 // Called periodically by step segment buffer. Mostly used internally by planner.
-uint8_t plan_next_block_index(uint8_t block_index);
+uint16_t plan_next_block_index(uint16_t block_index);
 
 // Called by step segment buffer when computing executing block velocity profile.
 float plan_get_exec_block_exit_speed_sqr();
@@ -142,7 +182,8 @@ float plan_get_exec_block_exit_speed_sqr();
 // Called by main program during planner calculations and step segment buffer during initialization.
 float plan_compute_profile_nominal_speed(plan_block_t *block);
 
-// Re-calculates buffered motions profile parameters upon a motion-based override change.
+// Re-calculates buffered motions profile parameters upon a motion-based override change, and replans
+// only the blocks whose speed limits changed.
 void plan_update_velocity_profile_parameters();
 
 // Reset the planner position vector (in steps)
@@ -151,12 +192,11 @@ void plan_sync_position();
 // Reinitialize plan with a partially completed block
 void plan_cycle_reinitialize();
 
-// Returns the number of available blocks are in the planner buffer.
-uint8_t plan_get_block_buffer_available();
+// Returns the number of available blocks are in the planner buffer, up to the depth set by '$33'.
+uint16_t plan_get_block_buffer_available();
 
 // Returns the number of active blocks are in the planner buffer.
-// NOTE: Deprecated. Not used unless classic status reports are enabled in config.h
-uint8_t plan_get_block_buffer_count();
+uint16_t plan_get_block_buffer_count();
 
 // Returns the status of the block ring buffer. True, if buffer is full.
 uint8_t plan_check_full_buffer();
@@ -0,0 +1,73 @@
+/*
+  profile.c - execution time profiling of the realtime code paths
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef ENABLE_CYCLE_PROFILING
+
+static profile_stat_t profile_stat[N_PROFILE];
+
+
+void profile_init()
+{
+  // Enable the trace unit and unlock the Cortex-M7 DWT registers before starting the cycle counter.
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->LAR = 0xC5ACCE55;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  profile_reset();
+}
+
+
+void profile_reset()
+{
+  // Samples may be recorded by the stepper interrupts at any time.
+  __disable_irq();
+  memset(profile_stat, 0, sizeof(profile_stat));
+  uint8_t idx;
+  for (idx=0; idx<N_PROFILE; idx++) { profile_stat[idx].min = 0xFFFFFFFF; }
+  __enable_irq();
+  st_reset_underrun_count();
+}
+
+
+// NOTE: Called from interrupts of different priorities. Disabling interrupts keeps each sample
+// consistent and only costs a few cycles.
+void profile_record(uint8_t probe, uint32_t cycles)
+{
+  profile_stat_t *stat = &profile_stat[probe];
+  uint8_t bin = 32-__CLZ(cycles >> 6);
+  if (bin >= PROFILE_HISTOGRAM_BINS) { bin = PROFILE_HISTOGRAM_BINS-1; }
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  stat->count++;
+  stat->total += cycles;
+  if (cycles < stat->min) { stat->min = cycles; }
+  if (cycles > stat->max) { stat->max = cycles; }
+  stat->histogram[bin]++;
+  __set_PRIMASK(primask);
+}
+
+
+profile_stat_t *profile_get_stat(uint8_t probe)
+{
+  return(&profile_stat[probe]);
+}
+
+#endif
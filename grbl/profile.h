@@ -0,0 +1,63 @@
+/*
+  profile.h - execution time profiling of the realtime code paths
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef profile_h
+#define profile_h
+
+// Profiled code paths. Index into the statistics table.
+#define PROFILE_STEP_ISR          0 // The Stepper Driver Interrupt (_TIM2_IRQHandler)
+#define PROFILE_STEP_RESET_ISR    1 // The Stepper Port Reset Interrupt (_TIM3_IRQHandler)
+#define PROFILE_STEP_DMA_ISR      2 // DMA step table refill (_DMA2_Stream1_IRQHandler)
+#define PROFILE_PREP_BUFFER       3 // st_prep_buffer()
+#define PROFILE_PLANNER_RECALC    4 // planner_recalculate()
+#define N_PROFILE                 5
+
+// Execution time histogram. Bin 0 counts samples under 64 cycles, bin n samples from 32<<n up to
+// 64<<n cycles. The last bin also counts everything longer.
+#define PROFILE_HISTOGRAM_BINS    12
+
+typedef struct {
+  uint32_t count;   // Number of samples
+  uint32_t min;     // Shortest sample in CPU cycles
+  uint32_t max;     // Longest sample in CPU cycles
+  uint64_t total;   // Sum of all samples in CPU cycles. Mean is total/count.
+  uint32_t histogram[PROFILE_HISTOGRAM_BINS];
+} profile_stat_t;
+
+#ifdef ENABLE_CYCLE_PROFILING
+  // Time stamps a code path into a local variable and records the cycles elapsed since then.
+  #define PROFILE_START(var)        uint32_t var = DWT->CYCCNT
+  #define PROFILE_END(probe,var)    profile_record(probe, DWT->CYCCNT-(var))
+#else
+  #define PROFILE_START(var)
+  #define PROFILE_END(probe,var)
+#endif
+
+// Enables the DWT cycle counter and clears all statistics.
+void profile_init();
+
+// Clears all statistics, including the step segment buffer underrun count.
+void profile_reset();
+
+// Adds one execution time sample in CPU cycles to a profiled code path.
+void profile_record(uint8_t probe, uint32_t cycles);
+
+// Returns the statistics of a profiled code path.
+profile_stat_t *profile_get_stat(uint8_t probe);
+
+#endif
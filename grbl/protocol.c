@@ -33,6 +33,30 @@ static char line[LINE_BUFFER_SIZE]; // Line to be executed. Zero-terminated.
 
 static void protocol_exec_rt_suspend();
 
+#ifdef JOB_STORAGE
+  static uint8_t line_from_job; // Line read from the job running from flash, not the serial stream.
+
+  // Reads the next character of the running job, else of the serial stream.
+  static uint8_t protocol_read()
+  {
+    if (job_is_running()) { return(job_read()); }
+    return(serial_read());
+  }
+
+  // Reports the status of a line. Job lines only report errors, which stop the job.
+  static void protocol_report_line_status(uint8_t status_code)
+  {
+    if (line_from_job) {
+      if (status_code == STATUS_OK) { return; }
+      job_stop();
+    }
+    report_status_message(status_code);
+  }
+#else
+  #define protocol_read() serial_read()
+  #define protocol_report_line_status(status_code) report_status_message(status_code)
+#endif
+
 
 /*
   GRBL PRIMARY LOOP:
@@ -83,11 +107,26 @@ void protocol_main_loop()
 
     // Process one line of incoming serial data, as the data becomes available. Performs an
     // initial filtering by removing spaces and comments and capitalizing all letters.
-    while((c = serial_read()) != SERIAL_NO_DATA) {
+    while((c = protocol_read()) != SERIAL_NO_DATA) {
+      #ifdef BINARY_PROTOCOL
+        // Binary motion packet. Its bytes are never part of a text line.
+        if ((c == PACKET_START) || packet_is_receiving()) {
+          if (packet_read(c)) {
+            protocol_execute_realtime(); // Runtime command check point.
+            if (sys.abort) { return; } // Bail to calling function upon system abort
+            packet_execute();
+            serial_acknowledge_line(); // Packet consumed. Free its characters for the host.
+          }
+          continue;
+        }
+      #endif
       if ((c == '\n') || (c == '\r')) { // End of line reached
 
         protocol_execute_realtime(); // Runtime command check point.
         if (sys.abort) { return; } // Bail to calling function upon system abort
+        #ifdef JOB_STORAGE
+          line_from_job = job_is_running(); // Before the line can start or stop a job.
+        #endif
 
         line[char_counter] = 0; // Set string termination character.
         #ifdef REPORT_ECHO_LINE_RECEIVED
@@ -97,26 +136,36 @@ void protocol_main_loop()
         // Direct and execute one line of formatted input, and report status of execution.
         if (line_flags & LINE_FLAG_OVERFLOW) {
           // Report line overflow error.
-          report_status_message(STATUS_OVERFLOW);
+          protocol_report_line_status(STATUS_OVERFLOW);
         } else if (line[0] == 0) {
           // Empty or comment line. For syncing purposes.
-          report_status_message(STATUS_OK);
+          protocol_report_line_status(STATUS_OK);
         } else if (line[0] == '$') {
           // Grbl '$' system command
-          report_status_message(system_execute_line(line));
+          protocol_report_line_status(system_execute_line(line));
+        #ifdef JOB_STORAGE
+          } else if (job_is_uploading()) {
+            // Store the line in the job uploaded to flash instead of executing it.
+            protocol_report_line_status(job_store_line(line));
+        #endif
         } else if (line[0] == '#') {
         	res = read_parameter_setting(&line[0], &counter, _setup.parameters, &index);
-        	if (res) report_status_message(res);
+        	if (res) protocol_report_line_status(res);
         	counter = 0;
         } else if (sys.state & (STATE_ALARM | STATE_JOG)) {
           // Everything else is gcode. Block if in alarm or jog mode.
-          report_status_message(STATUS_SYSTEM_GC_LOCK);
+          protocol_report_line_status(STATUS_SYSTEM_GC_LOCK);
         } else {
           // Parse and execute g-code block.
-          report_status_message(gc_execute_line(line));
+          protocol_report_line_status(gc_execute_line(line));
         }
 
         // Reset tracking data for next line.
+        #ifdef JOB_STORAGE
+          if (!line_from_job) { serial_acknowledge_line(); } // Response sent. Free its characters for the host.
+        #else
+          serial_acknowledge_line(); // Response sent. Free its characters for the host.
+        #endif
         line_flags = 0;
         char_counter = 0;
 
@@ -170,6 +219,16 @@ void protocol_main_loop()
 
     protocol_execute_realtime();  // Runtime command check point.
     if (sys.abort) { return; } // Bail to main() program loop to reset system.
+
+    // Append settings, offsets and parameters changed in RAM to the flash store, one page at a time, while idle.
+    // Not while a job runs from flash, so a page program never delays reading the job ahead.
+    if ((sys.state == STATE_IDLE) || (sys.state & (STATE_ALARM | STATE_CHECK_MODE))) {
+      #ifdef JOB_STORAGE
+        if (!job_is_running()) { eeprom_flush(); }
+      #else
+        eeprom_flush();
+      #endif
+    }
   }
 
   return; /* Never reached */
@@ -185,7 +244,11 @@ void protocol_buffer_synchronize()
   do {
     protocol_execute_realtime();   // Check and execute run-time commands
     if (sys.abort) { return; } // Check for system abort
-  } while (plan_get_current_block() || (sys.state == STATE_CYCLE));
+  #ifdef MOTION_QUEUE_SIZE
+    } while (plan_get_current_block() || mc_get_queue_count() || (sys.state == STATE_CYCLE));
+  #else
+    } while (plan_get_current_block() || (sys.state == STATE_CYCLE));
+  #endif
 }
 
 
@@ -216,8 +279,14 @@ void protocol_auto_cycle_start()
 // limit switches, or the main program.
 void protocol_execute_realtime()
 {
+  #ifdef GRBL_SIM
+    sim_loop(); // Feeds the input and runs the timer interrupts due on the virtual clock. See sim/.
+  #endif
   protocol_exec_rt_system();
   if (sys.suspend) { protocol_exec_rt_suspend(); }
+  #ifdef MOTION_QUEUE_SIZE
+    if (!sys.abort) { mc_queue_service(); } // Refill the planner from the parse-ahead queue.
+  #endif
 }
 
 
@@ -275,8 +344,10 @@ void protocol_exec_rt_system()
         // If in CYCLE or JOG states, immediately initiate a motion HOLD.
         if (sys.state & (STATE_CYCLE | STATE_JOG)) {
           if (!(sys.suspend & (SUSPEND_MOTION_CANCEL | SUSPEND_JOG_CANCEL))) { // Block, if already holding.
+            ST_PREP_LOCK(); // The segment prep task reads the step control flags.
             st_update_plan_block_parameters(); // Notify stepper module to recompute for hold deceleration.
             sys.step_control = STEP_CONTROL_EXECUTE_HOLD; // Initiate suspend state with active flag.
+            ST_PREP_UNLOCK();
             if (sys.state == STATE_JOG) { // Jog cancelled upon any hold event, except for sleeping.
               if (!(rt_exec & EXEC_SLEEP)) { sys.suspend |= SUSPEND_JOG_CANCEL; } 
             }
@@ -314,8 +385,10 @@ void protocol_exec_rt_system()
                 #ifdef PARKING_ENABLE
                   // Set hold and reset appropriate control flags to restart parking sequence.
                   if (sys.step_control & STEP_CONTROL_EXECUTE_SYS_MOTION) {
+                    ST_PREP_LOCK();
                     st_update_plan_block_parameters(); // Notify stepper module to recompute for hold deceleration.
                     sys.step_control = (STEP_CONTROL_EXECUTE_HOLD | STEP_CONTROL_EXECUTE_SYS_MOTION);
+                    ST_PREP_UNLOCK();
                     sys.suspend &= ~(SUSPEND_HOLD_COMPLETE);
                   } // else NO_MOTION is active.
                 #endif
@@ -364,6 +437,7 @@ void protocol_exec_rt_system()
             sys.spindle_stop_ovr |= SPINDLE_STOP_OVR_RESTORE_CYCLE; // Set to restore in suspend routine and cycle start after.
           } else {
             // Start cycle only if queued motions exist in planner buffer and the motion is not canceled.
+            ST_PREP_LOCK();
             sys.step_control = STEP_CONTROL_NORMAL_OP; // Restore step control to normal operation
             if (plan_get_current_block() && bit_isfalse(sys.suspend,SUSPEND_MOTION_CANCEL)) {
               sys.suspend = SUSPEND_DISABLE; // Break suspend state.
@@ -374,6 +448,7 @@ void protocol_exec_rt_system()
               sys.suspend = SUSPEND_DISABLE; // Break suspend state.
               sys.state = STATE_IDLE;
             }
+            ST_PREP_UNLOCK();
           }
         }
       }
@@ -389,16 +464,23 @@ void protocol_exec_rt_system()
       if ((sys.state & (STATE_HOLD|STATE_SAFETY_DOOR|STATE_SLEEP)) && !(sys.soft_limit) && !(sys.suspend & SUSPEND_JOG_CANCEL)) {
         // Hold complete. Set to indicate ready to resume.  Remain in HOLD or DOOR states until user
         // has issued a resume command or reset.
+        ST_PREP_LOCK();
         plan_cycle_reinitialize();
         if (sys.step_control & STEP_CONTROL_EXECUTE_HOLD) { sys.suspend |= SUSPEND_HOLD_COMPLETE; }
         bit_false(sys.step_control,(STEP_CONTROL_EXECUTE_HOLD | STEP_CONTROL_EXECUTE_SYS_MOTION));
+        ST_PREP_UNLOCK();
       } else {
         // Motion complete. Includes CYCLE/JOG/HOMING states and jog cancel/motion cancel/soft limit events.
         // NOTE: Motion and jog cancel both immediately return to idle after the hold completes.
         if (sys.suspend & SUSPEND_JOG_CANCEL) {   // For jog cancel, flush buffers and sync positions.
+          ST_PREP_LOCK();
           sys.step_control = STEP_CONTROL_NORMAL_OP;
           plan_reset();
+          #ifdef MOTION_QUEUE_SIZE
+            mc_queue_clear();
+          #endif
           st_reset();
+          ST_PREP_UNLOCK();
           gc_sync_position();
           plan_sync_position();
         }
@@ -438,8 +520,7 @@ void protocol_exec_rt_system()
       sys.f_override = new_f_override;
       sys.r_override = new_r_override;
       sys.report_ovr_counter = 0; // Set to report change immediately
-      plan_update_velocity_profile_parameters();
-      plan_cycle_reinitialize();
+      plan_update_velocity_profile_parameters(); // Replans the blocks with new speed limits.
     }
   }
 
@@ -461,7 +542,7 @@ void protocol_exec_rt_system()
       sys.spindle_speed_ovr = last_s_override;
       // NOTE: Spindle speed overrides during HOLD state are taken care of by suspend function.
       if (sys.state == STATE_IDLE) { spindle_set_state(gc_state.modal.spindle, gc_state.spindle_speed); }
-			else { bit_true(sys.step_control, STEP_CONTROL_UPDATE_SPINDLE_PWM); }
+			else { ST_PREP_LOCK(); bit_true(sys.step_control, STEP_CONTROL_UPDATE_SPINDLE_PWM); ST_PREP_UNLOCK(); }
       sys.report_ovr_counter = 0; // Set to report change immediately
     }
 
@@ -693,7 +774,9 @@ static void protocol_exec_rt_suspend()
               if (bit_isfalse(sys.suspend,SUSPEND_RESTART_RETRACT)) {
                 if (bit_istrue(settings.flags,BITFLAG_LASER_MODE)) {
                   // When in laser mode, ignore spindle spin-up delay. Set to turn on laser when cycle starts.
+                  ST_PREP_LOCK();
                   bit_true(sys.step_control, STEP_CONTROL_UPDATE_SPINDLE_PWM);
+                  ST_PREP_UNLOCK();
                 } else {
                   spindle_set_state((restore_condition & (PL_COND_FLAG_SPINDLE_CW | PL_COND_FLAG_SPINDLE_CCW)), restore_spindle_speed);
                   delay_sec(SAFETY_DOOR_SPINDLE_DELAY, DELAY_MODE_SYS_SUSPEND);
@@ -758,7 +841,9 @@ static void protocol_exec_rt_suspend()
               report_feedback_message(MESSAGE_SPINDLE_RESTORE);
               if (bit_istrue(settings.flags,BITFLAG_LASER_MODE)) {
                 // When in laser mode, ignore spindle spin-up delay. Set to turn on laser when cycle starts.
+                ST_PREP_LOCK();
                 bit_true(sys.step_control, STEP_CONTROL_UPDATE_SPINDLE_PWM);
+                ST_PREP_UNLOCK();
               } else {
                 spindle_set_state((restore_condition & (PL_COND_FLAG_SPINDLE_CW | PL_COND_FLAG_SPINDLE_CCW)), restore_spindle_speed);
               }
@@ -773,7 +858,9 @@ static void protocol_exec_rt_suspend()
           // NOTE: STEP_CONTROL_UPDATE_SPINDLE_PWM is automatically reset upon resume in step generator.
           if (bit_istrue(sys.step_control, STEP_CONTROL_UPDATE_SPINDLE_PWM)) {
             spindle_set_state((restore_condition & (PL_COND_FLAG_SPINDLE_CW | PL_COND_FLAG_SPINDLE_CCW)), restore_spindle_speed);
+            ST_PREP_LOCK();
             bit_false(sys.step_control, STEP_CONTROL_UPDATE_SPINDLE_PWM);
+            ST_PREP_UNLOCK();
           }
         }
 
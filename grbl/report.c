@@ -130,6 +130,9 @@ void report_feedback_message(uint8_t message_code)
 	    case MESSAGE_SLEEP_MODE:
 	    	sprintf(str_report,"[MSG:Sleeping]\r\n");
 	      break;
+	    case MESSAGE_JOB_END:
+	    	sprintf(str_report,"[MSG:Job end]\r\n");
+	      break;
 	  }
 	  CDC_send_str(str_report, strlen(str_report));
 }
@@ -180,6 +183,7 @@ void report_grbl_settings() {
 #else
   sprintf(str_report + strlen(str_report), "$%d=%d\r\n",     32, 0);
 #endif
+  sprintf(str_report + strlen(str_report), "$%d=%d\r\n",     33, settings.planner_blocks);
 
   // Print axis settings
   uint8_t idx, set_idx;
@@ -191,6 +195,7 @@ void report_grbl_settings() {
         case 1: sprintf(str_report + strlen(str_report), "$%d=%.3f\r\n",  val+idx, settings.max_rate[idx]); break;
         case 2: sprintf(str_report + strlen(str_report), "$%d=%.3f\r\n",  val+idx, settings.acceleration[idx]/(60.0f*60.0f)); break;
         case 3: sprintf(str_report + strlen(str_report), "$%d=%.3f\r\n",  val+idx, -settings.max_travel[idx]); break;
+        case 4: sprintf(str_report + strlen(str_report), "$%d=%.3f\r\n",  val+idx, settings.jerk[idx]/(60.0f*60.0f*60.0f)); break;
       }
     }
     val += AXIS_SETTINGS_INCREMENT;
@@ -360,11 +365,98 @@ void report_execute_startup_message(char *line, uint8_t status_code)
 // Prints build info line
 void report_build_info(char *line)
 {
-  sprintf(str_report,"[VER: %s.%s:%s]\r\n", GRBL_VERSION, GRBL_VERSION_BUILD, line);
+  sprintf(str_report,"[VER: %s.%s:%s]\r\n[OPT:", GRBL_VERSION, GRBL_VERSION_BUILD, line);
+  // Compile-time build option list, followed by the usable planner and serial buffer sizes.
+  #ifdef VARIABLE_SPINDLE
+    strcat(str_report,"V");
+  #endif
+  #ifdef USE_LINE_NUMBERS
+    strcat(str_report,"N");
+  #endif
+  #ifdef ENABLE_M7
+    strcat(str_report,"M");
+  #endif
+  #ifdef COREXY
+    strcat(str_report,"C");
+  #endif
+  #ifdef PARKING_ENABLE
+    strcat(str_report,"P");
+  #endif
+  #ifdef HOMING_FORCE_SET_ORIGIN
+    strcat(str_report,"Z");
+  #endif
+  #ifdef HOMING_SINGLE_AXIS_COMMANDS
+    strcat(str_report,"H");
+  #endif
+  #ifdef HOMING_INIT_LOCK
+    strcat(str_report,"L");
+  #endif
+  sprintf(str_report + strlen(str_report),",%d,%d]\r\n", settings.planner_blocks, RX_BUFFER_SIZE);
   CDC_send_str(str_report, strlen(str_report));
 }
 
 
+#ifdef JOB_STORAGE
+  // [JOB:<state>,<size>,<crc32>]
+  void report_job_info(uint8_t state, uint32_t size, uint32_t crc)
+  {
+    static const char job_state_name[4][7] = { "EMPTY", "UPLOAD", "READY", "RUN" };
+    sprintf(str_report,"[JOB:%s,%lu,%08lX]\r\n", job_state_name[state], (unsigned long)size, (unsigned long)crc);
+    CDC_send_str(str_report, strlen(str_report));
+  }
+#endif
+
+
+#ifdef BINARY_PROTOCOL
+  // [PKT:ACK,<seq>] or [PKT:ERR,<seq>,<status>]
+  void report_packet_status(uint8_t seq, uint8_t status_code)
+  {
+    if (status_code == STATUS_OK) { sprintf(str_report,"[PKT:ACK,%d]\r\n", seq); }
+    else { sprintf(str_report,"[PKT:ERR,%d,%d]\r\n", seq, status_code); }
+    CDC_send_str(str_report, strlen(str_report));
+  }
+
+
+  // [PKT:NAK,<seq>]
+  void report_packet_nak(uint8_t seq)
+  {
+    sprintf(str_report,"[PKT:NAK,%d]\r\n", seq);
+    CDC_send_str(str_report, strlen(str_report));
+  }
+#endif
+
+
+#ifdef ENABLE_CYCLE_PROFILING
+  // Prints the execution time statistics of the profiled code paths in CPU cycles, followed by the
+  // step segment buffer underrun count.
+  // [PRF:<path>|N:<count>|Min:<min>|Avg:<mean>|Max:<max>|H:<histogram bins>]
+  void report_profile()
+  {
+    static const char profile_name[N_PROFILE][6] = { "STEP", "RESET", "DMA", "PREP", "PLAN" };
+    uint8_t idx, bin;
+    sprintf(str_report,"[PRF:CLK|MHz:%lu]\r\n", (unsigned long)(F_CPU/1000000));
+    CDC_send_str(str_report, strlen(str_report));
+    for (idx=0; idx<N_PROFILE; idx++) {
+      profile_stat_t *stat = profile_get_stat(idx);
+      if (stat->count == 0) {
+        sprintf(str_report,"[PRF:%s|N:0]\r\n", profile_name[idx]);
+      } else {
+        sprintf(str_report,"[PRF:%s|N:%lu|Min:%lu|Avg:%lu|Max:%lu|H:", profile_name[idx],
+                (unsigned long)stat->count, (unsigned long)stat->min,
+                (unsigned long)(stat->total/stat->count), (unsigned long)stat->max);
+        for (bin=0; bin<PROFILE_HISTOGRAM_BINS; bin++) {
+          sprintf(str_report + strlen(str_report), (bin ? ",%lu" : "%lu"), (unsigned long)stat->histogram[bin]);
+        }
+        strcat(str_report,"]\r\n");
+      }
+      CDC_send_str(str_report, strlen(str_report));
+    }
+    sprintf(str_report,"[PRF:UNDERRUN|N:%lu]\r\n", (unsigned long)st_get_underrun_count());
+    CDC_send_str(str_report, strlen(str_report));
+  }
+#endif
+
+
 // Prints the character string line Grbl has received from the user, which has been pre-parsed,
 // and has been sent into protocol_execute_line() routine to be executed by Grbl.
 void report_echo_line_received(char *line)
@@ -450,14 +542,26 @@ void report_realtime_status()
   }
   switch (gc_state.z_select) {
   	  case MAP_P0 :
-  	  case MAP_P1 : sprintf(str_report + strlen(str_report),"%.3f,%.3f,%.3f,%.3f", print_position[X_AXIS], print_position[Y_AXIS], print_position[Z_AXIS], print_position[A_AXIS]);
+  	  case MAP_P1 :
+  	  #if N_AXIS > 3
+  	                sprintf(str_report + strlen(str_report),"%.3f,%.3f,%.3f,%.3f", print_position[X_AXIS], print_position[Y_AXIS], print_position[Z_AXIS], print_position[A_AXIS]);
+  	  #else
+  	                sprintf(str_report + strlen(str_report),"%.3f,%.3f,%.3f", print_position[X_AXIS], print_position[Y_AXIS], print_position[Z_AXIS]);
+  	  #endif
   		  	  	  	break;
+  	  // The other maps are only accepted when their axes are built in.
+  	  #if N_AXIS > 4
   	  case MAP_P2 : sprintf(str_report + strlen(str_report),"%.3f,%.3f,%.3f,%.3f", print_position[X_AXIS], print_position[Y_AXIS], print_position[Z_AXIS], print_position[B_AXIS]);
   	  		  	  	break;
+  	  #endif
+  	  #if N_AXIS > 6
   	  case MAP_P3 : sprintf(str_report + strlen(str_report),"%.3f,%.3f,%.3f,%.3f", print_position[X_AXIS], print_position[Y_AXIS], print_position[U_AXIS], print_position[C_AXIS]);
   	  	  		    break;
+  	  #endif
+  	  #if N_AXIS > 7
   	  case MAP_P4 : sprintf(str_report + strlen(str_report),"%.3f,%.3f,%.3f,%.3f", print_position[X_AXIS], print_position[Y_AXIS], print_position[U_AXIS], print_position[V_AXIS]);
   	  	  		  	break;
+  	  #endif
   }
 
 
@@ -465,10 +569,14 @@ void report_realtime_status()
   // Returns planner and serial read buffer states.
   #ifdef REPORT_FIELD_BUFFER_STATE
     if (bit_istrue(settings.status_report_mask,BITFLAG_RT_STATUS_BUFFER_STATE)) {
-    	sprintf(str_report + strlen(str_report),"|Bf:%d,%d", (int)plan_get_block_buffer_available(), (int)serial_get_rx_buffer_available());
+    	sprintf(str_report + strlen(str_report),"|Bf:%u,%u", (unsigned int)plan_get_block_buffer_available(), (unsigned int)serial_get_rx_stream_available());
     }
   #endif
 
+  #ifdef REPORT_FIELD_SEGMENT_UNDERRUNS
+    sprintf(str_report + strlen(str_report),"|Un:%lu", (unsigned long)st_get_underrun_count());
+  #endif
+
   #ifdef USE_LINE_NUMBERS
     #ifdef REPORT_FIELD_LINE_NUMBERS
       // Report current line number
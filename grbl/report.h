@@ -60,6 +60,9 @@
 #define STATUS_GCODE_G43_DYNAMIC_AXIS_ERROR 37
 #define STATUS_GCODE_MAX_VALUE_EXCEEDED 38
 
+#define STATUS_JOB_INVALID 60 // No valid stored job, job state or checksum mismatch
+#define STATUS_JOB_FULL 61
+
 // Define Grbl alarm codes. Valid values (1-255). 0 is reserved.
 #define ALARM_HARD_LIMIT_ERROR      EXEC_ALARM_HARD_LIMIT
 #define ALARM_SOFT_LIMIT_ERROR      EXEC_ALARM_SOFT_LIMIT
@@ -83,6 +86,7 @@
 #define MESSAGE_RESTORE_DEFAULTS 9
 #define MESSAGE_SPINDLE_RESTORE 10
 #define MESSAGE_SLEEP_MODE 11
+#define MESSAGE_JOB_END 12
 
 // Prints system status messages.
 void report_status_message(uint8_t status_code);
@@ -127,8 +131,25 @@ void report_build_info(char *line);
 // Prints parameters value
 void report_parameter(unsigned int id, float param, int valuetype);
 
+#ifdef JOB_STORAGE
+  // Prints the stored job state, size and CRC32 ('$F')
+  void report_job_info(uint8_t state, uint32_t size, uint32_t crc);
+#endif
+
+#ifdef BINARY_PROTOCOL
+  // Acknowledges binary packets up to seq, or reports the error of packet seq
+  void report_packet_status(uint8_t seq, uint8_t status_code);
+  // Requests the binary packets to be resent from seq
+  void report_packet_nak(uint8_t seq);
+#endif
+
 #ifdef DEBUG
   void report_realtime_debug();
 #endif
 
+#ifdef ENABLE_CYCLE_PROFILING
+  // Prints execution time statistics of the realtime code paths ('$T')
+  void report_profile();
+#endif
+
 #endif
@@ -20,13 +20,22 @@
 */
 
 #include "grbl.h"
+#include "usbd_cdc_if.h"
 
 #define RX_RING_BUFFER (RX_BUFFER_SIZE+1)
 #define TX_RING_BUFFER (TX_BUFFER_SIZE+1)
 
-uint8_t serial_rx_buffer[RX_RING_BUFFER];
-uint8_t serial_rx_buffer_head = 0;
-volatile uint8_t serial_rx_buffer_tail = 0;
+// Written by the USB receive interrupt (head) and read by the protocol loop (tail).
+static uint8_t serial_rx_buffer[RX_RING_BUFFER];
+static volatile uint16_t serial_rx_buffer_head = 0;
+static volatile uint16_t serial_rx_buffer_tail = 0;
+static uint16_t serial_rx_line_count = 0; // Bytes read for the line in progress. Main program only.
+#ifdef BINARY_PROTOCOL
+  // Bytes of the binary packet in progress still to be queued untouched. USB receive interrupt only.
+  #define SERIAL_PACKET_LENGTH_NEXT 0xFFFF
+  static volatile uint16_t serial_rx_packet_count = 0;
+  static uint32_t serial_rx_packet_tick; // Time of the last packet byte received
+#endif
 
 uint8_t serial_tx_buffer[TX_RING_BUFFER];
 uint8_t serial_tx_buffer_head = 0;
@@ -34,21 +43,34 @@ volatile uint8_t serial_tx_buffer_tail = 0;
 
 
 // Returns the number of bytes available in the RX serial buffer.
-uint8_t serial_get_rx_buffer_available()
+uint16_t serial_get_rx_buffer_available()
 {
-  uint8_t rtail = serial_rx_buffer_tail; // Copy to limit multiple calls to volatile
-  if (serial_rx_buffer_head >= rtail) { return(RX_BUFFER_SIZE - (serial_rx_buffer_head-rtail)); }
-  return((rtail-serial_rx_buffer_head-1));
+  uint16_t rhead = serial_rx_buffer_head; // Copy to limit multiple calls to volatile
+  uint16_t rtail = serial_rx_buffer_tail;
+  if (rhead >= rtail) { return(RX_BUFFER_SIZE - (rhead-rtail)); }
+  return((rtail-rhead-1));
+}
+
+
+// Returns the number of bytes a character-counting host may still send. Same as the free space in
+// the RX serial buffer, less the bytes of the line in progress. The host counts those as buffered
+// until their 'ok' or 'error' response, and both add up to RX_BUFFER_SIZE.
+uint16_t serial_get_rx_stream_available()
+{
+  uint16_t available = serial_get_rx_buffer_available();
+  if (available <= serial_rx_line_count) { return(0); }
+  return(available - serial_rx_line_count);
 }
 
 
 // Returns the number of bytes used in the RX serial buffer.
 // NOTE: Deprecated. Not used unless classic status reports are enabled in config.h.
-uint8_t serial_get_rx_buffer_count()
+uint16_t serial_get_rx_buffer_count()
 {
-  uint8_t rtail = serial_rx_buffer_tail; // Copy to limit multiple calls to volatile
-  if (serial_rx_buffer_head >= rtail) { return(serial_rx_buffer_head-rtail); }
-  return (RX_BUFFER_SIZE - (rtail-serial_rx_buffer_head));
+  uint16_t rhead = serial_rx_buffer_head; // Copy to limit multiple calls to volatile
+  uint16_t rtail = serial_rx_buffer_tail;
+  if (rhead >= rtail) { return(rhead-rtail); }
+  return (RX_RING_BUFFER - (rtail-rhead));
 }
 
 
@@ -77,18 +99,137 @@ void serial_write(uint8_t data) {
 // Fetches the first byte in the serial read buffer. Called by main program.
 uint8_t serial_read()
 {
-	uint8_t data;
-
-	if (serial_rx_buffer_head == serial_rx_buffer_tail) {
-	    return SERIAL_NO_DATA;
-	  } else {
-	  data = serial_rx_buffer[serial_rx_buffer_tail++];
-	  }
-	return data;
+  uint16_t tail = serial_rx_buffer_tail; // Temporary serial_rx_buffer_tail (to optimize for volatile)
+  if (serial_rx_buffer_head == tail) {
+    return SERIAL_NO_DATA;
+  } else {
+    uint8_t data = serial_rx_buffer[tail];
+
+    tail++;
+    if (tail == RX_RING_BUFFER) { tail = 0; }
+    serial_rx_buffer_tail = tail;
+    serial_rx_line_count++;
+
+    CDC_resume_receive(); // Let the host send again, if it was held off by a full buffer.
+    return data;
+  }
+}
+
+
+// Queues one byte, unless the buffer is full. Returns the new head.
+static inline uint16_t serial_rx_queue(uint16_t head, uint8_t data)
+{
+  uint16_t next_head = head + 1;
+  if (next_head == RX_RING_BUFFER) { next_head = 0; }
+  if (next_head == serial_rx_buffer_tail) { return(head); }
+  serial_rx_buffer[head] = data;
+  return(next_head);
+}
+
+
+// Queues one USB OUT packet. Called by the USB receive interrupt. Realtime command characters are
+// picked off from anywhere in the packet and set the system state flag bits for realtime execution.
+// They never reach the buffer. All other bytes are queued for the protocol loop. Binary packets are
+// queued untouched, so realtime commands in a packet take effect after it. A packet left incomplete
+// for PACKET_TIMEOUT ms is abandoned, so a reset from the host is picked off again.
+// NOTE: The USB endpoint is only re-armed while a full packet fits, so the buffer cannot overflow
+// unless its size is changed below one packet. Bytes that do not fit are dropped. While the buffer is
+// full, the endpoint NAKs every packet, so a reset, feed hold or cycle start sent then only arrives
+// once the protocol loop has read a packet's worth. Hosts must count characters against Bf: and keep
+// the buffer from filling up. See RX_BUFFER_SIZE in config.h.
+void serial_receive(uint8_t *data, uint32_t len)
+{
+  uint16_t head = serial_rx_buffer_head; // Temporary serial_rx_buffer_head (to optimize for volatile)
+  uint8_t c;
+
+  #ifdef BINARY_PROTOCOL
+    if (serial_rx_packet_count && ((HAL_GetTick()-serial_rx_packet_tick) > PACKET_TIMEOUT)) {
+      serial_rx_packet_count = 0;
+    }
+  #endif
+  while (len--) {
+    c = *data++;
+    #ifdef BINARY_PROTOCOL
+      if (serial_rx_packet_count) {
+        // The length byte gives the sequence, type and payload bytes, followed by the CRC16.
+        if (serial_rx_packet_count == SERIAL_PACKET_LENGTH_NEXT) { serial_rx_packet_count = c+2; }
+        else { serial_rx_packet_count--; }
+        head = serial_rx_queue(head, c);
+        continue;
+      }
+      if (c == PACKET_START) {
+        serial_rx_packet_count = SERIAL_PACKET_LENGTH_NEXT;
+        head = serial_rx_queue(head, c);
+        continue;
+      }
+    #endif
+    switch (c) {
+      case CMD_RESET:         mc_reset(); break; // Call motion control reset routine.
+      case CMD_STATUS_REPORT: system_set_exec_state_flag(EXEC_STATUS_REPORT); break; // Set as true
+      case CMD_CYCLE_START:   system_set_exec_state_flag(EXEC_CYCLE_START); break; // Set as true
+      case CMD_FEED_HOLD:     system_set_exec_state_flag(EXEC_FEED_HOLD); break; // Set as true
+      default :
+        if (c > 0x7F) { // Real-time control characters are extended ACSII only.
+          switch(c) {
+            case CMD_SAFETY_DOOR:   system_set_exec_state_flag(EXEC_SAFETY_DOOR); break; // Set as true
+            case CMD_JOG_CANCEL:
+              if (sys.state & STATE_JOG) { // Block all other states from invoking motion cancel.
+                system_set_exec_state_flag(EXEC_MOTION_CANCEL);
+              }
+              break;
+            #ifdef DEBUG
+              case CMD_DEBUG_REPORT: bit_true(sys_rt_exec_debug,EXEC_DEBUG_REPORT); break;
+            #endif
+            case CMD_FEED_OVR_RESET           : system_set_exec_motion_override_flag(EXEC_FEED_OVR_RESET); break;
+            case CMD_FEED_OVR_COARSE_PLUS     : system_set_exec_motion_override_flag(EXEC_FEED_OVR_COARSE_PLUS); break;
+            case CMD_FEED_OVR_COARSE_MINUS    : system_set_exec_motion_override_flag(EXEC_FEED_OVR_COARSE_MINUS); break;
+            case CMD_FEED_OVR_FINE_PLUS       : system_set_exec_motion_override_flag(EXEC_FEED_OVR_FINE_PLUS); break;
+            case CMD_FEED_OVR_FINE_MINUS      : system_set_exec_motion_override_flag(EXEC_FEED_OVR_FINE_MINUS); break;
+            case CMD_RAPID_OVR_RESET          : system_set_exec_motion_override_flag(EXEC_RAPID_OVR_RESET); break;
+            case CMD_RAPID_OVR_MEDIUM         : system_set_exec_motion_override_flag(EXEC_RAPID_OVR_MEDIUM); break;
+            case CMD_RAPID_OVR_LOW            : system_set_exec_motion_override_flag(EXEC_RAPID_OVR_LOW); break;
+            case CMD_SPINDLE_OVR_RESET        : system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_RESET); break;
+            case CMD_SPINDLE_OVR_COARSE_PLUS  : system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_COARSE_PLUS); break;
+            case CMD_SPINDLE_OVR_COARSE_MINUS : system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_COARSE_MINUS); break;
+            case CMD_SPINDLE_OVR_FINE_PLUS    : system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_FINE_PLUS); break;
+            case CMD_SPINDLE_OVR_FINE_MINUS   : system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_FINE_MINUS); break;
+            case CMD_SPINDLE_OVR_STOP         : system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_STOP); break;
+            case CMD_COOLANT_FLOOD_OVR_TOGGLE : system_set_exec_accessory_override_flag(EXEC_COOLANT_FLOOD_OVR_TOGGLE); break;
+            #ifdef ENABLE_M7
+              case CMD_COOLANT_MIST_OVR_TOGGLE: system_set_exec_accessory_override_flag(EXEC_COOLANT_MIST_OVR_TOGGLE); break;
+            #endif
+          }
+          // Throw away any unfound extended-ASCII character by not passing it to the serial buffer.
+        } else { // Write character to buffer
+          head = serial_rx_queue(head, c);
+        }
+    }
+  }
+  serial_rx_buffer_head = head;
+  #ifdef BINARY_PROTOCOL
+    if (serial_rx_packet_count) { serial_rx_packet_tick = HAL_GetTick(); }
+  #endif
+}
+
+
+// Releases the bytes of the line in progress from the character count, once its response is sent.
+void serial_acknowledge_line()
+{
+  serial_rx_line_count = 0;
 }
 
 
 void serial_reset_read_buffer()
 {
   serial_rx_buffer_tail = serial_rx_buffer_head;
+  serial_rx_line_count = 0;
+  CDC_resume_receive();
 }
+
+
+#ifdef BINARY_PROTOCOL
+  void serial_reset_packet()
+  {
+    serial_rx_packet_count = 0;
+  }
+#endif
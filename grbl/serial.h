@@ -24,7 +24,7 @@
 
 
 #ifndef RX_BUFFER_SIZE
-  #define RX_BUFFER_SIZE 255
+  #define RX_BUFFER_SIZE 4095 // Fills the ring buffer to 4KB. Must hold at least one USB packet.
 #endif
 #ifndef TX_BUFFER_SIZE
   #ifdef USE_LINE_NUMBERS
@@ -45,15 +45,30 @@ void serial_write(uint8_t data);
 // Fetches the first byte in the serial read buffer. Called by main program.
 uint8_t serial_read();
 
+// Queues a received USB packet, picking off the realtime commands. Called by the USB interrupt.
+void serial_receive(uint8_t *data, uint32_t len);
+
 // Reset and empty data in read buffer. Used by e-stop and reset.
 void serial_reset_read_buffer();
 
+#ifdef BINARY_PROTOCOL
+  // Stops queueing the binary packet in progress untouched. Used by reset.
+  void serial_reset_packet();
+#endif
+
 // Returns the number of bytes available in the RX serial buffer.
-uint8_t serial_get_rx_buffer_available();
+uint16_t serial_get_rx_buffer_available();
+
+// Returns the number of bytes a character-counting host may still send, i.e. the free space in the
+// RX serial buffer less the bytes of the line in progress. Reported as the Bf: field.
+uint16_t serial_get_rx_stream_available();
+
+// Releases the bytes read for the line in progress once its 'ok' or 'error' response is sent.
+void serial_acknowledge_line();
 
 // Returns the number of bytes used in the RX serial buffer.
 // NOTE: Deprecated. Not used unless classic status reports are enabled in config.h.
-uint8_t serial_get_rx_buffer_count();
+uint16_t serial_get_rx_buffer_count();
 
 // Returns the number of bytes used in the TX serial buffer.
 // NOTE: Not used except for debugging and ensuring no TX bottlenecks.
@@ -22,6 +22,7 @@
 #include "grbl.h"
 
 settings_t settings;
+extern setup _setup;
 
 // Method to store startup lines into EEPROM
 void settings_store_startup_line(uint8_t n, char *line)
@@ -42,21 +43,55 @@ void settings_store_build_info(char *line)
   memcpy_to_eeprom_with_checksum(EEPROM_ADDR_BUILD_INFO,(char*)line, LINE_BUFFER_SIZE);
 }
 
+// Global settings image in EEPROM: the version byte and the settings struct, followed by their CRC32.
+#define SETTINGS_IMAGE_SIZE (1+sizeof(settings_t))
+
 // Method to store Grbl global settings struct and version number into EEPROM
 // NOTE: This function can only be called in IDLE state.
 void write_global_settings()
 {
-	uint8_t *buf;
-
-	if ((buf = malloc(sizeof(settings_t)+1)) != NULL) {
-		*buf++ = SETTINGS_VERSION;
-		buf = memcpy(buf, (char*)&settings, sizeof(settings_t));
-		memcpy_to_eeprom_with_checksum(EEPROM_ADDR_VERSION, (char*)--buf, sizeof(settings_t)+1);
-		free(buf);
-	}
+  uint8_t image[SETTINGS_IMAGE_SIZE+EEPROM_CRC_SIZE];
+  uint32_t crc;
+
+  image[0] = SETTINGS_VERSION;
+  memcpy(&image[1], &settings, sizeof(settings_t));
+  crc = kv_crc32(image, SETTINGS_IMAGE_SIZE);
+  memcpy(&image[SETTINGS_IMAGE_SIZE], &crc, EEPROM_CRC_SIZE);
+  eeprom_put_block(EEPROM_ADDR_VERSION, image, sizeof(image));
 }
 
 
+// Per-axis defaults, in axis order. Only the axes up to N_AXIS need defaults.h values.
+typedef struct {
+  float steps_per_mm;
+  float max_rate;
+  float acceleration;
+  float max_travel;
+  float jerk;
+} axis_defaults_t;
+
+#define AXIS_DEFAULTS(axis) { DEFAULT_##axis##_STEPS_PER_MM, DEFAULT_##axis##_MAX_RATE, \
+    DEFAULT_##axis##_ACCELERATION, DEFAULT_##axis##_MAX_TRAVEL, DEFAULT_##axis##_JERK }
+
+static const axis_defaults_t axis_defaults[N_AXIS] = {
+  AXIS_DEFAULTS(X), AXIS_DEFAULTS(Y), AXIS_DEFAULTS(Z),
+  #if N_AXIS > 3
+    AXIS_DEFAULTS(A),
+  #endif
+  #if N_AXIS > 4
+    AXIS_DEFAULTS(B),
+  #endif
+  #if N_AXIS > 5
+    AXIS_DEFAULTS(C),
+  #endif
+  #if N_AXIS > 6
+    AXIS_DEFAULTS(U),
+  #endif
+  #if N_AXIS > 7
+    AXIS_DEFAULTS(V),
+  #endif
+};
+
 // Method to restore EEPROM-saved Grbl global settings back to defaults.
 void settings_restore(uint8_t restore_flag) {
 	char data = 0;
@@ -79,6 +114,8 @@ void settings_restore(uint8_t restore_flag) {
 	      settings.homing_debounce_delay = (uint16_t)DEFAULT_HOMING_DEBOUNCE_DELAY;
 	      settings.homing_pulloff = DEFAULT_HOMING_PULLOFF;
 
+	      settings.planner_blocks = DEFAULT_PLANNER_BLOCKS;
+
 	      settings.flags = 0;
 	      if (DEFAULT_REPORT_INCHES) { settings.flags |= (uint8_t)BITFLAG_REPORT_INCHES; }
 	      if (DEFAULT_LASER_MODE) { settings.flags |= (uint8_t)BITFLAG_LASER_MODE; }
@@ -89,42 +126,14 @@ void settings_restore(uint8_t restore_flag) {
 	      if (DEFAULT_INVERT_LIMIT_PINS) { settings.flags |= (uint8_t)BITFLAG_INVERT_LIMIT_PINS; }
 	      if (DEFAULT_INVERT_PROBE_PIN) { settings.flags |= (uint8_t)BITFLAG_INVERT_PROBE_PIN; }
 
-	      settings.steps_per_mm[X_AXIS] = DEFAULT_X_STEPS_PER_MM;
-	      settings.steps_per_mm[Y_AXIS] = DEFAULT_Y_STEPS_PER_MM;
-	      settings.steps_per_mm[Z_AXIS] = DEFAULT_Z_STEPS_PER_MM;
-	      settings.steps_per_mm[A_AXIS] = DEFAULT_A_STEPS_PER_MM;
-	      settings.steps_per_mm[B_AXIS] = DEFAULT_B_STEPS_PER_MM;
-	      settings.steps_per_mm[C_AXIS] = DEFAULT_C_STEPS_PER_MM;
-	      settings.steps_per_mm[U_AXIS] = DEFAULT_U_STEPS_PER_MM;
-	      settings.steps_per_mm[V_AXIS] = DEFAULT_V_STEPS_PER_MM;
-
-	      settings.max_rate[X_AXIS] = DEFAULT_X_MAX_RATE;
-	      settings.max_rate[Y_AXIS] = DEFAULT_Y_MAX_RATE;
-	      settings.max_rate[Z_AXIS] = DEFAULT_Z_MAX_RATE;
-	      settings.max_rate[A_AXIS] = DEFAULT_A_MAX_RATE;
-	      settings.max_rate[B_AXIS] = DEFAULT_B_MAX_RATE;
-	      settings.max_rate[C_AXIS] = DEFAULT_C_MAX_RATE;
-	      settings.max_rate[U_AXIS] = DEFAULT_U_MAX_RATE;
-	      settings.max_rate[V_AXIS] = DEFAULT_V_MAX_RATE;
-
-
-	      settings.acceleration[X_AXIS] = DEFAULT_X_ACCELERATION;
-	      settings.acceleration[Y_AXIS] = DEFAULT_Y_ACCELERATION;
-	      settings.acceleration[Z_AXIS] = DEFAULT_Z_ACCELERATION;
-	      settings.acceleration[A_AXIS] = DEFAULT_A_ACCELERATION;
-	      settings.acceleration[B_AXIS] = DEFAULT_B_ACCELERATION;
-	      settings.acceleration[C_AXIS] = DEFAULT_C_ACCELERATION;
-	      settings.acceleration[U_AXIS] = DEFAULT_U_ACCELERATION;
-	      settings.acceleration[V_AXIS] = DEFAULT_V_ACCELERATION;
-
-	      settings.max_travel[X_AXIS] = (-DEFAULT_X_MAX_TRAVEL);
-	      settings.max_travel[Y_AXIS] = (-DEFAULT_Y_MAX_TRAVEL);
-	      settings.max_travel[Z_AXIS] = (-DEFAULT_Z_MAX_TRAVEL);
-	      settings.max_travel[A_AXIS] = (-DEFAULT_A_MAX_TRAVEL);
-	      settings.max_travel[B_AXIS] = (-DEFAULT_B_MAX_TRAVEL);
-	      settings.max_travel[C_AXIS] = (-DEFAULT_C_MAX_TRAVEL);
-	      settings.max_travel[U_AXIS] = (-DEFAULT_U_MAX_TRAVEL);
-	      settings.max_travel[V_AXIS] = (-DEFAULT_V_MAX_TRAVEL);
+	      uint8_t idx;
+	      for (idx=0; idx<N_AXIS; idx++) {
+	        settings.steps_per_mm[idx] = axis_defaults[idx].steps_per_mm;
+	        settings.max_rate[idx] = axis_defaults[idx].max_rate;
+	        settings.acceleration[idx] = axis_defaults[idx].acceleration;
+	        settings.max_travel[idx] = (-axis_defaults[idx].max_travel);
+	        settings.jerk[idx] = axis_defaults[idx].jerk;
+	      }
     write_global_settings();
   }
 
@@ -133,6 +142,11 @@ void settings_restore(uint8_t restore_flag) {
     float coord_data[N_AXIS];
     memset(&coord_data, 0, sizeof(coord_data));
     for (idx=0; idx <= SETTING_INDEX_NCOORD; idx++) { settings_write_coord_data(idx, coord_data); }
+    int n;
+    for (n=PERSISTENT_PARAMETER_FIRST; n<PERSISTENT_PARAMETER_FIRST+N_PERSISTENT_PARAMETER; n++) {
+      _setup.parameters[n] = 0.0f;
+      settings_write_parameter(n, 0.0f);
+    }
   }
 
   if (restore_flag & SETTINGS_RESTORE_STARTUP_LINES) {
@@ -154,7 +168,9 @@ void settings_restore(uint8_t restore_flag) {
 uint8_t settings_read_startup_line(uint8_t n, char *line)
 {
   uint32_t addr = n*(LINE_BUFFER_SIZE+1)+EEPROM_ADDR_STARTUP_BLOCK;
-  if (!(memcpy_from_eeprom_with_checksum((char*)line, addr, LINE_BUFFER_SIZE))) {
+  // Erased flash passes the checksum, but holds no terminated line.
+  if (!(memcpy_from_eeprom_with_checksum((char*)line, addr, LINE_BUFFER_SIZE)) ||
+      !memchr(line, 0, LINE_BUFFER_SIZE)) {
     // Reset line with default value
     line[0] = 0; // Empty line
     settings_store_startup_line(n, line);
@@ -167,7 +183,9 @@ uint8_t settings_read_startup_line(uint8_t n, char *line)
 // Reads startup line from EEPROM. Updated pointed line string data.
 uint8_t settings_read_build_info(char *line)
 {
-  if (!(memcpy_from_eeprom_with_checksum((char*)line, EEPROM_ADDR_BUILD_INFO, LINE_BUFFER_SIZE))) {
+  // Erased flash passes the checksum, but holds no terminated line.
+  if (!(memcpy_from_eeprom_with_checksum((char*)line, EEPROM_ADDR_BUILD_INFO, LINE_BUFFER_SIZE)) ||
+      !memchr(line, 0, LINE_BUFFER_SIZE)) {
     // Reset line with default value
     line[0] = 0; // Empty line
     settings_store_build_info(line);
@@ -202,22 +220,111 @@ uint8_t settings_read_coord_data(uint8_t coord_select, float *coord_data)
 }
 
 
-// Reads Grbl global settings struct from EEPROM.
-uint8_t read_global_settings() {
-  // Check version-byte of eeprom
-  Eeprom_Read_Page(EEPROM_PAGE0);
-  uint8_t version = eeprom_get_char(0);
-  if (version == SETTINGS_VERSION) {
-    // Read settings-record and check checksum
-    if (!(memcpy_from_eeprom_with_checksum((char*)&settings, EEPROM_ADDR_GLOBAL, sizeof(settings_t)))) {
-      return(false);
-    }
-  } else {
+// Method to store a persistent # parameter into EEPROM. Only changed bytes dirty the flash store.
+void settings_write_parameter(int n, float value)
+{
+  if ((n < PERSISTENT_PARAMETER_FIRST) || (n >= PERSISTENT_PARAMETER_FIRST+N_PERSISTENT_PARAMETER)) { return; }
+  uint32_t addr = (n-PERSISTENT_PARAMETER_FIRST)*sizeof(float) + EEPROM_ADDR_USER_PARAMETERS;
+  eeprom_put_block(addr, &value, sizeof(float));
+}
+
+
+// Reads the persistent # parameters from EEPROM into the parameter table.
+void settings_read_parameters(float *parameters)
+{
+  eeprom_get_block(EEPROM_ADDR_USER_PARAMETERS, &parameters[PERSISTENT_PARAMETER_FIRST], N_PERSISTENT_PARAMETER*sizeof(float));
+}
+
+
+// Global settings of version 10, the Grbl 1.1h layout. Always built for 8 axes, without jerk or the
+// planner block setting, and behind a checksum byte instead of the CRC32.
+#define SETTINGS_LEGACY_AXES 8
+typedef struct {
+  float steps_per_mm[SETTINGS_LEGACY_AXES];
+  float max_rate[SETTINGS_LEGACY_AXES];
+  float acceleration[SETTINGS_LEGACY_AXES];
+  float max_travel[SETTINGS_LEGACY_AXES];
+
+  // Same as in settings_t, from pulse_microseconds to homing_pulloff.
+  uint8_t pulse_microseconds;
+  uint8_t step_invert_mask;
+  uint8_t dir_invert_mask;
+  uint8_t stepper_idle_lock_time;
+  uint8_t status_report_mask;
+  float junction_deviation;
+  float arc_tolerance;
+  float rpm_max;
+  float rpm_min;
+  uint8_t flags;
+  uint8_t homing_dir_mask;
+  float homing_feed_rate;
+  float homing_seek_rate;
+  uint16_t homing_debounce_delay;
+  float homing_pulloff;
+} settings_legacy_t;
+
+// Keeps version 10 settings, with jerk and the planner depth at their defaults, and stores them
+// again as a current image. The coordinate data, startup lines and build info are rewritten with the
+// current checksum, which is the only one accepted from then on.
+static uint8_t settings_migrate_legacy()
+{
+  settings_legacy_t legacy;
+  float coord_data[SETTINGS_LEGACY_AXES];
+  char line[LINE_BUFFER_SIZE];
+  uint32_t addr;
+  uint8_t idx;
+
+  if (!(memcpy_from_eeprom_with_legacy_checksum((char*)&legacy, EEPROM_ADDR_GLOBAL, sizeof(settings_legacy_t)))) {
     return(false);
   }
+  for (idx=0; idx<N_AXIS; idx++) {
+    settings.steps_per_mm[idx] = legacy.steps_per_mm[idx];
+    settings.max_rate[idx] = legacy.max_rate[idx];
+    settings.acceleration[idx] = legacy.acceleration[idx];
+    settings.max_travel[idx] = legacy.max_travel[idx];
+    settings.jerk[idx] = axis_defaults[idx].jerk;
+  }
+  memcpy(&settings.pulse_microseconds, &legacy.pulse_microseconds,
+         sizeof(settings_legacy_t)-offsetof(settings_legacy_t, pulse_microseconds));
+  settings.planner_blocks = DEFAULT_PLANNER_BLOCKS;
+  write_global_settings();
+
+  // Coordinate data moves to the current layout, in order, so no record is overwritten before it is
+  // read. A record failing its checksum is reset to zero, as settings_read_coord_data() would.
+  for (idx=0; idx<SETTING_INDEX_NCOORD; idx++) {
+    addr = idx*(sizeof(coord_data)+EEPROM_CHECKSUM_SIZE) + EEPROM_ADDR_PARAMETERS;
+    if (!(memcpy_from_eeprom_with_legacy_checksum((char*)coord_data, addr, sizeof(coord_data)))) {
+      memset(coord_data, 0, sizeof(coord_data));
+    }
+    addr = idx*(sizeof(float)*N_AXIS+EEPROM_CHECKSUM_SIZE) + EEPROM_ADDR_PARAMETERS;
+    memcpy_to_eeprom_with_checksum(addr, (char*)coord_data, sizeof(float)*N_AXIS);
+  }
+  // Lines failing their checksum are left to be reset when read.
+  for (idx=0; idx<=N_STARTUP_LINE; idx++) {
+    addr = (idx < N_STARTUP_LINE) ? idx*(LINE_BUFFER_SIZE+1)+EEPROM_ADDR_STARTUP_BLOCK : EEPROM_ADDR_BUILD_INFO;
+    if (memcpy_from_eeprom_with_legacy_checksum(line, addr, LINE_BUFFER_SIZE)) {
+      memcpy_to_eeprom_with_checksum(addr, line, LINE_BUFFER_SIZE);
+    }
+  }
   return(true);
 }
 
+// Reads Grbl global settings struct from EEPROM. The whole image is copied and checked at once, and
+// the settings are only updated if both the version and the CRC32 match.
+uint8_t read_global_settings() {
+  uint8_t image[SETTINGS_IMAGE_SIZE+EEPROM_CRC_SIZE];
+  uint32_t crc;
+
+  eeprom_get_block(EEPROM_ADDR_VERSION, image, sizeof(image));
+  memcpy(&crc, &image[SETTINGS_IMAGE_SIZE], EEPROM_CRC_SIZE);
+  if ((image[0] == SETTINGS_VERSION) && (crc == kv_crc32(image, SETTINGS_IMAGE_SIZE))) {
+    memcpy(&settings, &image[1], sizeof(settings_t));
+    return(true);
+  }
+  if (image[0] == SETTINGS_VERSION_LEGACY) { return(settings_migrate_legacy()); }
+  return(false);
+}
+
 
 // A helper method to set settings from command line
 uint8_t settings_store_global_setting(uint8_t parameter, float value) {
@@ -245,6 +352,7 @@ uint8_t settings_store_global_setting(uint8_t parameter, float value) {
             break;
           case 2: settings.acceleration[parameter] = value*60*60; break; // Convert to mm/min^2 for grbl internal use.
           case 3: settings.max_travel[parameter] = -value; break;  // Store as negative for grbl internal use.
+          case 4: settings.jerk[parameter] = value*60*60*60; break; // Convert to mm/min^3 for grbl internal use.
         }
         break; // Exit while-loop after setting has been configured and proceed to the EEPROM write call.
       } else {
@@ -324,6 +432,11 @@ uint8_t settings_store_global_setting(uint8_t parameter, float value) {
           return(STATUS_SETTING_DISABLED_LASER);
         #endif
         break;
+      case 33: // Takes effect as the buffer drains below the new depth.
+        if (value < 1.0f) { return(STATUS_INVALID_STATEMENT); }
+        if (value > (BLOCK_BUFFER_SIZE-1)) { return(STATUS_GCODE_MAX_VALUE_EXCEEDED); }
+        settings.planner_blocks = trunc(value);
+        break;
       default:
         return(STATUS_INVALID_STATEMENT);
     }
@@ -335,11 +448,13 @@ uint8_t settings_store_global_setting(uint8_t parameter, float value) {
 
 // Initialize the config subsystem
 void settings_init() {
+  eeprom_init(); // Load the RAM shadow of all persistent data. Only flash access until write-back.
   if(!read_global_settings()) {
     report_status_message(STATUS_SETTING_READ_FAIL);
     settings_restore(SETTINGS_RESTORE_DEFAULTS); // Force restore all EEPROM data.
     report_grbl_settings();
   }
+  settings_read_parameters(_setup.parameters);
 }
 
 
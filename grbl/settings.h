@@ -27,7 +27,8 @@
 
 // Version of the EEPROM data. Will be used to migrate existing data from older versions of Grbl
 // when firmware is upgraded. Always stored in byte 0 of eeprom
-#define SETTINGS_VERSION 10  // NOTE: Check settings_reset() when moving to next version.
+#define SETTINGS_VERSION 11  // NOTE: Check settings_reset() when moving to next version.
+#define SETTINGS_VERSION_LEGACY 10 // Grbl 1.1h layout, migrated by read_global_settings()
 
 // Define bit flag masks for the boolean settings in settings.flag.
 #define BIT_REPORT_INCHES      0
@@ -61,6 +62,11 @@
   #define SETTINGS_RESTORE_ALL 0xFF // All bitflags
 #endif
 
+// Planner blocks in use after a settings restore. '$33' changes it up to BLOCK_BUFFER_SIZE-1.
+#ifndef DEFAULT_PLANNER_BLOCKS
+  #define DEFAULT_PLANNER_BLOCKS (BLOCK_BUFFER_SIZE-1)
+#endif
+
 // Define EEPROM memory address location values for Grbl settings and parameters
 // NOTE: The AT24DB041 has 524KB EEPROM.
 #define EEPROM_ADDR_VERSION        0U
@@ -68,7 +74,14 @@
 #define EEPROM_ADDR_PARAMETERS     512U
 #define EEPROM_ADDR_STARTUP_BLOCK  1024U
 #define EEPROM_ADDR_BUILD_INFO     2048U
+#define EEPROM_ADDR_USER_PARAMETERS 2304U
 #define EEPROM_CHECKSUM_SIZE       1
+#define EEPROM_CRC_SIZE            4
+
+// Persistent # parameters, retained across power cycles like the common variables #500-#999 of
+// other controls. Stored as floats from EEPROM_ADDR_USER_PARAMETERS, without a checksum.
+#define PERSISTENT_PARAMETER_FIRST 500
+#define N_PERSISTENT_PARAMETER     500
 
 // Define EEPROM address indexing for coordinate parameters
 #define N_COORDINATE_SYSTEM 6  // Number of supported work coordinate systems (from index 1)
@@ -79,7 +92,7 @@
 // #define SETTING_INDEX_G92    N_COORDINATE_SYSTEM+2  // Coordinate offset (G92.2,G92.3 not supported)
 
 // Define Grbl axis settings numbering scheme. Starts at START_VAL, every INCREMENT, over N_SETTINGS.
-#define AXIS_N_SETTINGS          4
+#define AXIS_N_SETTINGS          5
 #define AXIS_SETTINGS_START_VAL  100 // NOTE: Reserving settings values >= 100 for axis settings. Up to 255.
 #define AXIS_SETTINGS_INCREMENT  10  // Must be greater than the number of axis settings
 
@@ -90,6 +103,7 @@ typedef struct {
   float max_rate[N_AXIS];
   float acceleration[N_AXIS];
   float max_travel[N_AXIS];
+  float jerk[N_AXIS];          // Used by JERK_LIMITED_PROFILES. Stored in mm/min^3.
 
   // Remaining Grbl settings
   uint8_t pulse_microseconds;
@@ -110,6 +124,8 @@ typedef struct {
   float homing_seek_rate;
   uint16_t homing_debounce_delay;
   float homing_pulloff;
+
+  uint16_t planner_blocks; // Planner block buffer depth in use, up to BLOCK_BUFFER_SIZE-1.
 } settings_t;
 extern settings_t settings;
 
@@ -140,6 +156,12 @@ void settings_write_coord_data(uint8_t coord_select, float *coord_data);
 // Reads selected coordinate data from EEPROM
 uint8_t settings_read_coord_data(uint8_t coord_select, float *coord_data);
 
+// Writes a # parameter to EEPROM if it is in the persistent range
+void settings_write_parameter(int n, float value);
+
+// Reads all persistent # parameters from EEPROM into the parameter table
+void settings_read_parameters(float *parameters);
+
 // Returns the step pin mask according to Grbl's internal axis numbering
 uint16_t get_step_pin_mask(uint8_t i);
 
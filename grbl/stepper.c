@@ -21,6 +21,10 @@
 
 #include "grbl.h"
 #include "gpio.h"
+#include "tim.h"
+#ifdef SEGMENT_PREP_TASK
+  #include "cmsis_os.h"
+#endif
 
 extern TIM_HandleTypeDef htim3;
 
@@ -68,7 +72,8 @@ extern TIM_HandleTypeDef htim3;
 typedef struct {
   uint32_t steps[N_AXIS];
   uint32_t step_event_count;
-  uint8_t direction_bits;
+  uint16_t direction_bits;
+  uint8_t axis_mask;             // Axes with steps in this block. The others are not traced.
   #ifdef ENABLE_DUAL_AXIS
     uint8_t direction_bits_dual;
   #endif
@@ -76,7 +81,7 @@ typedef struct {
     uint8_t is_pwm_rate_adjusted; // Tracks motions that require constant laser power/rate
   #endif
 } st_block_t;
-static st_block_t st_block_buffer[SEGMENT_BUFFER_SIZE-1];
+static DTCM_DATA st_block_t st_block_buffer[SEGMENT_BUFFER_SIZE-1];
 
 // Primary stepper segment ring buffer. Contains small, short line segments for the stepper
 // algorithm to execute, which are "checked-out" incrementally from the first block in the
@@ -95,19 +100,29 @@ typedef struct {
     uint8_t spindle_pwm;
   #endif
 } segment_t;
-static segment_t segment_buffer[SEGMENT_BUFFER_SIZE];
+static DTCM_DATA segment_t segment_buffer[SEGMENT_BUFFER_SIZE];
 
 // Stepper ISR data struct. Contains the running data for the main stepper ISR.
 typedef struct {
   // Used by the bresenham line algorithm
   uint32_t counter_x,        // Counter variables for the bresenham line tracer
            counter_y,
-           counter_z,
-  	  	   counter_a,
-		   counter_b,
-		   counter_c,
-		   counter_u,
-		   counter_v;
+           counter_z;
+  #if N_AXIS > 3
+    uint32_t counter_a;
+  #endif
+  #if N_AXIS > 4
+    uint32_t counter_b;
+  #endif
+  #if N_AXIS > 5
+    uint32_t counter_c;
+  #endif
+  #if N_AXIS > 6
+    uint32_t counter_u;
+  #endif
+  #if N_AXIS > 7
+    uint32_t counter_v;
+  #endif
 
   #ifdef STEP_PULSE_DELAY
     uint8_t step_bits;  // Stores out_bits output to complete the step pulse delay
@@ -115,8 +130,8 @@ typedef struct {
 
   uint8_t execute_step;     // Flags step execution for each interrupt.
   uint8_t step_pulse_time;  // Step pulse reset time after step rise
-  uint8_t step_outbits;         // The next stepping-bits to be output
-  uint8_t dir_outbits;
+  uint16_t step_outbits;        // The next stepping-bits to be output
+  uint16_t dir_outbits;
   #ifdef ENABLE_DUAL_AXIS
     uint8_t step_outbits_dual;
     uint8_t dir_outbits_dual;
@@ -130,7 +145,7 @@ typedef struct {
   st_block_t *exec_block;   // Pointer to the block data for the segment being executed
   segment_t *exec_segment;  // Pointer to the segment being executed
 } stepper_t;
-static stepper_t st;
+static DTCM_DATA stepper_t st;
 
 // Step segment ring buffer indices
 static volatile uint8_t segment_buffer_tail;
@@ -138,8 +153,11 @@ static uint8_t segment_buffer_head;
 static uint8_t segment_next_head;
 
 // Step and direction port invert masks.
-static uint8_t step_port_invert_mask;
-static uint8_t dir_port_invert_mask;
+static uint16_t step_port_invert_mask;
+#ifdef STEP_PULSE_DMA_RESET
+  static DMA_BUFFER uint32_t step_pulse_reset_bsrr; // BSRR word returning the step pins to idle. Read by DMA.
+#endif
+static uint16_t dir_port_invert_mask;
 #ifdef ENABLE_DUAL_AXIS
   static uint8_t step_port_invert_mask_dual;
   static uint8_t dir_port_invert_mask_dual;
@@ -148,9 +166,13 @@ static uint8_t dir_port_invert_mask;
 // Used to avoid ISR nesting of the "Stepper Driver Interrupt". Should never occur though.
 static volatile uint8_t busy;
 
+// Step segment buffer underruns since power-up or the last '$TR'. See st_check_underrun().
+static volatile uint32_t st_underrun_count;
+
 // Pointers for the step segment being prepped from the planner buffer. Accessed only by the
 // main program. Pointers may be planning segments or planner blocks ahead of what being executed.
 static plan_block_t *pl_block;     // Pointer to the planner block being prepped
+static plan_profile_t *pl_profile; // Pointer to the planner profile of the block being prepped
 static st_block_t *st_prep_block;  // Pointer to the stepper block data being prepped
 
 // Segment preparation data struct. Contains all the necessary information to compute new segments
@@ -169,6 +191,11 @@ typedef struct {
     float last_steps_remaining;
     float last_step_per_mm;
     float last_dt_remainder;
+    #ifdef NATIVE_ARCS
+      float last_dt_segment;
+      int32_t last_arc_steps[N_AXIS];
+      uint8_t last_arc_chord_prepped;
+    #endif
   #endif
 
   uint8_t ramp_type;      // Current segment ramp state
@@ -180,12 +207,51 @@ typedef struct {
   float accelerate_until; // Acceleration ramp end measured from end of block (mm)
   float decelerate_after; // Deceleration ramp start measured from end of block (mm)
 
+  #ifdef JERK_LIMITED_PROFILES
+    float ramp_time;        // Duration of the jerk-limited ramp in progress (min). Zero for a linear ramp.
+    float ramp_elapsed;     // Time traced so far along the ramp (min)
+    float ramp_mm_start;    // Ramp start measured from end of block (mm)
+    float ramp_speed_start; // Speed at the start of the ramp (mm/min)
+    float ramp_delta_speed; // Signed speed change over the ramp (mm/min)
+    float ramp_jerk_frac;   // Duration of each jerk phase as a fraction of ramp_time (0.0-0.5)
+  #endif
+
   #ifdef VARIABLE_SPINDLE
     float inv_rate;    // Used by PWM laser mode to speed up segment calculations.
     uint8_t current_spindle_pwm; 
   #endif
+
+  #ifdef NATIVE_ARCS
+    float dt_segment;             // Segment time. Shorter than DT_SEGMENT for arcs traced with fine chords.
+    int32_t arc_steps[N_AXIS];    // Step position reached by the last arc chord prepped
+    uint8_t arc_chord_prepped;    // False until the first chord of the arc block uses its stepper block
+  #endif
 } st_prep_t;
-static st_prep_t prep;
+static DTCM_DATA st_prep_t prep;
+
+#ifdef SEGMENT_PREP_TASK
+  #define ST_PREP_SIGNAL 0x01
+  static osThreadId st_prep_task_id;
+  static osMutexId st_prep_mutex_id;
+  osMutexDef(st_prep_mutex);
+  static void st_prep_task(void const *argument);
+
+  // Wakes the segment prep task once the segment buffer has drained to the low-water mark. Called
+  // by the stepper interrupts as segments are consumed.
+  static inline void st_prep_request()
+  {
+    uint8_t queued = segment_buffer_head + SEGMENT_BUFFER_SIZE - segment_buffer_tail;
+    if (queued >= SEGMENT_BUFFER_SIZE) { queued -= SEGMENT_BUFFER_SIZE; }
+    if ((queued <= SEGMENT_PREP_LOW_WATER) && (st_prep_task_id != NULL)) {
+      osSignalSet(st_prep_task_id, ST_PREP_SIGNAL);
+    }
+  }
+#endif
+
+#ifdef STEP_GENERATION_DMA
+  static void st_dma_start();
+  static void st_dma_stop();
+#endif
 
 
 /*    BLOCK VELOCITY PROFILE DEFINITION
@@ -249,19 +315,27 @@ void st_wake_up()
     st.step_pulse_time = (settings.pulse_microseconds);
   #endif
 
-  // Enable Stepper Driver Interrupt
+  #ifdef STEP_GENERATION_DMA
+    // Homing and probing must stop on the exact step, so only they keep the stepper interrupts.
+    if ((sys.state != STATE_HOMING) && (sys_probe_state != PROBE_ACTIVE)) {
+      st_dma_start();
+      return;
+    }
+  #endif
+
+  // Enable Stepper Driver Interrupt. st.exec_segment is not loaded yet, so time the first interrupt by
+  // the segment it will load.
 
-  TIM2->ARR = (uint32_t)st.exec_segment->cycles_per_tick - 1;
-  TIM3->ARR = (((uint32_t)st.step_pulse_time*TICKS_PER_MICROSECOND) >> 1); //++
+  StepTimerSetPeriod(segment_buffer[segment_buffer_tail].cycles_per_tick);
+  StepPulseTimerSetPeriod(st.step_pulse_time);
   // Set the Autoreload value
 #ifndef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-  TIM2->PSC = st.exec_segment->prescaler;
+  StepTimerSetPrescaler(segment_buffer[segment_buffer_tail].prescaler);
 #endif
-  TIM2->EGR = TIM_EGR_UG;
-  TIM3->EGR = TIM_EGR_UG; // ++
+  StepTimersReload();
 
-  HAL_NVIC_EnableIRQ(TIM2_IRQn);
-  HAL_NVIC_EnableIRQ(TIM3_IRQn);
+  StepTimerEnable();
+  StepPulseTimerEnable();
 }
 
 
@@ -269,8 +343,11 @@ void st_wake_up()
 void st_go_idle()
 {
   // Disable Stepper Driver Interrupt. Allow Stepper Port Reset Interrupt to finish, if active.
-  HAL_NVIC_DisableIRQ(TIM2_IRQn);
-  HAL_NVIC_DisableIRQ(TIM3_IRQn); // ++
+  StepTimerDisable();
+  #ifdef STEP_GENERATION_DMA
+    st_dma_stop();
+  #endif
+  StepPulseTimerDisable();
   busy = false;
 
   // Set stepper driver idle state, disabled or enabled, depending on settings and circumstances.
@@ -287,6 +364,235 @@ void st_go_idle()
 }
 
 
+// Counts an underrun when the steppers run out of segments in the middle of a cycle, i.e. while
+// the planner still holds motion that st_prep_buffer() has not caught up with. The normal end of
+// a motion, feed holds and forced stops empty the buffer with nothing left to prep.
+static void st_check_underrun()
+{
+  if ((sys.state == STATE_CYCLE) && bit_isfalse(sys.step_control,STEP_CONTROL_END_MOTION) &&
+      (plan_get_current_block() != NULL)) {
+    st_underrun_count++;
+  }
+}
+
+
+uint32_t st_get_underrun_count()
+{
+  return(st_underrun_count);
+}
+
+
+void st_reset_underrun_count()
+{
+  st_underrun_count = 0;
+}
+
+
+// Resets the Bresenham counters of the axes built in, when a new stepper block starts executing.
+static inline void st_reset_counters()
+{
+  uint32_t counter = (st.exec_block->step_event_count >> 1);
+  st.counter_x = st.counter_y = st.counter_z = counter;
+  #if N_AXIS > 3
+    st.counter_a = counter;
+  #endif
+  #if N_AXIS > 4
+    st.counter_b = counter;
+  #endif
+  #if N_AXIS > 5
+    st.counter_c = counter;
+  #endif
+  #if N_AXIS > 6
+    st.counter_u = counter;
+  #endif
+  #if N_AXIS > 7
+    st.counter_v = counter;
+  #endif
+}
+
+
+#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+// Adjusts the Bresenham axis increments of the axes built in according to the AMASS level of the
+// executing segment.
+static inline void st_load_amass_steps()
+{
+  uint8_t amass_level = st.exec_segment->amass_level;
+  st.steps[X_AXIS] = st.exec_block->steps[X_AXIS] >> amass_level;
+  st.steps[Y_AXIS] = st.exec_block->steps[Y_AXIS] >> amass_level;
+  st.steps[Z_AXIS] = st.exec_block->steps[Z_AXIS] >> amass_level;
+  #if N_AXIS > 3
+    st.steps[A_AXIS] = st.exec_block->steps[A_AXIS] >> amass_level;
+  #endif
+  #if N_AXIS > 4
+    st.steps[B_AXIS] = st.exec_block->steps[B_AXIS] >> amass_level;
+  #endif
+  #if N_AXIS > 5
+    st.steps[C_AXIS] = st.exec_block->steps[C_AXIS] >> amass_level;
+  #endif
+  #if N_AXIS > 6
+    st.steps[U_AXIS] = st.exec_block->steps[U_AXIS] >> amass_level;
+  #endif
+  #if N_AXIS > 7
+    st.steps[V_AXIS] = st.exec_block->steps[V_AXIS] >> amass_level;
+  #endif
+}
+#endif
+
+
+// Executes one stepper tick of the Bresenham line algorithm for the executing segment. Sets the
+// step bits of the axes stepping on this tick in st.step_outbits (without the invert mask applied)
+// and tracks the machine position. Shared by The Stepper Driver Interrupt and the DMA renderer.
+static inline void st_trace_step_event()
+{
+  // Reset step out bits.
+  st.step_outbits = 0;
+  #ifdef ENABLE_DUAL_AXIS
+    st.step_outbits_dual = 0;
+  #endif
+
+
+  // Execute step displacement profile by Bresenham line algorithm. Only the axes built in and
+  // stepping in this block are traced.
+  uint8_t axis_mask = st.exec_block->axis_mask;
+
+  if (axis_mask & bit(X_AXIS)) {
+    #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+      st.counter_x += st.steps[X_AXIS];
+    #else
+      st.counter_x += st.exec_block->steps[X_AXIS];
+    #endif
+    if (st.counter_x > st.exec_block->step_event_count) {
+      st.step_outbits |= (1<<X_STEP_BIT);
+      #if defined(ENABLE_DUAL_AXIS) && (DUAL_AXIS_SELECT == X_AXIS)
+        st.step_outbits_dual = (1<<DUAL_STEP_BIT);
+      #endif
+      st.counter_x -= st.exec_block->step_event_count;
+      if (st.exec_block->direction_bits & (1<<X_DIRECTION_BIT)) { sys_position[X_AXIS]--; }
+      else { sys_position[X_AXIS]++; }
+    }
+  }
+
+  if (axis_mask & bit(Y_AXIS)) {
+    #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+      st.counter_y += st.steps[Y_AXIS];
+    #else
+      st.counter_y += st.exec_block->steps[Y_AXIS];
+    #endif
+    if (st.counter_y > st.exec_block->step_event_count) {
+      st.step_outbits |= (1<<Y_STEP_BIT);
+      #if defined(ENABLE_DUAL_AXIS) && (DUAL_AXIS_SELECT == Y_AXIS)
+        st.step_outbits_dual = (1<<DUAL_STEP_BIT);
+      #endif
+      st.counter_y -= st.exec_block->step_event_count;
+      if (st.exec_block->direction_bits & (1<<Y_DIRECTION_BIT)) { sys_position[Y_AXIS]--; }
+      else { sys_position[Y_AXIS]++; }
+    }
+  }
+
+  if (axis_mask & bit(Z_AXIS)) {
+    #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+      st.counter_z += st.steps[Z_AXIS];
+    #else
+      st.counter_z += st.exec_block->steps[Z_AXIS];
+    #endif
+    if (st.counter_z > st.exec_block->step_event_count) {
+      st.step_outbits |= (1<<Z_STEP_BIT);
+      st.counter_z -= st.exec_block->step_event_count;
+      if (st.exec_block->direction_bits & (1<<Z_DIRECTION_BIT)) { sys_position[Z_AXIS]--; }
+      else { sys_position[Z_AXIS]++; }
+    }
+  }
+
+  #if N_AXIS > 3
+  if (axis_mask & bit(A_AXIS)) {
+    #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+      st.counter_a += st.steps[A_AXIS];
+    #else
+      st.counter_a += st.exec_block->steps[A_AXIS];
+    #endif
+    if (st.counter_a > st.exec_block->step_event_count) {
+      st.step_outbits |= (1<<A_STEP_BIT);
+      st.counter_a -= st.exec_block->step_event_count;
+      if (st.exec_block->direction_bits & (1<<A_DIRECTION_BIT)) { sys_position[A_AXIS]--; }
+      else { sys_position[A_AXIS]++; }
+    }
+  }
+  #endif
+
+  #if N_AXIS > 4
+  if (axis_mask & bit(B_AXIS)) {
+    #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+      st.counter_b += st.steps[B_AXIS];
+    #else
+      st.counter_b += st.exec_block->steps[B_AXIS];
+    #endif
+    if (st.counter_b > st.exec_block->step_event_count) {
+      st.step_outbits |= (1<<B_STEP_BIT);
+      st.counter_b -= st.exec_block->step_event_count;
+      if (st.exec_block->direction_bits & (1<<B_DIRECTION_BIT)) { sys_position[B_AXIS]--; }
+      else { sys_position[B_AXIS]++; }
+    }
+  }
+  #endif
+
+  #if N_AXIS > 5
+  if (axis_mask & bit(C_AXIS)) {
+    #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+      st.counter_c += st.steps[C_AXIS];
+    #else
+      st.counter_c += st.exec_block->steps[C_AXIS];
+    #endif
+    if (st.counter_c > st.exec_block->step_event_count) {
+      st.step_outbits |= (1<<C_STEP_BIT);
+      st.counter_c -= st.exec_block->step_event_count;
+      if (st.exec_block->direction_bits & (1<<C_DIRECTION_BIT)) { sys_position[C_AXIS]--; }
+      else { sys_position[C_AXIS]++; }
+    }
+  }
+  #endif
+
+  #if N_AXIS > 6
+  if (axis_mask & bit(U_AXIS)) {
+    #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+      st.counter_u += st.steps[U_AXIS];
+    #else
+      st.counter_u += st.exec_block->steps[U_AXIS];
+    #endif
+    if (st.counter_u > st.exec_block->step_event_count) {
+      st.step_outbits |= (1<<U_STEP_BIT);
+      st.counter_u -= st.exec_block->step_event_count;
+      if (st.exec_block->direction_bits & (1<<U_DIRECTION_BIT)) { sys_position[U_AXIS]--; }
+      else { sys_position[U_AXIS]++; }
+    }
+  }
+  #endif
+
+  #if N_AXIS > 7
+  if (axis_mask & bit(V_AXIS)) {
+    #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+      st.counter_v += st.steps[V_AXIS];
+    #else
+      st.counter_v += st.exec_block->steps[V_AXIS];
+    #endif
+    if (st.counter_v > st.exec_block->step_event_count) {
+      st.step_outbits |= (1<<V_STEP_BIT);
+      st.counter_v -= st.exec_block->step_event_count;
+      if (st.exec_block->direction_bits & (1<<V_DIRECTION_BIT)) { sys_position[V_AXIS]--; }
+      else { sys_position[V_AXIS]++; }
+    }
+  }
+  #endif
+
+  // During a homing cycle, lock out and prevent desired axes from moving.
+  if (sys.state == STATE_HOMING) { 
+    st.step_outbits &= sys.homing_axis_lock;
+    #ifdef ENABLE_DUAL_AXIS
+      st.step_outbits_dual &= sys.homing_axis_lock_dual;
+    #endif
+  }
+}
+
+
 /* "The Stepper Driver Interrupt" - This timer interrupt is the workhorse of Grbl. Grbl employs
    the venerable Bresenham line algorithm to manage and exactly synchronize multi-axis moves.
    Unlike the popular DDA algorithm, the Bresenham algorithm is not susceptible to numerical
@@ -329,18 +635,20 @@ void st_go_idle()
 
    NOTE: This interrupt must be as efficient as possible and complete before the next ISR tick,
    which for Grbl must be less than 33.3usec (@30kHz ISR rate). Oscilloscope measured time in
-   ISR is 5usec typical and 25usec maximum, well below requirement.
+   ISR is 5usec typical and 25usec maximum, well below requirement. Enable ENABLE_CYCLE_PROFILING
+   in config.h for cycle-accurate figures on this target ('$T').
    NOTE: This ISR expects at least one step to be executed per segment.
 */
 // TODO: Replace direct updating of the int32 position counters in the ISR somehow. Perhaps use smaller
 // int8 variables and update position counters only when a segment completes. This can get complicated
 // with probing and homing cycles that require true real-time positions.
-void _TIM2_IRQHandler(void)
+ITCM_CODE void _TIM2_IRQHandler(void)
 {
   if (busy) { return; } // The busy-flag is used to avoid reentering this interrupt
+  PROFILE_START(profile_start);
 
   // Set the direction pins a couple of nanoseconds before we step the steppers
-  GPIO_WritePort(DIRECTION_PORT, (GPIO_ReadPort(DIRECTION_PORT) & ~DIRECTION_MASK) | (st.dir_outbits & DIRECTION_MASK));
+  DirectionPortWrite(st.dir_outbits);
   #ifdef ENABLE_DUAL_AXIS
     DIRECTION_PORT_DUAL = (DIRECTION_PORT_DUAL & ~DIRECTION_MASK_DUAL) | (st.dir_outbits_dual & DIRECTION_MASK_DUAL);
   #endif
@@ -352,7 +660,7 @@ void _TIM2_IRQHandler(void)
       st.step_bits_dual = (STEP_PORT_DUAL & ~STEP_MASK_DUAL) | st.step_outbits_dual;
     #endif
   #else  // Normal operation
-      GPIO_WritePort(STEP_PORT, (GPIO_ReadPort(STEP_PORT) & ~STEP_MASK) | st.step_outbits);
+    StepPortWrite(st.step_outbits);
     #ifdef ENABLE_DUAL_AXIS
       STEP_PORT_DUAL = (STEP_PORT_DUAL & ~STEP_MASK_DUAL) | st.step_outbits_dual;
     #endif
@@ -360,10 +668,9 @@ void _TIM2_IRQHandler(void)
 
   // Enable step pulse reset timer so that The Stepper Port Reset Interrupt can reset the signal after
   // exactly settings.pulse_microseconds microseconds, independent of the main Timer1 prescaler.
-  TIM3->CNT = 0;
-  TIM3->ARR = (((uint32_t)st.step_pulse_time*TICKS_PER_MICROSECOND) >> 1);
-  //HAL_NVIC_EnableIRQ(TIM3_IRQn);
-  HAL_TIM_Base_Start(&htim3);
+  // NOTE: With STEP_PULSE_DMA_RESET, the timer ends the pulse by DMA instead, without interrupt.
+  StepPulseTimerSetPeriod(st.step_pulse_time);
+  StepPulseTimerStart();
 
   busy = true;
 
@@ -375,11 +682,10 @@ void _TIM2_IRQHandler(void)
       st.exec_segment = &segment_buffer[segment_buffer_tail];
 
       // Initialize step segment timing per step and load number of steps to execute.
-	  TIM2->ARR = (uint32_t)st.exec_segment->cycles_per_tick - 1;
-
-#ifndef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-	  TIM2->PSC = st.exec_segment->prescaler;
-#endif
+      StepTimerSetPeriod(st.exec_segment->cycles_per_tick);
+      #ifndef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+        StepTimerSetPrescaler(st.exec_segment->prescaler);
+      #endif
       st.step_count = st.exec_segment->n_step; // NOTE: Can sometimes be zero when moving slow.
       // If the new segment starts a new planner block, initialize stepper variables and counters.
       // NOTE: When the segment data index changes, this indicates a new planner block.
@@ -387,8 +693,7 @@ void _TIM2_IRQHandler(void)
         st.exec_block_index = st.exec_segment->st_block_index;
         st.exec_block = &st_block_buffer[st.exec_block_index];
 
-        // Initialize Bresenham line and distance counters
-        st.counter_x = st.counter_y = st.counter_z = st.counter_a = st.counter_b = st.counter_c = st.counter_u = st.counter_v = (st.exec_block->step_event_count >> 1);
+        st_reset_counters(); // Initialize Bresenham line and distance counters
       }
       st.dir_outbits = st.exec_block->direction_bits ^ dir_port_invert_mask;
       #ifdef ENABLE_DUAL_AXIS
@@ -397,14 +702,7 @@ void _TIM2_IRQHandler(void)
 
       #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
         // With AMASS enabled, adjust Bresenham axis increment counters according to AMASS level.
-        st.steps[X_AXIS] = st.exec_block->steps[X_AXIS] >> st.exec_segment->amass_level;
-        st.steps[Y_AXIS] = st.exec_block->steps[Y_AXIS] >> st.exec_segment->amass_level;
-        st.steps[Z_AXIS] = st.exec_block->steps[Z_AXIS] >> st.exec_segment->amass_level;
-        st.steps[A_AXIS] = st.exec_block->steps[A_AXIS] >> st.exec_segment->amass_level;
-        st.steps[B_AXIS] = st.exec_block->steps[B_AXIS] >> st.exec_segment->amass_level;
-        st.steps[C_AXIS] = st.exec_block->steps[C_AXIS] >> st.exec_segment->amass_level;
-        st.steps[U_AXIS] = st.exec_block->steps[U_AXIS] >> st.exec_segment->amass_level;
-        st.steps[V_AXIS] = st.exec_block->steps[V_AXIS] >> st.exec_segment->amass_level;
+        st_load_amass_steps();
       #endif
 
       #ifdef VARIABLE_SPINDLE
@@ -414,12 +712,14 @@ void _TIM2_IRQHandler(void)
 
     } else {
       // Segment buffer empty. Shutdown.
+      st_check_underrun();
       st_go_idle();
       #ifdef VARIABLE_SPINDLE
         // Ensure pwm is set properly upon completion of rate-controlled motion.
         if (st.exec_block->is_pwm_rate_adjusted) { spindle_set_speed(SPINDLE_PWM_OFF_VALUE); }
       #endif
       system_set_exec_state_flag(EXEC_CYCLE_STOP); // Flag main program for cycle end
+      PROFILE_END(PROFILE_STEP_ISR,profile_start);
       return; // Nothing to do but exit.
     }
   }
@@ -428,131 +728,16 @@ void _TIM2_IRQHandler(void)
   // Check probing state.
   if (sys_probe_state == PROBE_ACTIVE) { probe_state_monitor(); }
 
-  // Reset step out bits.
-  st.step_outbits = 0;
-  #ifdef ENABLE_DUAL_AXIS
-    st.step_outbits_dual = 0;
-  #endif
-
-
-  // Execute step displacement profile by Bresenham line algorithm
-  #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    st.counter_x += st.steps[X_AXIS];
-  #else
-    st.counter_x += st.exec_block->steps[X_AXIS];
-  #endif
-  if (st.counter_x > st.exec_block->step_event_count) {
-    st.step_outbits |= (1<<X_STEP_BIT);
-    #if defined(ENABLE_DUAL_AXIS) && (DUAL_AXIS_SELECT == X_AXIS)
-      st.step_outbits_dual = (1<<DUAL_STEP_BIT);
-    #endif
-    st.counter_x -= st.exec_block->step_event_count;
-    if (st.exec_block->direction_bits & (1<<X_DIRECTION_BIT)) { sys_position[X_AXIS]--; }
-    else { sys_position[X_AXIS]++; }
-  }
-
-
-  #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    st.counter_y += st.steps[Y_AXIS];
-  #else
-    st.counter_y += st.exec_block->steps[Y_AXIS];
-  #endif
-  if (st.counter_y > st.exec_block->step_event_count) {
-    st.step_outbits |= (1<<Y_STEP_BIT);
-    #if defined(ENABLE_DUAL_AXIS) && (DUAL_AXIS_SELECT == Y_AXIS)
-      st.step_outbits_dual = (1<<DUAL_STEP_BIT);
-    #endif
-    st.counter_y -= st.exec_block->step_event_count;
-    if (st.exec_block->direction_bits & (1<<Y_DIRECTION_BIT)) { sys_position[Y_AXIS]--; }
-    else { sys_position[Y_AXIS]++; }
-  }
-
-
-  #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    st.counter_z += st.steps[Z_AXIS];
-  #else
-    st.counter_z += st.exec_block->steps[Z_AXIS];
-  #endif
-  if (st.counter_z > st.exec_block->step_event_count) {
-    st.step_outbits |= (1<<Z_STEP_BIT);
-    st.counter_z -= st.exec_block->step_event_count;
-    if (st.exec_block->direction_bits & (1<<Z_DIRECTION_BIT)) { sys_position[Z_AXIS]--; }
-    else { sys_position[Z_AXIS]++; }
-  }
-
-#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    st.counter_a += st.steps[A_AXIS];
-  #else
-    st.counter_a += st.exec_block->steps[A_AXIS];
-  #endif
-  if (st.counter_a > st.exec_block->step_event_count) {
-    st.step_outbits |= (1<<A_STEP_BIT);
-    st.counter_a -= st.exec_block->step_event_count;
-    if (st.exec_block->direction_bits & (1<<A_DIRECTION_BIT)) { sys_position[A_AXIS]--; }
-    else { sys_position[A_AXIS]++; }
-  }
-
-#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    st.counter_b += st.steps[B_AXIS];
-  #else
-    st.counter_b += st.exec_block->steps[B_AXIS];
-  #endif
-  if (st.counter_b > st.exec_block->step_event_count) {
-    st.step_outbits |= (1<<B_STEP_BIT);
-    st.counter_b -= st.exec_block->step_event_count;
-    if (st.exec_block->direction_bits & (1<<B_DIRECTION_BIT)) { sys_position[B_AXIS]--; }
-    else { sys_position[B_AXIS]++; }
-  }
-
-#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    st.counter_c += st.steps[C_AXIS];
-  #else
-    st.counter_c += st.exec_block->steps[C_AXIS];
-  #endif
-  if (st.counter_c > st.exec_block->step_event_count) {
-    st.step_outbits |= (1<<C_STEP_BIT);
-    st.counter_c -= st.exec_block->step_event_count;
-    if (st.exec_block->direction_bits & (1<<C_DIRECTION_BIT)) { sys_position[C_AXIS]--; }
-    else { sys_position[C_AXIS]++; }
-  }
-
-#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    st.counter_u += st.steps[U_AXIS];
-  #else
-    st.counter_u += st.exec_block->steps[U_AXIS];
-  #endif
-  if (st.counter_u > st.exec_block->step_event_count) {
-    st.step_outbits |= (1<<U_STEP_BIT);
-    st.counter_u -= st.exec_block->step_event_count;
-    if (st.exec_block->direction_bits & (1<<U_DIRECTION_BIT)) { sys_position[U_AXIS]--; }
-    else { sys_position[U_AXIS]++; }
-  }
-
-#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    st.counter_v += st.steps[V_AXIS];
-  #else
-    st.counter_v += st.exec_block->steps[V_AXIS];
-  #endif
-  if (st.counter_v > st.exec_block->step_event_count) {
-    st.step_outbits |= (1<<V_STEP_BIT);
-    st.counter_v -= st.exec_block->step_event_count;
-    if (st.exec_block->direction_bits & (1<<V_DIRECTION_BIT)) { sys_position[V_AXIS]--; }
-    else { sys_position[V_AXIS]++; }
-  }
-
-  // During a homing cycle, lock out and prevent desired axes from moving.
-  if (sys.state == STATE_HOMING) { 
-    st.step_outbits &= sys.homing_axis_lock;
-    #ifdef ENABLE_DUAL_AXIS
-      st.step_outbits_dual &= sys.homing_axis_lock_dual;
-    #endif
-  }
+  st_trace_step_event();
 
   st.step_count--; // Decrement step events count
   if (st.step_count == 0) {
     // Segment is complete. Discard current segment and advance segment indexing.
     st.exec_segment = NULL;
     if ( ++segment_buffer_tail == SEGMENT_BUFFER_SIZE) { segment_buffer_tail = 0; }
+    #ifdef SEGMENT_PREP_TASK
+      st_prep_request();
+    #endif
   }
 
   st.step_outbits ^= step_port_invert_mask;  // Apply step port invert mask
@@ -560,6 +745,7 @@ void _TIM2_IRQHandler(void)
     st.step_outbits_dual ^= step_port_invert_mask_dual;
   #endif
   busy = false;
+  PROFILE_END(PROFILE_STEP_ISR,profile_start);
 }
 
 
@@ -574,11 +760,12 @@ void _TIM2_IRQHandler(void)
 // This interrupt is enabled by ISR_TIMER1_COMPAREA when it sets the motor port bits to execute
 // a step. This ISR resets the motor port after a short period (settings.pulse_microseconds)
 // completing one step cycle.
-void _TIM3_IRQHandler(void)
+ITCM_CODE void _TIM3_IRQHandler(void)
 {
-	//HAL_NVIC_DisableIRQ(TIM3_IRQn);
-	HAL_TIM_Base_Stop(&htim3);
-	GPIO_WritePort(STEP_PORT, (GPIO_ReadPort(STEP_PORT) & ~STEP_MASK) | (step_port_invert_mask & STEP_MASK));
+  PROFILE_START(profile_start);
+  StepPulseTimerStop();
+  StepPortWrite(step_port_invert_mask);
+  PROFILE_END(PROFILE_STEP_RESET_ISR,profile_start);
 }
 #ifdef STEP_PULSE_DELAY
   // This interrupt is used only when STEP_PULSE_DELAY is enabled. Here, the step pulse is
@@ -593,6 +780,192 @@ void _TIM3_IRQHandler(void)
 #endif
 
 
+#ifdef STEP_GENERATION_DMA
+  /* DMA step generation. TIM8 raises a DMA request every microsecond and DMA2 Stream1 copies one
+     word of step_dma_table into the step port BSRR register per request, wrapping around the table.
+     The table is split in two halves of STEP_DMA_CHUNK ticks. While one half is being sent, the
+     other is rendered by st_dma_render() from the segment buffer: the Bresenham tracer runs at the
+     segment tick rate exactly as in The Stepper Driver Interrupt, but its step events become words
+     setting the step pins at one tick and returning them to idle settings.pulse_microseconds ticks
+     later. A direction change is written one tick ahead of the following step. A zero word leaves
+     the port untouched, so the other pins of the port are never disturbed.
+  */
+  static DMA_BUFFER uint32_t step_dma_table[2*STEP_DMA_CHUNK];
+
+  typedef struct {
+    uint8_t active;           // True while TIM8 and the DMA stream drive the step port
+    uint8_t stop_pending;     // Set when a rendered half holds no more edges. Stops on the next half.
+    int32_t tick_remaining;   // Timer cycles left until the next stepper tick
+    uint16_t pulse_remaining; // Ticks left until the step pulse in progress ends
+    uint16_t pulse_ticks;     // Step pulse width in ticks
+    uint32_t idle_word;       // BSRR word returning all step pins to their idle level
+  } step_dma_t;
+  static step_dma_t step_dma;
+
+  #define STEP_DMA_FLAGS (DMA_LIFCR_CTCIF1|DMA_LIFCR_CHTIF1|DMA_LIFCR_CTEIF1|DMA_LIFCR_CDMEIF1|DMA_LIFCR_CFEIF1)
+
+  // Returns the BSRR word driving the masked pins to the levels given in bits.
+  static inline uint32_t st_dma_bsrr(uint16_t bits, uint16_t mask)
+  {
+    return((uint32_t)(bits & mask) | ((uint32_t)(~bits & mask) << 16));
+  }
+
+
+  // Pops the next segment from the step segment buffer, as The Stepper Driver Interrupt does. Returns
+  // true when the segment changes the direction bits, which must then be output first.
+  static uint8_t st_dma_load_segment()
+  {
+    st.exec_segment = &segment_buffer[segment_buffer_tail];
+    st.step_count = st.exec_segment->n_step;
+    if ( st.exec_block_index != st.exec_segment->st_block_index ) {
+      st.exec_block_index = st.exec_segment->st_block_index;
+      st.exec_block = &st_block_buffer[st.exec_block_index];
+      st_reset_counters();
+    }
+    st_load_amass_steps();
+
+    #ifdef VARIABLE_SPINDLE
+      // NOTE: Applied when the segment is rendered, up to two chunks ahead of its first step.
+      spindle_set_speed(st.exec_segment->spindle_pwm);
+    #endif
+
+    uint16_t dir_outbits = st.exec_block->direction_bits ^ dir_port_invert_mask;
+    if (dir_outbits == st.dir_outbits) { return(false); }
+    st.dir_outbits = dir_outbits;
+    return(true);
+  }
+
+
+  // Renders the next STEP_DMA_CHUNK ticks into one half of the table. Returns false when the half
+  // holds no edges and the segment buffer has run dry, so the last step pulse has ended. A half may
+  // hold no edges while a slow segment is still stepping.
+  static uint8_t st_dma_render(uint32_t *table)
+  {
+    uint8_t edges = false;
+    uint16_t idx;
+    for (idx=0; idx<STEP_DMA_CHUNK; idx++) {
+      uint32_t word = 0;
+      if (step_dma.pulse_remaining) {
+        if (--step_dma.pulse_remaining == 0) { word = step_dma.idle_word; }
+      }
+
+      if (st.exec_segment == NULL) {
+        if (segment_buffer_head == segment_buffer_tail) {
+          // Nothing to step. Only finish the pulse in progress.
+          table[idx] = word;
+          if (word) { edges = true; }
+          continue;
+        }
+        if (st_dma_load_segment()) {
+          // Give the drivers a full tick of direction setup time before the next step.
+          table[idx] = word | st_dma_bsrr(st.dir_outbits, DIRECTION_MASK);
+          edges = true;
+          continue;
+        }
+      }
+
+      step_dma.tick_remaining -= TICKS_PER_MICROSECOND;
+      if (step_dma.tick_remaining <= 0) {
+        step_dma.tick_remaining += st.exec_segment->cycles_per_tick;
+        st_trace_step_event();
+        if (st.step_outbits) {
+          // A new pulse takes over an idle level write to the same pins on this tick.
+          word &= ~((uint32_t)st.step_outbits | ((uint32_t)st.step_outbits << 16));
+          word |= st_dma_bsrr(~step_port_invert_mask, st.step_outbits);
+          step_dma.pulse_remaining = step_dma.pulse_ticks;
+        }
+        st.step_count--; // Decrement step events count
+        if (st.step_count == 0) {
+          // Segment is complete. Discard current segment and advance segment indexing.
+          st.exec_segment = NULL;
+          if ( ++segment_buffer_tail == SEGMENT_BUFFER_SIZE) { segment_buffer_tail = 0; }
+          #ifdef SEGMENT_PREP_TASK
+            st_prep_request();
+          #endif
+        }
+      }
+      table[idx] = word;
+      if (word) { edges = true; }
+    }
+    return(edges || step_dma.pulse_remaining || (st.exec_segment != NULL) ||
+           (segment_buffer_head != segment_buffer_tail));
+  }
+
+
+  // Renders both table halves from the segment buffer and starts the DMA stream and its timer.
+  static void st_dma_start()
+  {
+    if (step_dma.active) { return; }
+    step_dma.pulse_ticks = settings.pulse_microseconds;
+    step_dma.idle_word = st_dma_bsrr(step_port_invert_mask, STEP_MASK);
+    step_dma.pulse_remaining = 0;
+    step_dma.tick_remaining = 0;
+    step_dma.stop_pending = false;
+    StepPortWrite(step_port_invert_mask);
+    DirectionPortWrite(st.dir_outbits);
+
+    st_dma_render(step_dma_table);
+    st_dma_render(&step_dma_table[STEP_DMA_CHUNK]);
+
+    DMA2->LIFCR = STEP_DMA_FLAGS;
+    DMA2_Stream1->NDTR = 2*STEP_DMA_CHUNK;
+    DMA2_Stream1->CR |= DMA_SxCR_EN;
+    step_dma.active = true;
+    TIM8->CNT = 0;
+    TIM8->CR1 |= TIM_CR1_CEN;
+  }
+
+
+  // Stops the DMA stream and its timer. Returns the step pins to idle, in case a pulse was cut short.
+  static void st_dma_stop()
+  {
+    TIM8->CR1 &= ~TIM_CR1_CEN;
+    DMA2_Stream1->CR &= ~DMA_SxCR_EN;
+    while (DMA2_Stream1->CR & DMA_SxCR_EN) {}
+    DMA2->LIFCR = STEP_DMA_FLAGS;
+    if (step_dma.active) { StepPortWrite(step_port_invert_mask); }
+    step_dma.active = false;
+  }
+
+
+  // DMA2 Stream1 half and full transfer interrupt. Refills the table half that has just been sent,
+  // or ends the cycle once the half holding the last edges has been sent.
+  ITCM_CODE void _DMA2_Stream1_IRQHandler(void)
+  {
+    PROFILE_START(profile_start);
+    uint32_t *table;
+    if (DMA2->LISR & DMA_LISR_HTIF1) {
+      DMA2->LIFCR = DMA_LIFCR_CHTIF1;
+      table = step_dma_table;
+    } else if (DMA2->LISR & DMA_LISR_TCIF1) {
+      DMA2->LIFCR = DMA_LIFCR_CTCIF1;
+      table = &step_dma_table[STEP_DMA_CHUNK];
+    } else {
+      DMA2->LIFCR = STEP_DMA_FLAGS;
+      return;
+    }
+    if (!step_dma.active) { return; }
+
+    if (step_dma.stop_pending) {
+      // Segment buffer empty. Shutdown.
+      st_go_idle();
+      #ifdef VARIABLE_SPINDLE
+        // Ensure pwm is set properly upon completion of rate-controlled motion.
+        if (st.exec_block->is_pwm_rate_adjusted) { spindle_set_speed(SPINDLE_PWM_OFF_VALUE); }
+      #endif
+      system_set_exec_state_flag(EXEC_CYCLE_STOP); // Flag main program for cycle end
+      PROFILE_END(PROFILE_STEP_DMA_ISR,profile_start);
+      return;
+    }
+    if (!st_dma_render(table)) {
+      step_dma.stop_pending = true;
+      st_check_underrun();
+    }
+    PROFILE_END(PROFILE_STEP_DMA_ISR,profile_start);
+  }
+#endif
+
+
 // Generates the step and direction port invert masks used in the Stepper Interrupt Driver.
 void st_generate_step_dir_invert_masks()
 {
@@ -603,6 +976,10 @@ void st_generate_step_dir_invert_masks()
     if (bit_istrue(settings.step_invert_mask,bit(idx))) { step_port_invert_mask |= get_step_pin_mask(idx); }
     if (bit_istrue(settings.dir_invert_mask,bit(idx))) { dir_port_invert_mask |= get_direction_pin_mask(idx); }
   }
+  #ifdef STEP_PULSE_DMA_RESET
+    step_pulse_reset_bsrr = (uint32_t)(step_port_invert_mask & STEP_MASK) |
+                            ((uint32_t)(~step_port_invert_mask & STEP_MASK) << 16);
+  #endif
   #ifdef ENABLE_DUAL_AXIS
     step_port_invert_mask_dual = 0;
     dir_port_invert_mask_dual = 0;
@@ -616,6 +993,8 @@ void st_generate_step_dir_invert_masks()
 // Reset and clear stepper subsystem variables
 void st_reset()
 {
+  ST_PREP_LOCK();
+
   // Initialize stepper driver idle state.
   st_go_idle();
 
@@ -633,21 +1012,46 @@ void st_reset()
   st.dir_outbits = dir_port_invert_mask; // Initialize direction bits to default.
 
   // Initialize step and direction port pins.
-  GPIO_WritePort(STEP_PORT, (GPIO_ReadPort(STEP_PORT) & ~STEP_MASK) | (step_port_invert_mask & STEP_MASK));
-  GPIO_WritePort(DIRECTION_PORT, (GPIO_ReadPort(DIRECTION_PORT) & ~DIRECTION_MASK) | (dir_port_invert_mask & DIRECTION_MASK));
+  StepPortWrite(step_port_invert_mask);
+  DirectionPortWrite(dir_port_invert_mask);
   
   #ifdef ENABLE_DUAL_AXIS
     st.dir_outbits_dual = dir_port_invert_mask_dual;
     STEP_PORT_DUAL = (STEP_PORT_DUAL & ~STEP_MASK_DUAL) | step_port_invert_mask_dual;
     DIRECTION_PORT_DUAL = (DIRECTION_PORT_DUAL & ~DIRECTION_MASK_DUAL) | dir_port_invert_mask_dual;
   #endif
+
+  ST_PREP_UNLOCK();
 }
 
 
 // Initialize and start the stepper motor subsystem
 void stepper_init()
 {
+  #ifdef SEGMENT_PREP_TASK
+    // Highest task priority. The protocol task runs at osPriorityNormal.
+    st_prep_mutex_id = osRecursiveMutexCreate(osMutex(st_prep_mutex));
+    osThreadDef(segmentPrep, st_prep_task, osPriorityRealtime, 0, 512);
+    st_prep_task_id = osThreadCreate(osThread(segmentPrep), NULL);
+  #endif
+
+  #ifdef STEP_GENERATION_DMA
+    // TIM8 update events request DMA2 Stream1 once per usec, copying the table into the step port
+    // BSRR register. See TIM8_StepDMA_Init() in Src/tim.c.
+    TIM8_StepDMA_Init(STEP_PORT, step_dma_table, 2*STEP_DMA_CHUNK);
+
+    // Same priority as The Stepper Driver Interrupt, which it replaces while moving.
+    HAL_NVIC_SetPriority(DMA2_Stream1_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Stream1_IRQn);
+  #endif
 
+  #ifdef STEP_PULSE_DMA_RESET
+    // The Stepper Port Reset Interrupt is not used. TIM8 counts each pulse at the timer clock and
+    // its update event has DMA2 Stream1 copy the idle step pin levels into the step port BSRR
+    // register. See TIM8_StepPulseDMA_Init() in Src/tim.c.
+    HAL_TIM_Base_Stop_IT(&htim3);
+    TIM8_StepPulseDMA_Init(STEP_PORT, &step_pulse_reset_bsrr);
+  #endif
 }
 
 
@@ -656,7 +1060,7 @@ void st_update_plan_block_parameters()
 {
   if (pl_block != NULL) { // Ignore if at start of a new block.
     prep.recalculate_flag |= PREP_FLAG_RECALCULATE;
-    pl_block->entry_speed_sqr = prep.current_speed*prep.current_speed; // Update entry speed.
+    pl_profile->entry_speed_sqr = prep.current_speed*prep.current_speed; // Update entry speed.
     pl_block = NULL; // Flag st_prep_segment() to load and check active velocity profile.
   }
 }
@@ -675,23 +1079,32 @@ static uint8_t st_next_block_index(uint8_t block_index)
   // Changes the run state of the step segment buffer to execute the special parking motion.
   void st_parking_setup_buffer()
   {
+    ST_PREP_LOCK();
     // Store step execution data of partially completed block, if necessary.
     if (prep.recalculate_flag & PREP_FLAG_HOLD_PARTIAL_BLOCK) {
       prep.last_st_block_index = prep.st_block_index;
       prep.last_steps_remaining = prep.steps_remaining;
       prep.last_dt_remainder = prep.dt_remainder;
       prep.last_step_per_mm = prep.step_per_mm;
+      #ifdef NATIVE_ARCS
+        // Chord progress of a partially completed arc block.
+        prep.last_dt_segment = prep.dt_segment;
+        memcpy(prep.last_arc_steps, prep.arc_steps, sizeof(prep.arc_steps));
+        prep.last_arc_chord_prepped = prep.arc_chord_prepped;
+      #endif
     }
     // Set flags to execute a parking motion
     prep.recalculate_flag |= PREP_FLAG_PARKING;
     prep.recalculate_flag &= ~(PREP_FLAG_RECALCULATE);
     pl_block = NULL; // Always reset parking motion to reload new block.
+    ST_PREP_UNLOCK();
   }
 
 
   // Restores the step segment buffer to the normal run state after a parking motion.
   void st_parking_restore_buffer()
   {
+    ST_PREP_LOCK();
     // Restore step execution data and flags of partially completed block, if necessary.
     if (prep.recalculate_flag & PREP_FLAG_HOLD_PARTIAL_BLOCK) {
       st_prep_block = &st_block_buffer[prep.last_st_block_index];
@@ -699,12 +1112,186 @@ static uint8_t st_next_block_index(uint8_t block_index)
       prep.steps_remaining = prep.last_steps_remaining;
       prep.dt_remainder = prep.last_dt_remainder;
       prep.step_per_mm = prep.last_step_per_mm;
+      #ifdef NATIVE_ARCS
+        prep.dt_segment = prep.last_dt_segment;
+        memcpy(prep.arc_steps, prep.last_arc_steps, sizeof(prep.arc_steps));
+        prep.arc_chord_prepped = prep.last_arc_chord_prepped;
+      #endif
       prep.recalculate_flag = (PREP_FLAG_HOLD_PARTIAL_BLOCK | PREP_FLAG_RECALCULATE);
       prep.req_mm_increment = REQ_MM_INCREMENT_SCALAR/prep.step_per_mm; // Recompute this value.
     } else {
       prep.recalculate_flag = false;
     }
     pl_block = NULL; // Set to reload next block.
+    ST_PREP_UNLOCK();
+  }
+#endif
+
+
+// Sets the Bresenham data of the stepper block being prepped from the step counts and directions of
+// a planner block, or of an arc chord.
+static void st_prep_block_load(uint32_t *steps, uint32_t step_event_count, uint16_t direction_bits)
+{
+  st_prep_block->direction_bits = direction_bits;
+  #ifdef ENABLE_DUAL_AXIS
+    #if (DUAL_AXIS_SELECT == X_AXIS)
+      if (st_prep_block->direction_bits & (1<<X_DIRECTION_BIT)) { 
+    #elif (DUAL_AXIS_SELECT == Y_AXIS)
+      if (st_prep_block->direction_bits & (1<<Y_DIRECTION_BIT)) { 
+    #endif
+      st_prep_block->direction_bits_dual = (1<<DUAL_DIRECTION_BIT); 
+    }  else { st_prep_block->direction_bits_dual = 0; }
+  #endif
+  uint8_t idx;
+  st_prep_block->axis_mask = 0;
+  for (idx=0; idx<N_AXIS; idx++) {
+    if (steps[idx]) { st_prep_block->axis_mask |= bit(idx); }
+  }
+  #ifndef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+    for (idx=0; idx<N_AXIS; idx++) { st_prep_block->steps[idx] = (steps[idx] << 1); }
+    st_prep_block->step_event_count = (step_event_count << 1);
+  #else
+    // With AMASS enabled, simply bit-shift multiply all Bresenham data by the max AMASS
+    // level, such that we never divide beyond the original data anywhere in the algorithm.
+    // If the original data is divided, we can lose a step from integer roundoff.
+    for (idx=0; idx<N_AXIS; idx++) { st_prep_block->steps[idx] = steps[idx] << MAX_AMASS_LEVEL; }
+    st_prep_block->step_event_count = step_event_count << MAX_AMASS_LEVEL;
+  #endif
+}
+
+
+#ifdef NATIVE_ARCS
+  /* Native arcs. An arc is one planner block, planned and profiled along its path length like a line.
+     While its segments are generated, each one is stepped as a straight chord from the step position
+     reached by the last one to the point of the arc at the end of the segment, with its own stepper
+     block of Bresenham data. Chords are kept short enough to stay within the arc tolerance, and the
+     last one ends exactly on the block end point. A chord too short for a step adds its time to the
+     next one instead.
+  */
+  // Sets steps to the point of the arc being prepped at mm_remaining from its end.
+  static void st_arc_position(int32_t *steps, float mm_remaining)
+  {
+    plan_arc_t *arc = &pl_block->arc;
+    uint8_t idx;
+    int32_t travel;
+    float fraction = 1.0f-mm_remaining/arc->length;
+    for (idx=0; idx<N_AXIS; idx++) {
+      travel = pl_block->steps[idx];
+      if (pl_block->direction_bits & get_direction_pin_mask(idx)) { travel = -travel; }
+      if (mm_remaining <= 0.0f) { steps[idx] = arc->start_steps[idx]+travel; } // Exact end point
+      else { steps[idx] = arc->start_steps[idx]+lroundf(fraction*travel); }
+    }
+    if (mm_remaining > 0.0f) {
+      float angle = arc->start_angle+fraction*arc->angular_travel;
+      steps[arc->axis_0] = lroundf((arc->center[0]+arc->radius*cosf(angle))*settings.steps_per_mm[arc->axis_0]);
+      steps[arc->axis_1] = lroundf((arc->center[1]+arc->radius*sinf(angle))*settings.steps_per_mm[arc->axis_1]);
+    }
+  }
+
+
+  // Preps the stepper block of the chord ending at mm_remaining from the end of the arc. Each chord but
+  // the first takes the next stepper block. Returns the number of step events, zero if none.
+  static uint32_t st_prep_arc_chord(float mm_remaining)
+  {
+    int32_t steps[N_AXIS];
+    uint32_t chord_steps[N_AXIS];
+    uint32_t step_event_count = 0;
+    uint16_t direction_bits = 0;
+    uint8_t idx;
+    st_arc_position(steps, mm_remaining);
+    for (idx=0; idx<N_AXIS; idx++) {
+      if (steps[idx] < prep.arc_steps[idx]) { direction_bits |= get_direction_pin_mask(idx); }
+      chord_steps[idx] = labs(steps[idx]-prep.arc_steps[idx]);
+      step_event_count = max(step_event_count, chord_steps[idx]);
+    }
+    if (step_event_count == 0) { return(0); }
+
+    if (prep.arc_chord_prepped) {
+      #ifdef VARIABLE_SPINDLE
+        uint8_t is_pwm_rate_adjusted = st_prep_block->is_pwm_rate_adjusted;
+      #endif
+      prep.st_block_index = st_next_block_index(prep.st_block_index);
+      st_prep_block = &st_block_buffer[prep.st_block_index];
+      #ifdef VARIABLE_SPINDLE
+        st_prep_block->is_pwm_rate_adjusted = is_pwm_rate_adjusted;
+      #endif
+    }
+    prep.arc_chord_prepped = true;
+    st_prep_block_load(chord_steps, step_event_count, direction_bits);
+    memcpy(prep.arc_steps, steps, sizeof(steps));
+    return(step_event_count);
+  }
+#endif
+
+
+#ifdef JERK_LIMITED_PROFILES
+  /* Jerk-limited ramps. A ramp from speed_start to speed_end is traced with a symmetric trapezoidal
+     acceleration profile: jerk up, constant acceleration, jerk down. Being point-symmetric, it covers
+     the same distance in the same time as the constant acceleration ramp the planner assumed, so the
+     block's ramp boundaries and exit speed stay exact. For a ramp of time T and speed change dV, the
+     jerk phase time tj follows from dV = J*tj*(T-tj), and the peak acceleration is dV/(T-tj). The
+     planner lowers the block acceleration so that tj fits with the peak within the axis limits, for
+     any ramp up to the programmed speed. Shorter ramps, as after a feed override increase, keep the
+     peak at the limit with tj = T-dV/A, at a higher jerk. Time is normalized as u = t/T over the ramp.
+  */
+  static void st_ramp_setup(float speed_start, float speed_end, float mm_start, float mm_end)
+  {
+    prep.ramp_time = 0.0; // Linear ramp, unless a jerk-limited one applies.
+    float speed_sum = speed_start+speed_end;
+    if ((pl_block->jerk <= 0.0) || (speed_sum <= 0.0) || (mm_start <= mm_end)) { return; }
+    float ramp_time = 2.0*(mm_start-mm_end)/speed_sum;
+    float delta_speed = speed_end-speed_start;
+    float discriminant = ramp_time*ramp_time - 4.0*fabsf(delta_speed)/pl_block->jerk;
+    if (discriminant > 0.0) { prep.ramp_jerk_frac = 0.5*(1.0-sqrtf(discriminant)/ramp_time); }
+    else { prep.ramp_jerk_frac = 0.5; }
+    float jerk_frac_max = 1.0-fabsf(delta_speed)/(pl_block->peak_acceleration*ramp_time); // Peak at the limit
+    if (prep.ramp_jerk_frac > jerk_frac_max) { prep.ramp_jerk_frac = jerk_frac_max; }
+    if (prep.ramp_jerk_frac < 1e-4) { return; } // No measurable speed change. Trace as linear.
+    prep.ramp_time = ramp_time;
+    prep.ramp_elapsed = 0.0;
+    prep.ramp_mm_start = mm_start;
+    prep.ramp_speed_start = speed_start;
+    prep.ramp_delta_speed = delta_speed;
+  }
+
+
+  // Returns the normalized speed change of the first half of the ramp at u (0-0.5) and its
+  // normalized distance integral through area.
+  static float st_ramp_half_profile(float u, float *area)
+  {
+    float r = prep.ramp_jerk_frac;
+    float peak = 1.0/(1.0-r); // Normalized peak acceleration
+    if (u < r) {
+      *area = peak*u*u*u/(6.0*r);
+      return(peak*u*u/(2.0*r));
+    }
+    *area = peak*(r*r/6.0 + 0.5*(u*u-r*r) - 0.5*r*(u-r));
+    return(peak*(u-0.5*r));
+  }
+
+
+  // Advances the jerk-limited ramp by time_var and updates the current speed and mm_remaining.
+  // Returns true, if the ramp ends within time_var, with time_var trimmed to the time left.
+  static uint8_t st_ramp_advance(float *time_var, float *mm_remaining)
+  {
+    float elapsed = prep.ramp_elapsed + *time_var;
+    if (elapsed >= prep.ramp_time) {
+      *time_var = prep.ramp_time - prep.ramp_elapsed;
+      prep.ramp_time = 0.0;
+      return(true);
+    }
+    float u = elapsed/prep.ramp_time;
+    float frac, area;
+    if (u <= 0.5) {
+      frac = st_ramp_half_profile(u, &area);
+    } else { // Second half mirrors the first about the ramp midpoint.
+      frac = 1.0-st_ramp_half_profile(1.0-u, &area);
+      area = u-0.5+area;
+    }
+    prep.current_speed = prep.ramp_speed_start + prep.ramp_delta_speed*frac;
+    *mm_remaining = prep.ramp_mm_start - prep.ramp_time*(prep.ramp_speed_start*u + prep.ramp_delta_speed*area);
+    prep.ramp_elapsed = elapsed;
+    return(false);
   }
 #endif
 
@@ -722,10 +1309,12 @@ static uint8_t st_next_block_index(uint8_t block_index)
    Currently, the segment buffer conservatively holds roughly up to 40-50 msec of steps.
    NOTE: Computation units are in steps, millimeters, and minutes.
 */
-void st_prep_buffer()
+static ITCM_CODE void st_prep_segments()
 {
   // Block step prep buffer, while in a suspend state and there is no suspend motion to execute.
   if (bit_istrue(sys.step_control,STEP_CONTROL_END_MOTION)) { return; }
+  if (segment_buffer_tail == segment_next_head) { return; } // Buffer full. Nothing to prep.
+  PROFILE_START(profile_start);
 
   while (segment_buffer_tail != segment_next_head) { // Check if we need to fill the buffer.
 
@@ -735,7 +1324,8 @@ void st_prep_buffer()
       // Query planner for a queued block
       if (sys.step_control & STEP_CONTROL_EXECUTE_SYS_MOTION) { pl_block = plan_get_system_motion_block(); }
       else { pl_block = plan_get_current_block(); }
-      if (pl_block == NULL) { return; } // No planner blocks. Exit.
+      if (pl_block == NULL) { PROFILE_END(PROFILE_PREP_BUFFER,profile_start); return; } // No planner blocks. Exit.
+      pl_profile = plan_get_block_profile(pl_block);
 
       // Check if we need to only recompute the velocity profile or load a new block.
       if (prep.recalculate_flag & PREP_FLAG_RECALCULATE) {
@@ -756,41 +1346,34 @@ void st_prep_buffer()
         // when the segment buffer completes the planner block, it may be discarded when the
         // segment buffer finishes the prepped block, but the stepper ISR is still executing it.
         st_prep_block = &st_block_buffer[prep.st_block_index];
-        st_prep_block->direction_bits = pl_block->direction_bits;
-        #ifdef ENABLE_DUAL_AXIS
-          #if (DUAL_AXIS_SELECT == X_AXIS)
-            if (st_prep_block->direction_bits & (1<<X_DIRECTION_BIT)) { 
-          #elif (DUAL_AXIS_SELECT == Y_AXIS)
-            if (st_prep_block->direction_bits & (1<<Y_DIRECTION_BIT)) { 
-          #endif
-            st_prep_block->direction_bits_dual = (1<<DUAL_DIRECTION_BIT); 
-          }  else { st_prep_block->direction_bits_dual = 0; }
-        #endif
-        uint8_t idx;
-        #ifndef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-          for (idx=0; idx<N_AXIS; idx++) { st_prep_block->steps[idx] = (pl_block->steps[idx] << 1); }
-          st_prep_block->step_event_count = (pl_block->step_event_count << 1);
-        #else
-          // With AMASS enabled, simply bit-shift multiply all Bresenham data by the max AMASS
-          // level, such that we never divide beyond the original data anywhere in the algorithm.
-          // If the original data is divided, we can lose a step from integer roundoff.
-          for (idx=0; idx<N_AXIS; idx++) { st_prep_block->steps[idx] = pl_block->steps[idx] << MAX_AMASS_LEVEL; }
-          st_prep_block->step_event_count = pl_block->step_event_count << MAX_AMASS_LEVEL;
-        #endif
+        st_prep_block_load(pl_block->steps, pl_block->step_event_count, pl_block->direction_bits);
 
         // Initialize segment buffer data for generating the segments.
         prep.steps_remaining = (float)pl_block->step_event_count;
-        prep.step_per_mm = prep.steps_remaining/pl_block->millimeters;
+        prep.step_per_mm = prep.steps_remaining/pl_profile->millimeters;
+        #ifdef NATIVE_ARCS
+          if (pl_block->arc.radius > 0.0f) {
+            // Arcs are stepped by chords from their start point. The smallest step length of the moving
+            // axes sets the least distance per segment.
+            memcpy(prep.arc_steps, pl_block->arc.start_steps, sizeof(prep.arc_steps));
+            prep.arc_chord_prepped = false;
+            prep.step_per_mm = max(settings.steps_per_mm[pl_block->arc.axis_0], settings.steps_per_mm[pl_block->arc.axis_1]);
+            uint8_t idx;
+            for (idx=0; idx<N_AXIS; idx++) {
+              if (pl_block->steps[idx]) { prep.step_per_mm = max(prep.step_per_mm, settings.steps_per_mm[idx]); }
+            }
+          }
+        #endif
         prep.req_mm_increment = REQ_MM_INCREMENT_SCALAR/prep.step_per_mm;
         prep.dt_remainder = 0.0; // Reset for new segment block
 
         if ((sys.step_control & STEP_CONTROL_EXECUTE_HOLD) || (prep.recalculate_flag & PREP_FLAG_DECEL_OVERRIDE)) {
           // New block loaded mid-hold. Override planner block entry speed to enforce deceleration.
           prep.current_speed = prep.exit_speed;
-          pl_block->entry_speed_sqr = prep.exit_speed*prep.exit_speed;
+          pl_profile->entry_speed_sqr = prep.exit_speed*prep.exit_speed;
           prep.recalculate_flag &= ~(PREP_FLAG_DECEL_OVERRIDE);
         } else {
-          prep.current_speed = sqrt(pl_block->entry_speed_sqr);
+          prep.current_speed = sqrt(pl_profile->entry_speed_sqr);
         }
         
         #ifdef VARIABLE_SPINDLE
@@ -814,16 +1397,19 @@ void st_prep_buffer()
 			 hold, override the planner velocities and decelerate to the target exit speed.
 			*/
 			prep.mm_complete = 0.0; // Default velocity profile complete at 0.0mm from end of block.
-			float inv_2_accel = 0.5/pl_block->acceleration;
+			float inv_2_accel = 0.5/pl_profile->acceleration;
+			#ifdef JERK_LIMITED_PROFILES
+			  prep.ramp_time = 0.0; // Forced and override decelerations are traced linearly.
+			#endif
 			if (sys.step_control & STEP_CONTROL_EXECUTE_HOLD) { // [Forced Deceleration to Zero Velocity]
 				// Compute velocity profile parameters for a feed hold in-progress. This profile overrides
 				// the planner block profile, enforcing a deceleration to zero speed.
 				prep.ramp_type = RAMP_DECEL;
 				// Compute decelerate distance relative to end of block.
-				float decel_dist = pl_block->millimeters - inv_2_accel*pl_block->entry_speed_sqr;
+				float decel_dist = pl_profile->millimeters - inv_2_accel*pl_profile->entry_speed_sqr;
 				if (decel_dist < 0.0) {
 					// Deceleration through entire planner block. End of feed hold is not in this block.
-					prep.exit_speed = sqrt(pl_block->entry_speed_sqr-2*pl_block->acceleration*pl_block->millimeters);
+					prep.exit_speed = sqrt(pl_profile->entry_speed_sqr-2*pl_profile->acceleration*pl_profile->millimeters);
 				} else {
 					prep.mm_complete = decel_dist; // End of feed hold.
 					prep.exit_speed = 0.0;
@@ -831,7 +1417,7 @@ void st_prep_buffer()
 			} else { // [Normal Operation]
 				// Compute or recompute velocity profile parameters of the prepped planner block.
 				prep.ramp_type = RAMP_ACCEL; // Initialize as acceleration ramp.
-				prep.accelerate_until = pl_block->millimeters;
+				prep.accelerate_until = pl_profile->millimeters;
 
 				float exit_speed_sqr;
 				float nominal_speed;
@@ -845,17 +1431,17 @@ void st_prep_buffer()
         nominal_speed = plan_compute_profile_nominal_speed(pl_block);
 				float nominal_speed_sqr = nominal_speed*nominal_speed;
 				float intersect_distance =
-								0.5*(pl_block->millimeters+inv_2_accel*(pl_block->entry_speed_sqr-exit_speed_sqr));
+								0.5*(pl_profile->millimeters+inv_2_accel*(pl_profile->entry_speed_sqr-exit_speed_sqr));
 
-        if (pl_block->entry_speed_sqr > nominal_speed_sqr) { // Only occurs during override reductions.
-          prep.accelerate_until = pl_block->millimeters - inv_2_accel*(pl_block->entry_speed_sqr-nominal_speed_sqr);
+        if (pl_profile->entry_speed_sqr > nominal_speed_sqr) { // Only occurs during override reductions.
+          prep.accelerate_until = pl_profile->millimeters - inv_2_accel*(pl_profile->entry_speed_sqr-nominal_speed_sqr);
           if (prep.accelerate_until <= 0.0) { // Deceleration-only.
             prep.ramp_type = RAMP_DECEL;
-            // prep.decelerate_after = pl_block->millimeters;
+            // prep.decelerate_after = pl_profile->millimeters;
             // prep.maximum_speed = prep.current_speed;
 
             // Compute override block exit speed since it doesn't match the planner exit speed.
-            prep.exit_speed = sqrt(pl_block->entry_speed_sqr - 2*pl_block->acceleration*pl_block->millimeters);
+            prep.exit_speed = sqrt(pl_profile->entry_speed_sqr - 2*pl_profile->acceleration*pl_profile->millimeters);
             prep.recalculate_flag |= PREP_FLAG_DECEL_OVERRIDE; // Flag to load next block as deceleration override.
 
             // TODO: Determine correct handling of parameters in deceleration-only.
@@ -869,35 +1455,54 @@ void st_prep_buffer()
             prep.ramp_type = RAMP_DECEL_OVERRIDE;
           }
 				} else if (intersect_distance > 0.0) {
-					if (intersect_distance < pl_block->millimeters) { // Either trapezoid or triangle types
+					if (intersect_distance < pl_profile->millimeters) { // Either trapezoid or triangle types
 						// NOTE: For acceleration-cruise and cruise-only types, following calculation will be 0.0.
 						prep.decelerate_after = inv_2_accel*(nominal_speed_sqr-exit_speed_sqr);
 						if (prep.decelerate_after < intersect_distance) { // Trapezoid type
 							prep.maximum_speed = nominal_speed;
-							if (pl_block->entry_speed_sqr == nominal_speed_sqr) {
+							if (pl_profile->entry_speed_sqr == nominal_speed_sqr) {
 								// Cruise-deceleration or cruise-only type.
 								prep.ramp_type = RAMP_CRUISE;
 							} else {
 								// Full-trapezoid or acceleration-cruise types
-								prep.accelerate_until -= inv_2_accel*(nominal_speed_sqr-pl_block->entry_speed_sqr);
+								prep.accelerate_until -= inv_2_accel*(nominal_speed_sqr-pl_profile->entry_speed_sqr);
 							}
 						} else { // Triangle type
 							prep.accelerate_until = intersect_distance;
 							prep.decelerate_after = intersect_distance;
-							prep.maximum_speed = sqrt(2.0*pl_block->acceleration*intersect_distance+exit_speed_sqr);
+							prep.maximum_speed = sqrt(2.0*pl_profile->acceleration*intersect_distance+exit_speed_sqr);
 						}
 					} else { // Deceleration-only type
             prep.ramp_type = RAMP_DECEL;
-            // prep.decelerate_after = pl_block->millimeters;
+            // prep.decelerate_after = pl_profile->millimeters;
             // prep.maximum_speed = prep.current_speed;
+            #ifdef JERK_LIMITED_PROFILES
+              st_ramp_setup(prep.current_speed, prep.exit_speed, pl_profile->millimeters, prep.mm_complete);
+            #endif
 					}
 				} else { // Acceleration-only type
 					prep.accelerate_until = 0.0;
 					// prep.decelerate_after = 0.0;
 					prep.maximum_speed = prep.exit_speed;
 				}
+        #ifdef JERK_LIMITED_PROFILES
+          if (prep.ramp_type == RAMP_ACCEL) {
+            st_ramp_setup(prep.current_speed, prep.maximum_speed, pl_profile->millimeters, prep.accelerate_until);
+          }
+        #endif
 			}
       
+      #ifdef NATIVE_ARCS
+        // Shorten the segments of an arc, so that no chord exceeds the arc tolerance at the highest
+        // speed the profile can reach.
+        prep.dt_segment = DT_SEGMENT;
+        if (pl_block->arc.radius > 0.0f) {
+          float speed = plan_compute_profile_nominal_speed(pl_block);
+          if (prep.current_speed > speed) { speed = prep.current_speed; }
+          if (speed*DT_SEGMENT > pl_block->arc.chord) { prep.dt_segment = pl_block->arc.chord/speed; }
+        }
+      #endif
+
       #ifdef VARIABLE_SPINDLE
         bit_true(sys.step_control, STEP_CONTROL_UPDATE_SPINDLE_PWM); // Force update whenever updating block.
       #endif
@@ -923,23 +1528,27 @@ void st_prep_buffer()
       the end of planner block (typical) or mid-block at the end of a forced deceleration,
       such as from a feed hold.
     */
-    float dt_max = DT_SEGMENT; // Maximum segment time
+    #ifdef NATIVE_ARCS
+      float dt_max = prep.dt_segment; // Maximum segment time
+    #else
+      float dt_max = DT_SEGMENT; // Maximum segment time
+    #endif
     float dt = 0.0; // Initialize segment time
     float time_var = dt_max; // Time worker variable
     float mm_var; // mm-Distance worker variable
     float speed_var; // Speed worker variable
-    float mm_remaining = pl_block->millimeters; // New segment distance from end of block.
+    float mm_remaining = pl_profile->millimeters; // New segment distance from end of block.
     float minimum_mm = mm_remaining-prep.req_mm_increment; // Guarantee at least one step.
     if (minimum_mm < 0.0) { minimum_mm = 0.0; }
 
     do {
       switch (prep.ramp_type) {
         case RAMP_DECEL_OVERRIDE:
-          speed_var = pl_block->acceleration*time_var;
+          speed_var = pl_profile->acceleration*time_var;
           if (prep.current_speed-prep.maximum_speed <= speed_var) {
             // Cruise or cruise-deceleration types only for deceleration override.
             mm_remaining = prep.accelerate_until;
-            time_var = 2.0*(pl_block->millimeters-mm_remaining)/(prep.current_speed+prep.maximum_speed);
+            time_var = 2.0*(pl_profile->millimeters-mm_remaining)/(prep.current_speed+prep.maximum_speed);
             prep.ramp_type = RAMP_CRUISE;
             prep.current_speed = prep.maximum_speed;
           } else { // Mid-deceleration override ramp.
@@ -948,17 +1557,34 @@ void st_prep_buffer()
           }
           break;
         case RAMP_ACCEL:
+          #ifdef JERK_LIMITED_PROFILES
+            if (prep.ramp_time > 0.0) {
+              if (st_ramp_advance(&time_var, &mm_remaining)) { // End of acceleration ramp.
+                mm_remaining = prep.accelerate_until;
+                prep.current_speed = prep.maximum_speed;
+                if (mm_remaining == prep.decelerate_after) {
+                  prep.ramp_type = RAMP_DECEL;
+                  st_ramp_setup(prep.maximum_speed, prep.exit_speed, prep.decelerate_after, prep.mm_complete);
+                } else { prep.ramp_type = RAMP_CRUISE; }
+              }
+              break;
+            }
+          #endif
           // NOTE: Acceleration ramp only computes during first do-while loop.
         	// dT = A*dT
-          speed_var = pl_block->acceleration*time_var;
+          speed_var = pl_profile->acceleration*time_var;
           // dX = dX - (0.5*A*dT + V0*dT)
           mm_remaining -= time_var*(prep.current_speed + 0.5*speed_var);
           if (mm_remaining < prep.accelerate_until) { // End of acceleration ramp.
             // Acceleration-cruise, acceleration-deceleration ramp junction, or end of block.
             mm_remaining = prep.accelerate_until; // NOTE: 0.0 at EOB
-            time_var = 2.0*(pl_block->millimeters-mm_remaining)/(prep.current_speed+prep.maximum_speed);
-            if (mm_remaining == prep.decelerate_after) { prep.ramp_type = RAMP_DECEL; }
-            else { prep.ramp_type = RAMP_CRUISE; }
+            time_var = 2.0*(pl_profile->millimeters-mm_remaining)/(prep.current_speed+prep.maximum_speed);
+            if (mm_remaining == prep.decelerate_after) {
+              prep.ramp_type = RAMP_DECEL;
+              #ifdef JERK_LIMITED_PROFILES
+                st_ramp_setup(prep.maximum_speed, prep.exit_speed, prep.decelerate_after, prep.mm_complete);
+              #endif
+            } else { prep.ramp_type = RAMP_CRUISE; }
             prep.current_speed = prep.maximum_speed;
           } else { // Acceleration only.
             prep.current_speed += speed_var;
@@ -974,13 +1600,25 @@ void st_prep_buffer()
             time_var = (mm_remaining - prep.decelerate_after)/prep.maximum_speed;
             mm_remaining = prep.decelerate_after; // NOTE: 0.0 at EOB
             prep.ramp_type = RAMP_DECEL;
+            #ifdef JERK_LIMITED_PROFILES
+              st_ramp_setup(prep.maximum_speed, prep.exit_speed, prep.decelerate_after, prep.mm_complete);
+            #endif
           } else { // Cruising only.
             mm_remaining = mm_var;
           }
           break;
         default: // case RAMP_DECEL:
+          #ifdef JERK_LIMITED_PROFILES
+            if (prep.ramp_time > 0.0) {
+              if (st_ramp_advance(&time_var, &mm_remaining)) { // End of block.
+                mm_remaining = prep.mm_complete;
+                prep.current_speed = prep.exit_speed;
+              }
+              break;
+            }
+          #endif
           // NOTE: mm_var used as a misc worker variable to prevent errors when near zero speed.
-          speed_var = pl_block->acceleration*time_var; // Used as delta speed (mm/min)
+          speed_var = pl_profile->acceleration*time_var; // Used as delta speed (mm/min)
           if (prep.current_speed > speed_var) { // Check if at or below zero speed.
             // Compute distance from end of segment to end of block.
             mm_var = mm_remaining - time_var*(prep.current_speed - 0.5*speed_var); // (mm)
@@ -1042,10 +1680,22 @@ void st_prep_buffer()
        Fortunately, this scenario is highly unlikely and unrealistic in CNC machines
        supported by Grbl (i.e. exceeding 10 meters axis travel at 200 step/mm).
     */
-    float step_dist_remaining = prep.step_per_mm*mm_remaining; // Convert mm_remaining to steps
-    float n_steps_remaining = ceil(step_dist_remaining); // Round-up current steps remaining
-    float last_n_steps_remaining = ceil(prep.steps_remaining); // Round-up last steps remaining
-    prep_segment->n_step = last_n_steps_remaining-n_steps_remaining; // Compute number of steps to execute.
+    float step_dist_remaining, n_steps_remaining, last_n_steps_remaining;
+    #ifdef NATIVE_ARCS
+      if (pl_block->arc.radius > 0.0f) {
+        // Arc chords are exact in steps. No partial step is carried over.
+        prep_segment->n_step = st_prep_arc_chord(mm_remaining);
+        prep_segment->st_block_index = prep.st_block_index;
+        step_dist_remaining = n_steps_remaining = 0.0;
+        last_n_steps_remaining = prep_segment->n_step;
+      } else
+    #endif
+    {
+      step_dist_remaining = prep.step_per_mm*mm_remaining; // Convert mm_remaining to steps
+      n_steps_remaining = ceil(step_dist_remaining); // Round-up current steps remaining
+      last_n_steps_remaining = ceil(prep.steps_remaining); // Round-up last steps remaining
+      prep_segment->n_step = last_n_steps_remaining-n_steps_remaining; // Compute number of steps to execute.
+    }
 
     // Bail if we are at the end of a feed hold and don't have a step to execute.
     if (prep_segment->n_step == 0) {
@@ -1056,8 +1706,21 @@ void st_prep_buffer()
         #ifdef PARKING_ENABLE
           if (!(prep.recalculate_flag & PREP_FLAG_PARKING)) { prep.recalculate_flag |= PREP_FLAG_HOLD_PARTIAL_BLOCK; }
         #endif
+        PROFILE_END(PROFILE_PREP_BUFFER,profile_start);
         return; // Segment not generated, but current step data still retained.
       }
+      #ifdef NATIVE_ARCS
+        if (pl_block->arc.radius > 0.0f) {
+          // Arc chord too short for a step. Its time goes to the next chord, and no segment is generated.
+          prep.dt_remainder += dt;
+          pl_profile->millimeters = mm_remaining;
+          if (mm_remaining == prep.mm_complete) { // End of planner block. Already at its end point.
+            pl_block = NULL;
+            plan_discard_current_block();
+          }
+          continue;
+        }
+      #endif
     }
 
     // Compute segment step rate. Since steps are integers and mm distances traveled are not,
@@ -1110,7 +1773,7 @@ void st_prep_buffer()
     if ( ++segment_next_head == SEGMENT_BUFFER_SIZE ) { segment_next_head = 0; }
 
     // Update the appropriate planner and segment data.
-    pl_block->millimeters = mm_remaining;
+    pl_profile->millimeters = mm_remaining;
     prep.steps_remaining = n_steps_remaining;
     prep.dt_remainder = (n_steps_remaining - step_dist_remaining)*inv_rate;
 
@@ -1125,11 +1788,13 @@ void st_prep_buffer()
         #ifdef PARKING_ENABLE
           if (!(prep.recalculate_flag & PREP_FLAG_PARKING)) { prep.recalculate_flag |= PREP_FLAG_HOLD_PARTIAL_BLOCK; }
         #endif
+        PROFILE_END(PROFILE_PREP_BUFFER,profile_start);
         return; // Bail!
       } else { // End of planner block
         // The planner block is complete. All steps are set to be executed in the segment buffer.
         if (sys.step_control & STEP_CONTROL_EXECUTE_SYS_MOTION) {
           bit_true(sys.step_control,STEP_CONTROL_END_MOTION);
+          PROFILE_END(PROFILE_PREP_BUFFER,profile_start);
           return;
         }
         pl_block = NULL; // Set pointer to indicate check and load next planner block.
@@ -1138,9 +1803,47 @@ void st_prep_buffer()
     }
 
   }
+  PROFILE_END(PROFILE_PREP_BUFFER,profile_start);
+}
+
+
+ITCM_CODE void st_prep_buffer()
+{
+  ST_PREP_LOCK();
+  st_prep_segments();
+  ST_PREP_UNLOCK();
 }
 
 
+#ifdef SEGMENT_PREP_TASK
+  void st_prep_lock()
+  {
+    if (st_prep_mutex_id != NULL) { osRecursiveMutexWait(st_prep_mutex_id, osWaitForever); }
+  }
+
+
+  void st_prep_unlock()
+  {
+    if (st_prep_mutex_id != NULL) { osRecursiveMutexRelease(st_prep_mutex_id); }
+  }
+
+
+  // Segment prep task. Refills the segment buffer whenever the stepper interrupts consume a segment,
+  // in the same states as the realtime state machine of the protocol task.
+  static void st_prep_task(void const *argument)
+  {
+    for (;;) {
+      osSignalWait(ST_PREP_SIGNAL, osWaitForever);
+      st_prep_lock();
+      if (sys.state & (STATE_CYCLE | STATE_HOLD | STATE_SAFETY_DOOR | STATE_HOMING | STATE_SLEEP| STATE_JOG)) {
+        st_prep_segments();
+      }
+      st_prep_unlock();
+    }
+  }
+#endif
+
+
 // Called by realtime status reporting to fetch the current speed being executed. This value
 // however is not exactly the current speed, but the speed computed in the last step segment
 // in the segment buffer. It will always be behind by up to the number of segment blocks (-1)
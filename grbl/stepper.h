@@ -26,6 +26,25 @@
   #define SEGMENT_BUFFER_SIZE 6
 #endif
 
+#ifdef SEGMENT_PREP_TASK
+  // Serializes the protocol task and the segment prep task on the planner and step prep state.
+  // Recursive. Does nothing before the stepper subsystem is initialized.
+  void st_prep_lock();
+  void st_prep_unlock();
+  #define ST_PREP_LOCK()    st_prep_lock()
+  #define ST_PREP_UNLOCK()  st_prep_unlock()
+#else
+  #define ST_PREP_LOCK()
+  #define ST_PREP_UNLOCK()
+#endif
+
+// Returns the number of step segment buffer underruns, i.e. the steppers running out of segments
+// in the middle of a cycle.
+uint32_t st_get_underrun_count();
+
+// Clears the step segment buffer underrun count.
+void st_reset_underrun_count();
+
 // Initialize and setup the stepper motor subsystem
 void stepper_init();
 
@@ -58,4 +77,9 @@ float st_get_realtime_rate();
 
 void _TIM2_IRQHandler(void);
 
+#ifdef STEP_GENERATION_DMA
+  // Refills the DMA step table. Called by DMA2_Stream1_IRQHandler().
+  void _DMA2_Stream1_IRQHandler(void);
+#endif
+
 #endif
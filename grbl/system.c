@@ -121,7 +121,7 @@ void system_execute_startup(char *line)
 // be an issue, since these commands are not typically used during a cycle.
 uint8_t system_execute_line(char *line)
 {
-  uint8_t char_counter = 1;
+  uint32_t char_counter = 1; // Same width as read_float() expects.
   uint8_t helper_var = 0; // Helper variable
   float parameter, value;
   switch( line[char_counter] ) {
@@ -132,6 +132,17 @@ uint8_t system_execute_line(char *line)
       if(line[2] != '=') { return(STATUS_INVALID_STATEMENT); }
       return(gc_execute_line(line)); // NOTE: $J= is ignored inside g-code parser and used to detect jog motions.
       break;
+    #ifdef JOB_STORAGE
+      case 'F' : // Stored job commands. Checks the state by itself, '$FR' may also run in check mode.
+        return(job_execute_line(line));
+    #endif
+    #ifdef ENABLE_CYCLE_PROFILING
+      case 'T' : // Print or reset execution time statistics. Allowed in any state, to sample a running cycle.
+        if ( line[2] == 0 ) { report_profile(); }
+        else if ( (line[2] == 'R') && (line[3] == 0) ) { profile_reset(); }
+        else { return(STATUS_INVALID_STATEMENT); }
+        break;
+    #endif
     case '$': case 'G': case 'C': case 'X':
       if ( line[2] != 0 ) { return(STATUS_INVALID_STATEMENT); }
       switch( line[1] ) {
@@ -249,7 +260,7 @@ uint8_t system_execute_line(char *line)
             // No break. Continues into default: to read remaining command characters.
           }
         default :  // Storing setting methods [IDLE/ALARM]
-          if(!read_float(line, (uint32_t *)&char_counter, &parameter)) { return(STATUS_BAD_NUMBER_FORMAT); }
+          if(!read_float(line, &char_counter, &parameter)) { return(STATUS_BAD_NUMBER_FORMAT); }
           if(line[char_counter++] != '=') { return(STATUS_INVALID_STATEMENT); }
           if (helper_var) { // Store startup line
             // Prepare sending gcode block to gcode parser by shifting all characters
@@ -265,7 +276,7 @@ uint8_t system_execute_line(char *line)
               settings_store_startup_line(helper_var,line);
             }
           } else { // Store global setting.
-            if(!read_float(line, (uint32_t *)&char_counter, &value)) { return(STATUS_BAD_NUMBER_FORMAT); }
+            if(!read_float(line, &char_counter, &value)) { return(STATUS_BAD_NUMBER_FORMAT); }
             if((line[char_counter] != 0) || (parameter > 255)) { return(STATUS_INVALID_STATEMENT); }
             return(settings_store_global_setting((uint8_t)parameter, value));
           }
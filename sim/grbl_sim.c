@@ -0,0 +1,394 @@
+/*
+  grbl_sim.c - host simulator virtual clock, serial input and step trace
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "grbl.h"
+
+void _TIM3_IRQHandler(void);
+
+#define SIM_NEVER  UINT64_MAX
+#define SIM_RX_CHUNK 64 // Bytes per USB OUT packet.
+
+// Virtual clock in ticks of F_TIM. The foreground takes no time, only the interrupts and the
+// millisecond tick reads in HAL_GetTick() let it pass.
+static uint64_t sim_ticks;
+
+static struct {
+  uint32_t period;   // Ticks per update, like ARR+1.
+  uint32_t prescaler;
+  uint8_t enabled;
+  uint64_t next;     // Time of the next update, or SIM_NEVER.
+} step_timer = { .next = SIM_NEVER };
+
+static struct {
+  uint32_t us;
+  uint8_t enabled;
+  uint64_t next;
+  const volatile uint32_t *dma_word; // STEP_PULSE_DMA_RESET: BSRR word the update event writes by DMA.
+} pulse_timer = { .next = SIM_NEVER };
+
+// STEP_GENERATION_DMA: TIM8 requests DMA2 Stream1 every microsecond while both run. Their registers
+// are the plain structs of stm32f7xx_hal.h, written by grbl/stepper.c.
+static struct {
+  const volatile uint32_t *table;
+  uint16_t words;
+  uint64_t next;     // Time of the next request, or SIM_NEVER.
+} step_dma = { .next = SIM_NEVER };
+
+static uint8_t sim_in_isr;
+
+// Step trace and statistics.
+static FILE *trace_file;
+static uint16_t step_port, direction_port;
+static uint32_t steps[N_AXIS];
+static uint64_t last_step[N_AXIS];
+static uint64_t min_step_interval[N_AXIS];
+static uint32_t isr_count, dma_isr_count;
+static uint64_t isr_host_ns_total, isr_host_ns_max;
+static uint64_t dma_isr_host_ns_total, dma_isr_host_ns_max;
+
+// Serial input.
+static uint8_t input_eof;
+static uint8_t input_last;
+static uint32_t lines_fed, lines_answered;
+static uint64_t time_limit = SIM_NEVER;
+
+// Start of the response line in progress, enough to tell 'ok' and 'error:' apart.
+static char response_start[7];
+static uint8_t response_len;
+
+
+uint64_t sim_get_ticks(void) { return(sim_ticks); }
+
+static double sim_ticks_to_us(uint64_t ticks) { return((double)ticks/TICKS_PER_MICROSECOND); }
+
+
+void sim_step_timer_set_period(uint32_t ticks) { step_timer.period = ticks; }
+void sim_step_timer_set_prescaler(uint32_t psc) { step_timer.prescaler = psc; }
+
+// NVIC enable. The counter keeps running meanwhile, see sim_step_timers_reload().
+void sim_step_timer_enable(uint8_t enable)
+{
+  step_timer.enabled = enable;
+  if (!enable) { step_timer.next = SIM_NEVER; }
+  else if (step_timer.next == SIM_NEVER) {
+    step_timer.next = sim_ticks + (uint64_t)step_timer.period*(step_timer.prescaler+1);
+  }
+}
+
+void sim_pulse_timer_set_period(uint32_t us) { pulse_timer.us = us; }
+void sim_pulse_timer_enable(uint8_t enable) { pulse_timer.enabled = enable; }
+
+void sim_pulse_timer_start(uint8_t start)
+{
+  if (start) { pulse_timer.next = sim_ticks + (uint64_t)pulse_timer.us*TICKS_PER_MICROSECOND; }
+  else { pulse_timer.next = SIM_NEVER; }
+}
+
+// TIM8 in one-pulse mode with DMA2 Stream1, see TIM8_StepPulseDMA_Init(). The update event then
+// ends the pulse with a BSRR write of the word, regardless of the NVIC, instead of the interrupt.
+void sim_pulse_timer_dma(const volatile uint32_t *word) { pulse_timer.dma_word = word; }
+
+// Update event. Both counters restart from zero. It ends a pulse through the reset interrupt, but
+// with the DMA the update request is only raised by overflows (URS), so the pulse starts over.
+void sim_step_timers_reload(void)
+{
+  step_timer.next = step_timer.enabled ? sim_ticks + (uint64_t)step_timer.period*(step_timer.prescaler+1) : SIM_NEVER;
+  if (pulse_timer.dma_word && pulse_timer.next != SIM_NEVER) { sim_pulse_timer_start(1); }
+  else { pulse_timer.next = SIM_NEVER; }
+}
+
+static uint8_t sim_pulse_timer_runs(void) { return(pulse_timer.enabled || pulse_timer.dma_word); }
+
+// TIM8 and DMA2 Stream1 set up for the step table, see TIM8_StepDMA_Init().
+void sim_step_dma(const volatile uint32_t *table, uint16_t words)
+{
+  step_dma.table = table;
+  step_dma.words = words;
+}
+
+// Time of the next DMA request. The first comes one timer period after TIM8 and the stream are
+// started, and none while either is stopped.
+static uint64_t sim_step_dma_next(void)
+{
+  if (!step_dma.table || !(TIM8->CR1 & TIM_CR1_CEN) || !(DMA2_Stream1->CR & DMA_SxCR_EN)) {
+    step_dma.next = SIM_NEVER;
+  } else if (step_dma.next == SIM_NEVER) {
+    step_dma.next = sim_ticks + TICKS_PER_MICROSECOND;
+  }
+  return(step_dma.next);
+}
+
+
+static uint64_t sim_host_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return((uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec);
+}
+
+static void sim_trace(void)
+{
+  if (trace_file) {
+    fprintf(trace_file, "%llu %04x %04x\n", (unsigned long long)(sim_ticks*1000/TICKS_PER_MICROSECOND),
+            step_port, direction_port);
+  }
+}
+
+void sim_step_port_write(uint16_t bits)
+{
+  uint16_t rising = bits & ~step_port & STEP_MASK;
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS; idx++) {
+    if (rising & get_step_pin_mask(idx)) {
+      if (steps[idx]) {
+        uint64_t interval = sim_ticks - last_step[idx];
+        if (!min_step_interval[idx] || interval < min_step_interval[idx]) { min_step_interval[idx] = interval; }
+      }
+      last_step[idx] = sim_ticks;
+      steps[idx]++;
+    }
+  }
+  if ((bits & STEP_MASK) != step_port) {
+    step_port = bits & STEP_MASK;
+    sim_trace();
+  }
+}
+
+void sim_direction_port_write(uint16_t bits)
+{
+  if ((bits & DIRECTION_MASK) != direction_port) {
+    direction_port = bits & DIRECTION_MASK;
+    sim_trace();
+  }
+}
+
+// Port write through BSRR: the upper half resets pins, the lower half sets them. The step and
+// direction pins share the port, so a word may change both.
+static void sim_step_port_bsrr(uint32_t word)
+{
+  sim_direction_port_write((direction_port & ~(word >> 16)) | (word & 0xFFFF));
+  sim_step_port_write((step_port & ~(word >> 16)) | (word & 0xFFFF));
+}
+
+// One DMA request: copies the next table word into the port and counts NDTR down, wrapping around.
+// The half and full transfer flags raise the stream interrupt, which clears them through LIFCR.
+static void sim_step_dma_request(void)
+{
+  uint32_t flag = 0;
+  uint64_t start;
+  sim_step_port_bsrr(step_dma.table[step_dma.words - DMA2_Stream1->NDTR]);
+  if (--DMA2_Stream1->NDTR == step_dma.words/2) { flag = DMA_LISR_HTIF1; }
+  else if (DMA2_Stream1->NDTR == 0) {
+    DMA2_Stream1->NDTR = step_dma.words;
+    flag = DMA_LISR_TCIF1;
+  }
+  step_dma.next = sim_ticks + TICKS_PER_MICROSECOND;
+  if (!flag) { return; }
+
+  DMA2->LISR = flag;
+  DMA2->LIFCR = 0;
+  start = sim_host_ns();
+  #ifdef STEP_GENERATION_DMA
+    _DMA2_Stream1_IRQHandler();
+  #endif
+  start = sim_host_ns() - start;
+  dma_isr_host_ns_total += start;
+  if (start > dma_isr_host_ns_max) { dma_isr_host_ns_max = start; }
+  dma_isr_count++;
+  DMA2->LISR &= ~DMA2->LIFCR;
+}
+
+
+// Runs the interrupt or DMA request due next, if due by the given time. The pulse reset goes first at
+// equal times, like the higher priority TIM3 interrupt or the DMA, then the step DMA. Returns 0 if
+// nothing was due.
+static uint8_t sim_run_next_isr(uint64_t until)
+{
+  uint64_t next = step_timer.next;
+  uint64_t dma_next = sim_step_dma_next();
+  if (dma_next <= next) { next = dma_next; }
+  if (sim_pulse_timer_runs() && pulse_timer.next <= next) { next = pulse_timer.next; }
+  if (next == SIM_NEVER || next > until) { return(0); }
+
+  sim_ticks = next;
+  sim_in_isr = 1;
+  if (sim_pulse_timer_runs() && pulse_timer.next == next) {
+    pulse_timer.next = SIM_NEVER;
+    if (pulse_timer.dma_word) { sim_step_port_bsrr(*pulse_timer.dma_word); }
+    else { _TIM3_IRQHandler(); }
+  } else if (dma_next == next) {
+    sim_step_dma_request();
+  } else {
+    uint64_t start = sim_host_ns();
+    uint64_t elapsed;
+    step_timer.next = SIM_NEVER;
+    _TIM2_IRQHandler();
+    elapsed = sim_host_ns() - start;
+    isr_host_ns_total += elapsed;
+    if (elapsed > isr_host_ns_max) { isr_host_ns_max = elapsed; }
+    isr_count++;
+    // The period and prescaler written by the handler take effect from this update on.
+    if (step_timer.enabled && step_timer.next == SIM_NEVER) {
+      step_timer.next = sim_ticks + (uint64_t)step_timer.period*(step_timer.prescaler+1);
+    }
+  }
+  sim_in_isr = 0;
+  return(1);
+}
+
+void sim_run(uint64_t ticks)
+{
+  uint64_t until;
+  if (sim_in_isr) { return; } // Time stands still inside an interrupt.
+  until = sim_ticks + ticks;
+  while (sim_run_next_isr(until));
+  sim_ticks = until;
+}
+
+
+void sim_count_responses(const char *str, int len)
+{
+  while (len--) {
+    char c = *str++;
+    if (c == '\n') {
+      response_start[response_len] = 0;
+      // Messages at power-up or reset, before a line was fed, are no responses.
+      if (lines_answered < lines_fed &&
+          (!strcmp(response_start, "ok\r") || !strncmp(response_start, "error:", 6))) { lines_answered++; }
+      response_len = 0;
+    } else if (response_len < sizeof(response_start)-1) {
+      response_start[response_len++] = c;
+    }
+  }
+}
+
+
+static void sim_print_stats(void)
+{
+  uint8_t idx;
+  fprintf(stderr, "simulated time: %.6f s\n", sim_ticks_to_us(sim_ticks)/1e6);
+  fprintf(stderr, "lines: %u fed, %u answered\n", lines_fed, lines_answered);
+  fprintf(stderr, "step interrupts: %u\n", isr_count);
+  for (idx=0; idx<N_AXIS; idx++) {
+    fprintf(stderr, "axis %u: %u steps, min interval %.3f us\n", idx, steps[idx],
+            sim_ticks_to_us(min_step_interval[idx]));
+  }
+  fprintf(stderr, "segment buffer underruns: %u\n", st_get_underrun_count());
+  if (isr_count) {
+    fprintf(stderr, "host step interrupt time: mean %.0f ns, max %llu ns\n",
+            (double)isr_host_ns_total/isr_count, (unsigned long long)isr_host_ns_max);
+  }
+  if (dma_isr_count) {
+    fprintf(stderr, "step DMA interrupts: %u, host time mean %.0f ns, max %llu ns\n", dma_isr_count,
+            (double)dma_isr_host_ns_total/dma_isr_count, (unsigned long long)dma_isr_host_ns_max);
+  }
+}
+
+static void sim_exit(int status)
+{
+  fflush(stdout);
+  sim_print_stats();
+  if (trace_file) { fclose(trace_file); }
+  exit(status);
+}
+
+
+// Feeds stdin in USB packets while they fit. A missing newline at the end of the input is added, so
+// the last line is executed and answered.
+static uint8_t sim_feed_input(void)
+{
+  uint8_t data[SIM_RX_CHUNK];
+  ssize_t len, idx;
+  if (input_eof || serial_get_rx_buffer_available() < SIM_RX_CHUNK) { return(0); }
+  len = read(STDIN_FILENO, data, SIM_RX_CHUNK);
+  if (len <= 0) {
+    input_eof = 1;
+    if (input_last && input_last != '\n' && input_last != '\r') { data[0] = '\n'; len = 1; }
+    else { return(0); }
+  }
+  for (idx=0; idx<len; idx++) {
+    if (data[idx] == '\n' || data[idx] == '\r') { lines_fed++; }
+    input_last = data[idx];
+  }
+  serial_receive(data, len);
+  return(1);
+}
+
+static uint8_t sim_done(void)
+{
+  if (!input_eof || serial_get_rx_buffer_available() < RX_BUFFER_SIZE) { return(0); }
+  if (lines_answered < lines_fed) { return(0); }
+  if (sys_rt_exec_state || step_timer.enabled) { return(0); }
+  if (sys.state & ~(STATE_ALARM|STATE_CHECK_MODE)) { return(0); }
+  if (plan_get_current_block() != NULL) { return(0); }
+  if (job_is_running()) { return(0); }
+  #ifdef MOTION_QUEUE_SIZE
+    if (mc_get_queue_count()) { return(0); }
+  #endif
+  return(1);
+}
+
+void sim_loop(void)
+{
+  if (sim_in_isr) { return; }
+  #ifdef SIM_TEST
+    return; // The programs in test/ call Grbl directly and end themselves. Nothing is read from stdin.
+  #endif
+  if (sim_feed_input()) { return; } // Let the protocol loop read it first.
+  if (sim_done()) { sim_exit(EXIT_SUCCESS); }
+  if (sim_ticks >= time_limit) {
+    fprintf(stderr, "time limit reached\n");
+    sim_exit(EXIT_FAILURE);
+  }
+  if (!sim_run_next_isr(SIM_NEVER)) { sim_run(1000*TICKS_PER_MICROSECOND); } // Idle, 1ms passes.
+}
+
+
+// The programs in test/ bring their own main(). See the Makefile.
+#ifndef SIM_TEST
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "usage: %s [-t trace_file] [-l time_limit_s] < file.gcode\n", name);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+  int opt;
+  while ((opt = getopt(argc, argv, "t:l:h")) != -1) {
+    switch (opt) {
+      case 't':
+        trace_file = fopen(optarg, "w");
+        if (!trace_file) { perror(optarg); exit(EXIT_FAILURE); }
+        break;
+      case 'l': time_limit = (uint64_t)(atof(optarg)*1e6*TICKS_PER_MICROSECOND); break;
+      default: usage(argv[0]);
+    }
+  }
+  sim_flash_erase();
+
+  grbl_init(); // Never returns. The simulation ends in sim_loop().
+  return(EXIT_FAILURE);
+}
+
+#endif
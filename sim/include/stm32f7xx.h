@@ -0,0 +1,2 @@
+// Host simulator stand-in. See stm32f7xx_hal.h.
+#include "stm32f7xx_hal.h"
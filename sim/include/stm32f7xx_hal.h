@@ -0,0 +1,191 @@
+/*
+  stm32f7xx_hal.h - host simulator stand-in for the STM32F7 HAL
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Only what the grbl/ sources use. Peripherals are plain structs in host memory, so register writes
+// land somewhere harmless, and the HAL calls are stubs in sim_hal.c. The stepper timers and ports are
+// not registers here: the CPU_MAP_CUSTOM_STEPPER block in sim.h routes them to the virtual clock.
+
+#ifndef stm32f7xx_hal_h
+#define stm32f7xx_hal_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define __IO volatile
+
+typedef enum { RESET = 0, SET = !RESET } FlagStatus, ITStatus;
+typedef enum { DISABLE = 0, ENABLE = !DISABLE } FunctionalState;
+typedef enum { HAL_OK = 0x00U, HAL_ERROR = 0x01U, HAL_BUSY = 0x02U, HAL_TIMEOUT = 0x03U } HAL_StatusTypeDef;
+typedef enum { GPIO_PIN_RESET = 0, GPIO_PIN_SET } GPIO_PinState;
+
+typedef enum {
+  EXTI9_5_IRQn = 23,
+  TIM2_IRQn = 28,
+  TIM3_IRQn = 29,
+  EXTI15_10_IRQn = 40,
+  DMA2_Stream1_IRQn = 57
+} IRQn_Type;
+
+typedef struct {
+  __IO uint32_t MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR, BSRR, LCKR, AFR[2];
+} GPIO_TypeDef;
+
+typedef struct {
+  __IO uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR, RCR,
+                CCR1, CCR2, CCR3, CCR4, BDTR, DCR, DMAR, OR, CCMR3, CCR5, CCR6;
+} TIM_TypeDef;
+
+typedef struct {
+  __IO uint32_t CR, NDTR, PAR, M0AR, M1AR, FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+  __IO uint32_t LISR, HISR, LIFCR, HIFCR;
+} DMA_TypeDef;
+
+typedef struct {
+  __IO uint32_t CTRL, CYCCNT;
+} DWT_Type;
+
+extern GPIO_TypeDef sim_gpio[11];
+extern TIM_TypeDef sim_tim[15];
+extern DMA_TypeDef sim_dma2;
+extern DMA_Stream_TypeDef sim_dma2_stream[8];
+
+#define GPIOA  (&sim_gpio[0])
+#define GPIOB  (&sim_gpio[1])
+#define GPIOC  (&sim_gpio[2])
+#define GPIOD  (&sim_gpio[3])
+#define GPIOE  (&sim_gpio[4])
+#define GPIOF  (&sim_gpio[5])
+#define GPIOG  (&sim_gpio[6])
+#define GPIOH  (&sim_gpio[7])
+#define GPIOI  (&sim_gpio[8])
+#define GPIOJ  (&sim_gpio[9])
+#define GPIOK  (&sim_gpio[10])
+#define TIM2   (&sim_tim[2])
+#define TIM3   (&sim_tim[3])
+#define TIM5   (&sim_tim[5])
+#define TIM8   (&sim_tim[8])
+#define TIM10  (&sim_tim[10])
+#define DMA2          (&sim_dma2)
+#define DMA2_Stream1  (&sim_dma2_stream[1])
+
+#define GPIO_PIN_0   ((uint16_t)0x0001)
+#define GPIO_PIN_1   ((uint16_t)0x0002)
+#define GPIO_PIN_2   ((uint16_t)0x0004)
+#define GPIO_PIN_3   ((uint16_t)0x0008)
+#define GPIO_PIN_4   ((uint16_t)0x0010)
+#define GPIO_PIN_5   ((uint16_t)0x0020)
+#define GPIO_PIN_6   ((uint16_t)0x0040)
+#define GPIO_PIN_7   ((uint16_t)0x0080)
+#define GPIO_PIN_8   ((uint16_t)0x0100)
+#define GPIO_PIN_9   ((uint16_t)0x0200)
+#define GPIO_PIN_10  ((uint16_t)0x0400)
+#define GPIO_PIN_11  ((uint16_t)0x0800)
+#define GPIO_PIN_12  ((uint16_t)0x1000)
+#define GPIO_PIN_13  ((uint16_t)0x2000)
+#define GPIO_PIN_14  ((uint16_t)0x4000)
+#define GPIO_PIN_15  ((uint16_t)0x8000)
+
+#define TIM_CR1_CEN    0x0001U
+#define TIM_CR1_URS    0x0004U
+#define TIM_CR1_OPM    0x0008U
+#define TIM_DIER_UDE   0x0100U
+#define TIM_EGR_UG     0x0001U
+#define TIM_CHANNEL_1  0x0000U
+#define TIM_OCMODE_PWM1       0x0060U
+#define TIM_OCPOLARITY_HIGH   0x0000U
+#define TIM_OCFAST_DISABLE    0x0000U
+
+#define DMA_SxCR_EN            0x00000001U
+#define DMA_IT_TC              0x00000010U
+#define DMA_IT_HT              0x00000008U
+#define DMA_MEMORY_TO_PERIPH   0x00000040U
+#define DMA_CIRCULAR           0x00000100U
+#define DMA_MINC_ENABLE        0x00000400U
+#define DMA_PDATAALIGN_WORD    0x00001000U
+#define DMA_MDATAALIGN_WORD    0x00004000U
+#define DMA_PRIORITY_VERY_HIGH 0x00030000U
+#define DMA_CHANNEL_7          0x0E000000U
+#define DMA_LIFCR_CFEIF1       0x00000040U
+#define DMA_LIFCR_CDMEIF1      0x00000100U
+#define DMA_LIFCR_CTEIF1       0x00000200U
+#define DMA_LIFCR_CHTIF1       0x00000400U
+#define DMA_LIFCR_CTCIF1       0x00000800U
+#define DMA_LISR_HTIF1         0x00000400U
+#define DMA_LISR_TCIF1         0x00000800U
+
+typedef struct {
+  uint32_t Prescaler, CounterMode, Period, ClockDivision, RepetitionCounter, AutoReloadPreload;
+} TIM_Base_InitTypeDef;
+
+typedef struct {
+  TIM_TypeDef *Instance;
+  TIM_Base_InitTypeDef Init;
+} TIM_HandleTypeDef;
+
+typedef struct {
+  uint32_t OCMode, Pulse, OCPolarity, OCNPolarity, OCFastMode, OCIdleState, OCNIdleState;
+} TIM_OC_InitTypeDef;
+
+typedef struct { void *Instance; } SPI_HandleTypeDef;
+typedef struct { void *Instance; } ADC_HandleTypeDef;
+
+extern uint32_t SystemCoreClock;
+extern DWT_Type sim_dwt;
+#define DWT (&sim_dwt)
+
+// No interrupts on the host. The simulator calls the handlers between foreground steps, so masking
+// is never needed.
+#define __disable_irq()
+#define __enable_irq()
+#define __get_PRIMASK()   0U
+#define __set_PRIMASK(x)  ((void)(x))
+#define __DSB()
+#define __ISB()
+#define __DMB()
+
+#define __HAL_RCC_TIM8_CLK_ENABLE()
+#define __HAL_RCC_DMA2_CLK_ENABLE()
+#define __HAL_GPIO_EXTI_GET_IT(pin)    RESET
+#define __HAL_GPIO_EXTI_CLEAR_IT(pin)
+#define NVIC_ClearPendingIRQ(irq)      ((void)(irq))
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+uint32_t HAL_RCC_GetPCLK2Freq(void);
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef *htim, TIM_OC_InitTypeDef *sConfig, uint32_t Channel);
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size);
+
+#include "sim.h"
+
+#endif
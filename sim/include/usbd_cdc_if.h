@@ -0,0 +1,12 @@
+// Host simulator stand-in for the USB CDC interface. Output goes to stdout, see sim_hal.c.
+#ifndef __USBD_CDC_IF_H__
+#define __USBD_CDC_IF_H__
+
+#include <stdint.h>
+
+void CDC_send_str (char *str, int len);
+void CDC_send_text (char *text);
+void CDC_send_char (char c);
+void CDC_resume_receive (void);
+
+#endif
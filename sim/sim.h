@@ -0,0 +1,80 @@
+/*
+  sim.h - host simulator virtual clock and step trace
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef sim_h
+#define sim_h
+
+#include <stdint.h>
+
+// Stepper timer and port block of cpu_map.h, selected by CPU_MAP_CUSTOM_STEPPER in config.h. The
+// step timer fires The Stepper Driver Interrupt every period times prescaler ticks of the virtual
+// clock, which counts at F_TIM like TIM2. The pulse timer fires The Stepper Port Reset Interrupt
+// once, the given microseconds after it is started, or with STEP_PULSE_DMA_RESET writes the word
+// given to sim_pulse_timer_dma() to the step port, like the DMA. With STEP_GENERATION_DMA, the table
+// given to sim_step_dma() goes to the step port one word per microsecond while TIM8 and DMA2 Stream1
+// are enabled, and its half and full transfers raise the stream interrupt. Port writes go to the
+// step trace.
+#define StepTimerSetPeriod(ticks)     sim_step_timer_set_period(ticks)
+#define StepTimerSetPrescaler(psc)    sim_step_timer_set_prescaler(psc)
+#define StepTimerEnable()             sim_step_timer_enable(1)
+#define StepTimerDisable()            sim_step_timer_enable(0)
+#define StepPulseTimerSetPeriod(us)   sim_pulse_timer_set_period(us)
+#define StepPulseTimerStart()         sim_pulse_timer_start(1)
+#define StepPulseTimerStop()          sim_pulse_timer_start(0)
+#define StepPulseTimerEnable()        sim_pulse_timer_enable(1)
+#define StepPulseTimerDisable()       sim_pulse_timer_enable(0)
+#define StepTimersReload()            sim_step_timers_reload()
+#define StepPortWrite(bits)           sim_step_port_write(bits)
+#define DirectionPortWrite(bits)      sim_direction_port_write(bits)
+
+void sim_step_timer_set_period(uint32_t ticks);
+void sim_step_timer_set_prescaler(uint32_t psc);
+void sim_step_timer_enable(uint8_t enable);
+void sim_pulse_timer_set_period(uint32_t us);
+void sim_pulse_timer_start(uint8_t start);
+void sim_pulse_timer_enable(uint8_t enable);
+void sim_pulse_timer_dma(const volatile uint32_t *word);
+void sim_step_dma(const volatile uint32_t *table, uint16_t words);
+void sim_step_timers_reload(void);
+void sim_step_port_write(uint16_t bits);
+void sim_direction_port_write(uint16_t bits);
+
+// Called by protocol_execute_realtime(), the point where the foreground waits for anything. Feeds
+// the serial stream from stdin, runs the next timer interrupt due on the virtual clock, and ends the
+// simulation once all input has been answered and the machine is idle.
+void sim_loop(void);
+
+// Runs the virtual clock for a number of ticks, with the timer interrupts falling due meanwhile.
+void sim_run(uint64_t ticks);
+
+// Virtual time in ticks of the step timer clock.
+uint64_t sim_get_ticks(void);
+
+// Counts the responses to lines of the serial stream, sent through CDC_send_str().
+void sim_count_responses(const char *str, int len);
+
+// Erases the DataFlash held in RAM. Settings come up as defaults, as on a new board.
+void sim_flash_erase(void);
+
+// Writes bytes straight into the DataFlash, by byte address, e.g. a layout of older firmware.
+void sim_flash_write(uint32_t address, const void *data, uint32_t size);
+
+// Bytes read from the DataFlash so far. The SPI transfer time on the board follows from it.
+uint32_t sim_flash_read_count(void);
+
+#endif
@@ -0,0 +1,149 @@
+/*
+  sim_hal.c - host simulator peripherals, HAL stubs, USB CDC output and DataFlash
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include "grbl.h"
+#include "gpio.h"
+#include "usbd_cdc_if.h"
+#include "AT45DBXX.h"
+
+uint32_t SystemCoreClock = 216000000;
+
+// Inputs are active low with pull-ups, so all ones reads as no limit, control or probe pin triggered.
+GPIO_TypeDef sim_gpio[11] = {
+  [0 ... 10] = { .IDR = 0xFFFF }
+};
+TIM_TypeDef sim_tim[15];
+DMA_TypeDef sim_dma2;
+DMA_Stream_TypeDef sim_dma2_stream[8];
+DWT_Type sim_dwt;
+
+TIM_HandleTypeDef htim3 = { TIM3 };
+TIM_HandleTypeDef htim5 = { TIM5 };
+TIM_HandleTypeDef htim10 = { TIM10 };
+SPI_HandleTypeDef hspi2;
+
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+  if (PinState == GPIO_PIN_SET) { GPIOx->ODR |= GPIO_Pin; }
+  else { GPIOx->ODR &= ~GPIO_Pin; }
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+  return((GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+}
+
+void GPIO_WritePort(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) { GPIOx->ODR = GPIO_Pin; }
+uint16_t GPIO_ReadPort(GPIO_TypeDef* GPIOx) { return(GPIOx->IDR); }
+
+
+// The millisecond tick follows the virtual clock. Every read lets 10us pass, so busy-wait loops such
+// as delay_ms() move on, with the interrupts falling due meanwhile.
+uint32_t HAL_GetTick(void)
+{
+  sim_run(10*TICKS_PER_MICROSECOND);
+  return((uint32_t)(sim_get_ticks()/(1000*TICKS_PER_MICROSECOND)));
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+  uint32_t tick = HAL_GetTick();
+  while ((HAL_GetTick() - tick) < Delay);
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) { (void)IRQn; }
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn) { (void)IRQn; }
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority) { (void)IRQn; }
+uint32_t HAL_RCC_GetPCLK1Freq(void) { return(SystemCoreClock/4); }
+uint32_t HAL_RCC_GetPCLK2Freq(void) { return(SystemCoreClock/2); }
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim) { return(HAL_OK); }
+HAL_StatusTypeDef HAL_TIM_Base_Stop(TIM_HandleTypeDef *htim) { return(HAL_OK); }
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim) { return(HAL_OK); }
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim) { return(HAL_OK); }
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel) { return(HAL_OK); }
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef *htim, uint32_t Channel) { return(HAL_OK); }
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef *htim, TIM_OC_InitTypeDef *sConfig, uint32_t Channel)
+{
+  htim->Instance->CCR1 = sConfig->Pulse;
+  return(HAL_OK);
+}
+
+// TIM8 and DMA2 Stream1 of Src/tim.c. The virtual pulse timer ends each pulse with the word.
+void TIM8_StepPulseDMA_Init(GPIO_TypeDef *port, uint32_t *bsrr_word)
+{
+  if (port == STEP_PORT) { sim_pulse_timer_dma(bsrr_word); }
+}
+
+// The virtual clock copies the table into the step port while TIM8 and the stream are enabled.
+void TIM8_StepDMA_Init(GPIO_TypeDef *port, uint32_t *table, uint16_t words)
+{
+  if (port == STEP_PORT) { sim_step_dma(table, words); }
+  DMA2_Stream1->NDTR = words;
+}
+
+// Output shift registers on SPI2. Nothing is connected.
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size) { return(HAL_OK); }
+
+
+// USB CDC. Responses go to stdout, and are counted so the simulation knows when all lines are done.
+void CDC_send_str(char *str, int len)
+{
+  fwrite(str, 1, len, stdout);
+  sim_count_responses(str, len);
+}
+
+void CDC_send_text(char *text) { CDC_send_str(text, strlen(text)); }
+void CDC_send_char(char c) { CDC_send_str(&c, 1); }
+void CDC_resume_receive(void) { }
+
+
+// AT45DB DataFlash in RAM, erased at start. Transfers complete at once, so the flash is never busy.
+static uint8_t sim_flash[2048*EEPROM_PAGE_SIZE];
+static uint32_t sim_flash_reads;
+
+void Eeprom_Write_Page_DMA(uint16_t Page, const uint8_t *Data)
+{
+  if (Page < 2048) { memcpy(&sim_flash[(uint32_t)Page*EEPROM_PAGE_SIZE], Data, EEPROM_PAGE_SIZE); }
+}
+
+void Eeprom_Read_DMA(uint32_t Address, uint8_t *Data, uint16_t Length)
+{
+  sim_flash_reads += Length;
+  while (Length--) {
+    *Data++ = (Address < sizeof(sim_flash)) ? sim_flash[Address] : 0xFF;
+    Address++;
+  }
+}
+
+uint8_t Eeprom_Busy(void) { return(0); }
+void Eeprom_Wait(void) { }
+
+void sim_flash_erase(void) { memset(sim_flash, 0xFF, sizeof(sim_flash)); }
+
+uint32_t sim_flash_read_count(void) { return(sim_flash_reads); }
+
+void sim_flash_write(uint32_t address, const void *data, uint32_t size)
+{
+  if (address < sizeof(sim_flash)) {
+    if (size > sizeof(sim_flash)-address) { size = sizeof(sim_flash)-address; }
+    memcpy(&sim_flash[address], data, size);
+  }
+}
@@ -0,0 +1,36 @@
+#!/bin/sh
+#  job_test.sh - a stored job steps exactly like the same program streamed
+#  Part of Grbl
+#
+#  Runs a program streamed, then uploaded with '$FU'/'$FE' and run with '$FR', and compares the
+#  step traces from the first edge on. Run from sim/ by 'make test'.
+
+set -e
+tmp=$(mktemp -d)
+trap 'rm -rf $tmp' EXIT
+
+cat > $tmp/program.nc <<'END'
+G21G91
+G1X10Y5F1000
+G2X10Y0I5J0
+G3X-5Y5R5
+G1X-15Y-10Z1
+G4P0.1
+G0Z-1
+END
+
+# Times relative to the first edge, since the stored run starts after the upload.
+relative() { awk 'NR==1 { t0 = $1 } { printf "%d %s %s\n", $1-t0, $2, $3 }' $1; }
+
+(echo '$X'; cat $tmp/program.nc) | ./grbl_sim -t $tmp/streamed.trace -l 100 > $tmp/streamed.out 2> /dev/null
+(echo '$X'; echo '$FU'; cat $tmp/program.nc; echo '$FE'; echo '$FR') |
+  ./grbl_sim -t $tmp/stored.trace -l 100 > $tmp/stored.out 2> /dev/null
+
+grep -q 'MSG:Job end' $tmp/stored.out
+# Apart from error:7, the settings read failure on the erased flash, all lines must pass.
+if grep -h 'error' $tmp/streamed.out $tmp/stored.out | grep -v 'error:7'; then exit 1; fi
+test -s $tmp/streamed.trace
+relative $tmp/streamed.trace > $tmp/streamed.rel
+relative $tmp/stored.trace > $tmp/stored.rel
+cmp $tmp/streamed.rel $tmp/stored.rel
+echo "job: ok, $(wc -l < $tmp/stored.rel) edges match" >&2
@@ -0,0 +1,181 @@
+/*
+  number_test.c - g-code number reading, checked and timed on the host over a CAM-like program
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <time.h>
+#include "grbl.h"
+#include "test.h"
+
+#define CORPUS_LINES 2000
+#define CORPUS_WORDS (5*CORPUS_LINES)
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return((uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec);
+}
+
+// read_float() of Grbl 1.1h, and the integer part and hundredths that gc_execute_line() then took
+// from the float for every word. The reference for the timing.
+static uint8_t read_number_1_1h(char *line, uint32_t *char_counter, float *float_ptr, int32_t *int_ptr, uint16_t *mantissa_ptr)
+{
+  char *ptr = line + *char_counter;
+  unsigned char c = *ptr++;
+  bool isnegative = false;
+  if (c == '-') {
+    isnegative = true;
+    c = *ptr++;
+  } else if (c == '+') {
+    c = *ptr++;
+  }
+  uint32_t intval = 0;
+  int8_t exp = 0;
+  uint8_t ndigit = 0;
+  bool isdecimal = false;
+  while(1) {
+    c -= '0';
+    if (c <= 9) {
+      ndigit++;
+      if (ndigit <= 8) {
+        if (isdecimal) { exp--; }
+        intval = (((intval << 2) + intval) << 1) + c;
+      } else {
+        if (!(isdecimal)) { exp++; }
+      }
+    } else if (c == (('.'-'0') & 0xff)  &&  !(isdecimal)) {
+      isdecimal = true;
+    } else {
+      break;
+    }
+    c = *ptr++;
+  }
+  if (!ndigit) { return(false); };
+  float fval = (float)intval;
+  if (fval != 0) {
+    while (exp <= -2) {
+      fval *= 0.01;
+      exp += 2;
+    }
+    if (exp < 0) {
+      fval *= 0.1;
+    } else if (exp > 0) {
+      do {
+        fval *= 10.0;
+      } while (--exp > 0);
+    }
+  }
+  *float_ptr = isnegative ? -fval : fval;
+  *char_counter = ptr - line - 1;
+
+  *int_ptr = (int)truncf(*float_ptr);
+  *mantissa_ptr = (uint16_t)lroundf(100 * (*float_ptr - (float)*int_ptr));
+  return(true);
+}
+
+
+// Word values of a CAM-like program: G1 moves with three coordinates to 4 decimals, as posts write
+// them for millimeters, a feed rate and a line number. A small linear congruential generator keeps
+// the program the same on every run.
+static char corpus[CORPUS_WORDS][16];
+
+static void make_corpus(void)
+{
+  uint32_t seed = 12345;
+  uint16_t n, idx;
+  for (n=0; n<CORPUS_LINES; n++) {
+    snprintf(corpus[5*n], sizeof(corpus[0]), "%u", n+10);
+    for (idx=1; idx<4; idx++) {
+      seed = seed*1103515245 + 12345;
+      snprintf(corpus[5*n+idx], sizeof(corpus[0]), "%.4f", (float)((int32_t)(seed >> 8) % 4000000)/10000.0f-200.0f);
+    }
+    seed = seed*1103515245 + 12345;
+    snprintf(corpus[5*n+4], sizeof(corpus[0]), "%u", 500+(seed >> 8) % 2500);
+  }
+}
+
+
+// Values correctly rounded, like strtof(), for up to 7 significant digits. The integer part and the
+// hundredths come from the digits. Also counts the values of the 1.1h reference that are off.
+static void test_values(void)
+{
+  uint16_t off_1_1h = 0;
+  float value;
+  int32_t int_value;
+  uint16_t mantissa;
+  uint32_t char_counter;
+  uint16_t idx;
+  char *dot;
+  for (idx=0; idx<CORPUS_WORDS; idx++) {
+    char_counter = 0;
+    CHECK(read_number(corpus[idx], &char_counter, &value, &int_value, &mantissa));
+    CHECK(char_counter == strlen(corpus[idx]));
+    CHECK(value == strtof(corpus[idx], NULL));
+    CHECK(int_value == strtol(corpus[idx], NULL, 10));
+    dot = strchr(corpus[idx], '.');
+    CHECK(mantissa == (dot ? (atoi(dot+1)+50)/100 : 0));
+    char_counter = 0;
+    read_number_1_1h(corpus[idx], &char_counter, &value, &int_value, &mantissa);
+    if (value != strtof(corpus[idx], NULL)) { off_1_1h++; }
+  }
+  fprintf(stderr, "read_number: %u values exact, 1.1h read_float: %u off\n", CORPUS_WORDS, off_1_1h);
+}
+
+
+static volatile float sink; // Keeps the values read, so the timed loops are not optimized out.
+
+// Host time of the whole corpus. Best of some rounds.
+static uint64_t time_corpus(uint8_t (*read)(char *, uint32_t *, float *, int32_t *, uint16_t *))
+{
+  uint64_t start, elapsed, best = UINT64_MAX;
+  float value;
+  int32_t int_value;
+  uint16_t mantissa;
+  uint32_t char_counter;
+  uint16_t idx;
+  uint8_t round;
+  for (round=0; round<20; round++) {
+    start = host_ns();
+    for (idx=0; idx<CORPUS_WORDS; idx++) {
+      char_counter = 0;
+      read(corpus[idx], &char_counter, &value, &int_value, &mantissa);
+      sink = value + int_value + mantissa;
+    }
+    elapsed = host_ns()-start;
+    if (elapsed < best) { best = elapsed; }
+  }
+  return(best);
+}
+
+static void test_throughput(void)
+{
+  uint64_t new_ns = time_corpus(read_number);
+  uint64_t old_ns = time_corpus(read_number_1_1h);
+  fprintf(stderr, "read_number: %.1f M words/s, 1.1h read_float with truncf/lroundf: %.1f M words/s (%u words)\n",
+          1e3*CORPUS_WORDS/new_ns, 1e3*CORPUS_WORDS/old_ns, CORPUS_WORDS);
+}
+
+
+int main(void)
+{
+  make_corpus();
+  test_values();
+  test_throughput();
+  fprintf(stderr, "number: ok\n");
+  return(EXIT_SUCCESS);
+}
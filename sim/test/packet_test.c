@@ -0,0 +1,265 @@
+/*
+  packet_test.c - binary motion packets: payload checks, and throughput against text g-code
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "grbl.h"
+#include "test.h"
+
+#define BATCH 100 // Motions per batch. With the parse-ahead queue they all fit, so nothing waits.
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return((uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec);
+}
+
+// Responses go to stdout, redirected to a file so they can be read back.
+static void capture_responses(void)
+{
+  FILE *file = tmpfile();
+  CHECK(file != NULL);
+  fflush(stdout);
+  CHECK(dup2(fileno(file), STDOUT_FILENO) == STDOUT_FILENO);
+}
+
+// Returns the responses since the last call.
+static const char *take_responses(void)
+{
+  static char text[4096];
+  ssize_t len;
+  fflush(stdout);
+  len = pread(STDOUT_FILENO, text, sizeof(text)-1, 0);
+  text[len > 0 ? len : 0] = 0;
+  CHECK(ftruncate(STDOUT_FILENO, 0) == 0);
+  lseek(STDOUT_FILENO, 0, SEEK_SET);
+  return(text);
+}
+
+static uint8_t packet_seq; // Sequence of the next packet sent
+
+// Default settings, unlocked and idle, with an empty planner and the parser at the origin.
+static void reset_machine(void)
+{
+  sim_flash_erase();
+  settings_init();
+  memset(&sys, 0, sizeof(sys));
+  sys.f_override = DEFAULT_FEED_OVERRIDE;
+  sys.r_override = DEFAULT_RAPID_OVERRIDE;
+  sys.spindle_speed_ovr = DEFAULT_SPINDLE_SPEED_OVERRIDE;
+  gc_init();
+  plan_reset();
+  mc_queue_clear();
+  st_reset();
+  plan_sync_position();
+  gc_sync_position();
+  packet_reset();
+  packet_seq = 0;
+  take_responses(); // The settings reset reports.
+}
+
+// Empties the planner and the parse-ahead queue between batches, keeping the parser position.
+static void drain_planner(void)
+{
+  plan_reset_buffer();
+  mc_queue_clear();
+}
+
+#define FRAME_MAX (4+255+2)
+
+// Frames a packet into frame[]. Returns the frame length.
+static uint16_t build_frame(uint8_t *frame, uint8_t type, const void *payload, uint8_t size)
+{
+  uint16_t crc = 0xFFFF;
+  uint16_t idx;
+  uint8_t bit;
+  frame[0] = PACKET_START;
+  frame[1] = size+2;
+  frame[2] = packet_seq++;
+  frame[3] = type;
+  memcpy(&frame[4], payload, size);
+  for (idx=1; idx<(uint16_t)size+4; idx++) {
+    crc ^= (uint16_t)frame[idx] << 8;
+    for (bit=0; bit<8; bit++) { crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1; }
+  }
+  frame[size+4] = crc & 0xFF;
+  frame[size+5] = crc >> 8;
+  return(size+6);
+}
+
+// Reads a frame and executes it, as the protocol loop does once the frame is complete.
+static void feed_frame(const uint8_t *frame, uint16_t len)
+{
+  uint16_t idx;
+  for (idx=0; idx<len; idx++) {
+    if (packet_read(frame[idx])) { packet_execute(); }
+  }
+}
+
+static void send_packet(uint8_t type, const void *payload, uint8_t size)
+{
+  uint8_t frame[FRAME_MAX];
+  feed_frame(frame, build_frame(frame, type, payload, size));
+}
+
+static uint16_t build_line_frame(uint8_t *frame, float feed_rate, const float *target)
+{
+  uint8_t payload[5+4*N_AXIS] = { 0 };
+  memcpy(&payload[1], &feed_rate, sizeof(float));
+  memcpy(&payload[5], target, sizeof(float)*N_AXIS);
+  return(build_frame(frame, PACKET_LINE, payload, sizeof(payload)));
+}
+
+static void send_line_packet(float feed_rate, const float *target)
+{
+  uint8_t frame[FRAME_MAX];
+  feed_frame(frame, build_line_frame(frame, feed_rate, target));
+}
+
+static void send_float_packet(uint8_t type, uint8_t first, float value)
+{
+  uint8_t payload[5] = { first };
+  memcpy(&payload[type == PACKET_DWELL ? 0 : 1], &value, sizeof(float));
+  send_packet(type, payload, type == PACKET_DWELL ? 4 : 5);
+}
+
+// Filters a text line into the line buffer, as protocol_main_loop() does character by character,
+// then executes it and reports the status.
+static void execute_text_line(const char *text)
+{
+  char line[LINE_BUFFER_SIZE];
+  uint8_t char_counter = 0;
+  char c;
+  while ((c = *text++)) {
+    if (c <= ' ') { continue; }
+    line[char_counter++] = (c >= 'a' && c <= 'z') ? c-'a'+'A' : c;
+  }
+  line[char_counter] = 0;
+  report_status_message(gc_execute_line(line));
+}
+
+// Point n of a CAM-like path: short moves that keep turning, so none are merged.
+static void path_point(uint16_t n, float *target)
+{
+  memset(target, 0, sizeof(float)*N_AXIS);
+  target[X_AXIS] = 0.2f*n;
+  target[Y_AXIS] = (n & 1) ? 0.05f : 0.0f;
+  target[Z_AXIS] = -0.01f*(n % 5);
+}
+
+
+// Non-finite numbers and negative dwells or spindle speeds are rejected before anything moves.
+static void test_payload_checks(void)
+{
+  float target[N_AXIS] = { 0.0f };
+  reset_machine();
+
+  target[X_AXIS] = NAN;
+  send_line_packet(1000.0f, target);
+  CHECK(strstr(take_responses(), "[PKT:ERR,0,2]") != NULL); // STATUS_BAD_NUMBER_FORMAT
+  target[X_AXIS] = INFINITY;
+  send_line_packet(1000.0f, target);
+  CHECK(strstr(take_responses(), "[PKT:ERR,1,2]") != NULL);
+  target[X_AXIS] = 1.0f;
+  send_line_packet(INFINITY, target);
+  CHECK(strstr(take_responses(), "[PKT:ERR,2,2]") != NULL);
+  CHECK(plan_get_block_buffer_count() == 0);
+  CHECK(gc_state.position[X_AXIS] == 0.0f);
+
+  send_float_packet(PACKET_SPINDLE, 1, -100.0f);
+  CHECK(strstr(take_responses(), "[PKT:ERR,3,4]") != NULL); // STATUS_NEGATIVE_VALUE
+  send_float_packet(PACKET_SPINDLE, 1, NAN);
+  CHECK(strstr(take_responses(), "[PKT:ERR,4,2]") != NULL);
+  CHECK(gc_state.spindle_speed == 0.0f);
+  send_float_packet(PACKET_DWELL, 0, -1.0f);
+  CHECK(strstr(take_responses(), "[PKT:ERR,5,4]") != NULL);
+  send_float_packet(PACKET_DWELL, 0, NAN);
+  CHECK(strstr(take_responses(), "[PKT:ERR,6,2]") != NULL);
+
+  send_line_packet(1000.0f, target); // A valid motion still goes through.
+  CHECK(strstr(take_responses(), "[PKT:ACK,7]") != NULL);
+  CHECK(plan_get_block_buffer_count() == 1);
+}
+
+
+// The same motions as text lines through the g-code parser, and as line packets read byte by byte.
+// Both plan the same blocks and send their responses: an ok per line, and an ACK per PACKET_ACK_BATCH
+// packets, as while a host streams and more data is waiting. The host time per motion includes the
+// planner. Lines and frames are built before the clock starts.
+static void test_throughput(void)
+{
+  static char lines[BATCH][64];
+  static uint8_t frames[BATCH][FRAME_MAX];
+  static uint16_t frame_len[BATCH];
+  float target[N_AXIS];
+  uint64_t start, text_ns = UINT64_MAX, packet_ns = UINT64_MAX;
+  uint32_t text_steps, packet_steps;
+  uint16_t n;
+  uint8_t round;
+  plan_block_t *block;
+
+  for (round=0; round<20; round++) {
+    reset_machine();
+    for (n=0; n<BATCH; n++) {
+      path_point(n+1, target);
+      snprintf(lines[n], sizeof(lines[n]), "G1 X%.3f Y%.3f Z%.3f F1000", target[X_AXIS], target[Y_AXIS], target[Z_AXIS]);
+    }
+    start = host_ns();
+    for (n=0; n<BATCH; n++) { execute_text_line(lines[n]); }
+    if (host_ns()-start < text_ns) { text_ns = host_ns()-start; }
+    text_steps = 0;
+    for (block = plan_get_current_block(), n = plan_get_block_buffer_count(); n; n--, block++) {
+      text_steps += block->step_event_count;
+    }
+    CHECK(text_steps > 0);
+    CHECK(strstr(take_responses(), "error") == NULL);
+
+    reset_machine();
+    for (n=0; n<BATCH; n++) {
+      path_point(n+1, target);
+      frame_len[n] = build_line_frame(frames[n], 1000.0f, target);
+    }
+    serial_receive((uint8_t *)"\n", 1); // Data waiting
+    start = host_ns();
+    for (n=0; n<BATCH; n++) { feed_frame(frames[n], frame_len[n]); }
+    if (host_ns()-start < packet_ns) { packet_ns = host_ns()-start; }
+    serial_reset_read_buffer();
+    packet_steps = 0;
+    for (block = plan_get_current_block(), n = plan_get_block_buffer_count(); n; n--, block++) {
+      packet_steps += block->step_event_count;
+    }
+    CHECK(packet_steps == text_steps);
+    CHECK(strstr(take_responses(), "ERR") == NULL);
+    drain_planner();
+  }
+  fprintf(stderr, "throughput: text %llu ns per line (%.0f lines/s), packets %llu ns per line (%.0f lines/s)\n",
+          (unsigned long long)(text_ns/BATCH), 1e9*BATCH/text_ns,
+          (unsigned long long)(packet_ns/BATCH), 1e9*BATCH/packet_ns);
+}
+
+
+int main(void)
+{
+  capture_responses();
+  test_payload_checks();
+  test_throughput();
+  fprintf(stderr, "packet: ok\n");
+  return(EXIT_SUCCESS);
+}
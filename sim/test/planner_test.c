@@ -0,0 +1,159 @@
+/*
+  planner_test.c - planner replans on override changes, checked and timed on the host
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <time.h>
+#include "grbl.h"
+#include "test.h"
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return((uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec);
+}
+
+// Default settings and an empty planner, as after power up. Nothing executes, so the buffer stays
+// as filled.
+static void reset_planner(void)
+{
+  sim_flash_erase();
+  settings_init();
+  memset(&sys, 0, sizeof(sys));
+  sys.f_override = DEFAULT_FEED_OVERRIDE;
+  sys.r_override = DEFAULT_RAPID_OVERRIDE;
+  plan_reset();
+  st_reset();
+  plan_sync_position();
+}
+
+// Fills the planner with a CAM-like path: 0.5 mm segments turning by 0 to 60 degrees, so some
+// junctions limit the entry speeds and others leave them to the feed rate.
+static void fill_planner(void)
+{
+  plan_line_data_t pl_data;
+  float target[N_AXIS] = { 0.0f };
+  float angle = 0.0f;
+  uint16_t n = 0;
+  memset(&pl_data, 0, sizeof(pl_data));
+  pl_data.feed_rate = 3000.0f;
+  while (!plan_check_full_buffer()) {
+    angle += (float)((n*3) % 7)*(10.0f*M_PI/180.0f);
+    target[X_AXIS] += 0.5f*cosf(angle);
+    target[Y_AXIS] += 0.5f*sinf(angle);
+    CHECK(plan_buffer_line(target, &pl_data) == PLAN_OK);
+    n++;
+  }
+}
+
+// Entry speeds of the buffered blocks. The buffer starts at index 0 after plan_reset().
+static uint16_t get_entry_speeds(float *entry_speed_sqr)
+{
+  plan_block_t *block = plan_get_current_block();
+  uint16_t count = plan_get_block_buffer_count();
+  uint16_t idx;
+  for (idx=0; idx<count; idx++) {
+    plan_profile_t *profile = plan_get_block_profile(block+idx);
+    CHECK(profile->entry_speed_sqr <= profile->max_entry_speed_sqr*1.0001f);
+    entry_speed_sqr[idx] = profile->entry_speed_sqr;
+  }
+  return(count);
+}
+
+// Host time of one override change, as protocol_exec_rt_system() applies it.
+static uint64_t set_feed_override(uint8_t f_override)
+{
+  uint64_t start = host_ns();
+  sys.f_override = f_override;
+  plan_update_velocity_profile_parameters();
+  return(host_ns()-start);
+}
+
+// A knob turned down in 1% steps only lowers speed limits, so each step replans from the buffer tail
+// to the last block with a new limit. Turned back up, it replans from the newest block, as every
+// override change did before. Both must end in the same plan. Times are the best of some rounds.
+static void test_override_replan(void)
+{
+  static float lowered[BLOCK_BUFFER_SIZE], raised[BLOCK_BUFFER_SIZE];
+  uint64_t down_ns, up_ns, best_down_ns = UINT64_MAX, best_up_ns = UINT64_MAX;
+  uint16_t count, idx;
+  uint8_t round, f_override;
+  reset_planner();
+  fill_planner();
+  set_feed_override(10); // The appended plan only covers the newest blocks. Start from a full replan.
+  set_feed_override(100);
+
+  for (round=0; round<20; round++) {
+    down_ns = up_ns = 0;
+    for (f_override=99; f_override>=50; f_override--) { down_ns += set_feed_override(f_override); }
+    count = get_entry_speeds(lowered);
+    set_feed_override(10);
+    for (f_override=11; f_override<=50; f_override++) { up_ns += set_feed_override(f_override); }
+    CHECK(get_entry_speeds(raised) == count);
+    for (idx=0; idx<count; idx++) {
+      CHECK(fabsf(lowered[idx]-raised[idx]) <= 1e-4f*raised[idx]+1e-3f);
+    }
+    set_feed_override(100);
+    if (down_ns < best_down_ns) { best_down_ns = down_ns; }
+    if (up_ns < best_up_ns) { best_up_ns = up_ns; }
+  }
+  fprintf(stderr, "override, %u blocks: %llu ns per step down, %llu ns per step up (whole buffer)\n",
+          count, (unsigned long long)(best_down_ns/50), (unsigned long long)(best_up_ns/40));
+}
+
+
+// Streams collinear 0.05 mm segments at the maximum rate into a full buffer, a block out for a block
+// in. The deceleration to the end of the buffer then spans more blocks than PLANNER_RECALC_MAX_BLOCKS,
+// so each new block replans the whole look-ahead limit.
+static void test_append_replan(void)
+{
+  plan_line_data_t pl_data;
+  float target[N_AXIS] = { 0.0f };
+  uint64_t start, elapsed, best_ns = UINT64_MAX;
+  uint16_t n;
+  uint8_t round;
+  reset_planner();
+  memset(&pl_data, 0, sizeof(pl_data));
+  pl_data.feed_rate = 6000.0f;
+  while (!plan_check_full_buffer()) {
+    target[X_AXIS] += 0.05f;
+    CHECK(plan_buffer_line(target, &pl_data) == PLAN_OK);
+  }
+  for (round=0; round<20; round++) {
+    start = host_ns();
+    for (n=0; n<1000; n++) {
+      plan_discard_current_block();
+      target[X_AXIS] += 0.05f;
+      plan_buffer_line(target, &pl_data);
+    }
+    elapsed = host_ns()-start;
+    if (elapsed < best_ns) { best_ns = elapsed; }
+  }
+  CHECK(plan_check_full_buffer());
+  fprintf(stderr, "append, %u blocks: %llu ns per block\n", plan_get_block_buffer_count(),
+          (unsigned long long)(best_ns/1000));
+}
+
+
+int main(void)
+{
+  test_override_replan();
+  test_append_replan();
+  fprintf(stderr, "planner: ok\n");
+  return(EXIT_SUCCESS);
+}
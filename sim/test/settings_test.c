@@ -0,0 +1,276 @@
+/*
+  settings_test.c - settings migration from older firmware, corruption detection and load time
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <time.h>
+#include "grbl.h"
+#include "test.h"
+
+// SPI1 clock of the DataFlash: PCLK2 108 MHz / 16, see Src/spi.c.
+#define SPI1_HZ 6750000.0
+
+uint8_t read_global_settings(); // Not in settings.h, only called by settings_init().
+
+// Global settings of version 10 as Grbl 1.1h stored them: 8 axes, no jerk and no planner depth.
+typedef struct {
+  float steps_per_mm[8];
+  float max_rate[8];
+  float acceleration[8];
+  float max_travel[8];
+  uint8_t pulse_microseconds;
+  uint8_t step_invert_mask;
+  uint8_t dir_invert_mask;
+  uint8_t stepper_idle_lock_time;
+  uint8_t status_report_mask;
+  float junction_deviation;
+  float arc_tolerance;
+  float rpm_max;
+  float rpm_min;
+  uint8_t flags;
+  uint8_t homing_dir_mask;
+  float homing_feed_rate;
+  float homing_seek_rate;
+  uint16_t homing_debounce_delay;
+  float homing_pulloff;
+} legacy_settings_t;
+
+// Checksum byte of Grbl 1.1h, with its logical OR.
+static uint8_t legacy_checksum(const uint8_t *data, uint32_t size)
+{
+  uint8_t checksum = 0;
+  while (size--) { checksum = (checksum != 0) + *data++; }
+  return(checksum);
+}
+
+// Writes a record behind a Grbl 1.1h checksum byte, at its address in the old page layout.
+static void write_legacy_record(uint32_t address, const void *data, uint32_t size)
+{
+  uint8_t checksum = legacy_checksum(data, size);
+  sim_flash_write(address, data, size);
+  sim_flash_write(address+size, &checksum, 1);
+}
+
+static void flush_eeprom(void)
+{
+  while (eeprom_flush());
+}
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return((uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec);
+}
+
+// Current settings at their defaults, written back to the flash store.
+static void default_settings(void)
+{
+  sim_flash_erase();
+  settings_init();
+  settings_restore(SETTINGS_RESTORE_ALL);
+  flush_eeprom();
+}
+
+static void legacy_settings(legacy_settings_t *legacy)
+{
+  uint8_t idx;
+  memset(legacy, 0, sizeof(legacy_settings_t));
+  for (idx=0; idx<8; idx++) {
+    legacy->steps_per_mm[idx] = 100.0f+idx;
+    legacy->max_rate[idx] = 2000.0f+idx;
+    legacy->acceleration[idx] = 30.0f+idx;
+    legacy->max_travel[idx] = -300.0f-idx;
+  }
+  legacy->pulse_microseconds = 7;
+  legacy->dir_invert_mask = 0x05;
+  legacy->junction_deviation = 0.02f;
+  legacy->rpm_max = 24000.0f;
+  legacy->flags = BITFLAG_HOMING_ENABLE;
+  legacy->homing_feed_rate = 50.0f;
+  legacy->homing_debounce_delay = 100;
+  legacy->homing_pulloff = 2.5f;
+}
+
+static void check_legacy_settings(const legacy_settings_t *legacy)
+{
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS; idx++) {
+    CHECK(settings.steps_per_mm[idx] == legacy->steps_per_mm[idx]);
+    CHECK(settings.max_rate[idx] == legacy->max_rate[idx]);
+    CHECK(settings.acceleration[idx] == legacy->acceleration[idx]);
+    CHECK(settings.max_travel[idx] == legacy->max_travel[idx]);
+  }
+  CHECK(settings.jerk[X_AXIS] == DEFAULT_X_JERK);
+  CHECK(settings.pulse_microseconds == legacy->pulse_microseconds);
+  CHECK(settings.dir_invert_mask == legacy->dir_invert_mask);
+  CHECK(settings.junction_deviation == legacy->junction_deviation);
+  CHECK(settings.rpm_max == legacy->rpm_max);
+  CHECK(settings.flags == legacy->flags);
+  CHECK(settings.homing_feed_rate == legacy->homing_feed_rate);
+  CHECK(settings.homing_debounce_delay == legacy->homing_debounce_delay);
+  CHECK(settings.homing_pulloff == legacy->homing_pulloff);
+  CHECK(settings.planner_blocks == DEFAULT_PLANNER_BLOCKS);
+}
+
+// G55 and the first startup line as Grbl 1.1h stored them.
+static const float legacy_g55[8] = { 10.5f, -20.25f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f };
+static const char legacy_line[LINE_BUFFER_SIZE] = "G21G90";
+
+static void check_legacy_records(void)
+{
+  float coord_data[N_AXIS];
+  char line[LINE_BUFFER_SIZE];
+  CHECK(settings_read_coord_data(1, coord_data));
+  CHECK(memcmp(coord_data, legacy_g55, sizeof(coord_data)) == 0);
+  CHECK(settings_read_coord_data(0, coord_data)); // G54 failed its checksum and was reset.
+  CHECK(coord_data[X_AXIS] == 0.0f);
+  CHECK(settings_read_startup_line(0, line));
+  CHECK(strcmp(line, legacy_line) == 0);
+}
+
+// Version 10 settings survive the upgrade and are stored again as a current image. The other records
+// get the current checksum.
+static void test_migrate_legacy(void)
+{
+  legacy_settings_t legacy;
+  uint8_t version = SETTINGS_VERSION_LEGACY;
+  uint8_t garbage = 0x5A;
+
+  sim_flash_erase();
+  legacy_settings(&legacy);
+  sim_flash_write(EEPROM_ADDR_VERSION, &version, 1);
+  write_legacy_record(EEPROM_ADDR_GLOBAL, &legacy, sizeof(legacy));
+  write_legacy_record(EEPROM_ADDR_PARAMETERS+1*(sizeof(legacy_g55)+1), legacy_g55, sizeof(legacy_g55));
+  write_legacy_record(EEPROM_ADDR_STARTUP_BLOCK, legacy_line, LINE_BUFFER_SIZE);
+  sim_flash_write(EEPROM_ADDR_PARAMETERS+sizeof(legacy_g55), &garbage, 1);
+
+  settings_init();
+  check_legacy_settings(&legacy);
+  check_legacy_records();
+  CHECK(eeprom_get_char(EEPROM_ADDR_VERSION) == SETTINGS_VERSION);
+
+  flush_eeprom();
+  memset(&settings, 0, sizeof(settings));
+  settings_init(); // Power cycle.
+  check_legacy_settings(&legacy);
+  check_legacy_records();
+}
+
+// A version 10 record failing its checksum falls back to the defaults.
+static void test_migrate_legacy_damaged(void)
+{
+  legacy_settings_t legacy;
+  uint8_t version = SETTINGS_VERSION_LEGACY;
+  uint8_t checksum;
+
+  sim_flash_erase();
+  legacy_settings(&legacy);
+  sim_flash_write(EEPROM_ADDR_VERSION, &version, 1);
+  write_legacy_record(EEPROM_ADDR_GLOBAL, &legacy, sizeof(legacy));
+  checksum = ~legacy_checksum((uint8_t *)&legacy, sizeof(legacy));
+  sim_flash_write(EEPROM_ADDR_GLOBAL+sizeof(legacy), &checksum, 1);
+
+  settings_init();
+  CHECK(settings.steps_per_mm[X_AXIS] == DEFAULT_X_STEPS_PER_MM);
+  CHECK(eeprom_get_char(EEPROM_ADDR_VERSION) == SETTINGS_VERSION);
+}
+
+// Outside the migration, a record behind a Grbl 1.1h checksum is rejected.
+static void test_legacy_checksum_rejected(void)
+{
+  float coord_data[N_AXIS];
+
+  uint32_t addr = EEPROM_ADDR_PARAMETERS+1*(sizeof(float)*N_AXIS+1);
+  uint8_t idx, checksum;
+
+  default_settings();
+  for (idx=0; idx<N_AXIS; idx++) { coord_data[idx] = 0.1f*(idx+1); }
+  settings_write_coord_data(1, coord_data);
+  checksum = legacy_checksum((uint8_t *)coord_data, sizeof(coord_data));
+  CHECK(eeprom_get_char(addr+sizeof(coord_data)) != checksum);
+  eeprom_put_char(addr+sizeof(coord_data), checksum);
+  CHECK(!settings_read_coord_data(1, coord_data));
+}
+
+// Every single bit error in the global settings image or a checksummed record is detected.
+static void test_corruption(void)
+{
+  float coord_data[N_AXIS];
+  uint32_t addr, size = 1+sizeof(settings_t)+EEPROM_CRC_SIZE;
+  uint8_t data, n;
+
+  default_settings();
+  settings_write_coord_data(1, (float *)legacy_g55);
+  CHECK(read_global_settings());
+  for (addr=EEPROM_ADDR_VERSION; addr<EEPROM_ADDR_VERSION+size; addr++) {
+    data = eeprom_get_char(addr);
+    for (n=0; n<8; n++) {
+      eeprom_put_char(addr, data ^ bit(n));
+      // Except a version byte turned into 10, which is migrated behind the weaker old checksum.
+      if (eeprom_get_char(EEPROM_ADDR_VERSION) != SETTINGS_VERSION_LEGACY) { CHECK(!read_global_settings()); }
+    }
+    eeprom_put_char(addr, data);
+  }
+  CHECK(read_global_settings());
+
+  size = sizeof(float)*N_AXIS+EEPROM_CHECKSUM_SIZE;
+  for (addr=EEPROM_ADDR_PARAMETERS+size; addr<EEPROM_ADDR_PARAMETERS+2*size; addr++) {
+    data = eeprom_get_char(addr);
+    for (n=0; n<8; n++) {
+      eeprom_put_char(addr, data ^ bit(n));
+      CHECK(!memcpy_from_eeprom_with_checksum((char*)coord_data, EEPROM_ADDR_PARAMETERS+size, size-1));
+    }
+    eeprom_put_char(addr, data);
+  }
+}
+
+// Reports the power-up load time. The flash store is mounted once, reading every page header, and
+// the global settings then come from the RAM shadow without touching the flash.
+static void test_load_time(void)
+{
+  uint32_t reads, mark, idx, runs = 1000;
+  uint64_t start, init_ns, read_ns;
+
+  default_settings();
+  reads = sim_flash_read_count();
+  start = host_ns();
+  settings_init();
+  init_ns = host_ns() - start;
+  reads = sim_flash_read_count() - reads;
+
+  mark = sim_flash_read_count();
+  start = host_ns();
+  for (idx=0; idx<runs; idx++) { CHECK(read_global_settings()); }
+  read_ns = (host_ns() - start)/runs;
+  CHECK(sim_flash_read_count() == mark);
+
+  fprintf(stderr, "settings_init: %u bytes read from flash, %.1f ms of SPI1 transfer, %llu us on the host\n",
+          reads, reads*8/SPI1_HZ*1e3, (unsigned long long)init_ns/1000);
+  fprintf(stderr, "read_global_settings: %llu ns on the host\n", (unsigned long long)read_ns);
+}
+
+int main(void)
+{
+  test_migrate_legacy();
+  test_migrate_legacy_damaged();
+  test_legacy_checksum_rejected();
+  test_corruption();
+  test_load_time();
+  fprintf(stderr, "settings: ok\n");
+  return(EXIT_SUCCESS);
+}
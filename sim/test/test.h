@@ -0,0 +1,30 @@
+/*
+  test.h - checks for the host simulator tests
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef test_h
+#define test_h
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Grbl reports go to stdout, so results go to stderr. A failed check ends the test.
+#define CHECK(cond) do { \
+    if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); exit(EXIT_FAILURE); } \
+  } while (0)
+
+#endif
@@ -60,6 +60,15 @@ defined in linker script */
 .word  _sbss
 /* end address for the .bss section. defined in linker script */
 .word  _ebss
+/* start, end and load addresses of the ITCM code, and bounds of the DTCM and DMA buffer
+   sections. defined in linker script */
+.word  _sitcm
+.word  _eitcm
+.word  _siitcm
+.word  _sdtcm
+.word  _edtcm
+.word  _sdmabuf
+.word  _edmabuf
 /* stack used for SystemInit_ExtMemCtl; always internal RAM used */
 
 /**
@@ -105,6 +114,44 @@ LoopFillZerobss:
   cmp  r2, r3
   bcc  FillZerobss
 
+/* Copy the ITCM code from flash */
+  ldr  r0, =_sitcm
+  ldr  r1, =_siitcm
+  ldr  r2, =_eitcm
+  b  LoopCopyItcm
+
+CopyItcm:
+  ldr  r3, [r1], #4
+  str  r3, [r0], #4
+
+LoopCopyItcm:
+  cmp  r0, r2
+  bcc  CopyItcm
+
+/* Zero fill the DTCM data and the DMA buffers. */
+  movs  r3, #0
+  ldr  r0, =_sdtcm
+  ldr  r2, =_edtcm
+  b  LoopFillZeroDtcm
+
+FillZeroDtcm:
+  str  r3, [r0], #4
+
+LoopFillZeroDtcm:
+  cmp  r0, r2
+  bcc  FillZeroDtcm
+
+  ldr  r0, =_sdmabuf
+  ldr  r2, =_edmabuf
+  b  LoopFillZeroDmabuf
+
+FillZeroDmabuf:
+  str  r3, [r0], #4
+
+LoopFillZeroDmabuf:
+  cmp  r0, r2
+  bcc  FillZeroDmabuf
+
 /* Call the clock system initialization function.*/
   bl  SystemInit   
 /* Call static constructors */